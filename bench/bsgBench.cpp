@@ -0,0 +1,773 @@
+#include "bsg.h"
+#include "bsgMenagerie.h"
+#include "bsgObjModel.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <chrono>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// A benchmark for drawing whole scenes, with no window.  It makes an
+// off-screen OpenGL context with EGL, so it runs on a machine with no
+// display, like a render farm node or a CI container (with Mesa's
+// llvmpipe if there's no GPU).  It builds some scenes like the ones
+// in the examples, and some big made-up ones, then flies the camera
+// along the same path through each one every time, and reports
+// the frame times, the draw calls, and the memory used.
+//
+// Each scene runs in a process, and a context, of its own, so the
+// peak memory and the texture memory reported for it are its own,
+// and not left over from the scenes before it.
+//
+// The results are written as JSON, one scene to a line, so they can
+// be kept and compared.  Give it an old results file with -baseline,
+// and it will say which scenes got slower, or make more draw calls,
+// and exit with 1 if any did.  Compare runs from the same machine
+// only.
+//
+// Usage: bsgBench [-frames n] [-warmup n] [-size w h] [-grid n]
+//                 [-scene name]... [-o results.json]
+//                 [-baseline old.json] [-tolerance percent]
+//
+// The scenes are: demo, texture, obj, grid, bigmesh.  The default is
+// all of them.
+
+// The shaders and data are found through the source directory, the
+// way pointDemo does it.
+static std::string dataPath(const std::string &file) {
+  return std::string(DATAPATH) + "/" + file;
+}
+
+////////////////////////////////////////////////////////////////////////
+// The off-screen context.
+
+static EGLDisplay display = EGL_NO_DISPLAY;
+static EGLContext context = EGL_NO_CONTEXT;
+static EGLSurface surface = EGL_NO_SURFACE;
+static GLuint framebuffer = 0, colorBuffer = 0, depthBuffer = 0;
+
+// A display that doesn't need an X server.  EGL_EXT_platform_device
+// gets one straight from a GPU (or from llvmpipe), without one.
+// Otherwise we take the default display, and hope.
+static EGLDisplay getDisplay() {
+
+  PFNEGLQUERYDEVICESEXTPROC queryDevices =
+    (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+  PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+    (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+  if (queryDevices && getPlatformDisplay) {
+    EGLDeviceEXT devices[8];
+    EGLint nDevices = 0;
+    if (queryDevices(8, devices, &nDevices)) {
+      for (int i = 0; i < nDevices; i++) {
+        EGLDisplay d = getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, devices[i], NULL);
+        if (d != EGL_NO_DISPLAY && eglInitialize(d, NULL, NULL)) return d;
+      }
+    }
+  }
+
+  EGLDisplay d = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (d == EGL_NO_DISPLAY || !eglInitialize(d, NULL, NULL))
+    throw std::runtime_error("Can't find an EGL display.");
+  return d;
+}
+
+// Everything is drawn into a framebuffer object, so it doesn't matter
+// whether the context came with a surface or not.  A pbuffer is asked
+// for anyway, since not every driver will make a context current with
+// no surface at all.
+static void makeContext(const int &width, const int &height) {
+
+  display = getDisplay();
+
+  EGLint configAttribs[] = {
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+    EGL_DEPTH_SIZE, 24,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_NONE };
+  EGLConfig config;
+  EGLint nConfigs = 0;
+  if (!eglChooseConfig(display, configAttribs, &config, 1, &nConfigs) ||
+      nConfigs == 0) {
+    // No pbuffers, so try again for a config without them.
+    configAttribs[1] = 0;
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &nConfigs) ||
+        nConfigs == 0)
+      throw std::runtime_error("No EGL config for desktop OpenGL.");
+  }
+
+  if (!eglBindAPI(EGL_OPENGL_API))
+    throw std::runtime_error("This EGL can't make desktop OpenGL contexts.");
+
+  EGLint surfaceAttribs[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+  surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+
+  context = eglCreateContext(display, config, EGL_NO_CONTEXT, NULL);
+  if (context == EGL_NO_CONTEXT)
+    throw std::runtime_error("Can't make an EGL context.");
+  if (!eglMakeCurrent(display, surface, surface, context))
+    throw std::runtime_error("Can't make the EGL context current.");
+
+  // glewInit() also looks for GLX, and a GLEW built for GLX will
+  // complain that there isn't any.  By then it has already found the
+  // OpenGL functions, though, so that's not fatal.
+  glewExperimental = true;
+  GLenum err = glewInit();
+  if (!glewIsSupported("GL_VERSION_2_1")) {
+    throw std::runtime_error(std::string("OpenGL 2.1 is not supported: ") +
+                             (const char *)glewGetErrorString(err));
+  }
+
+  if (!GLEW_EXT_framebuffer_object)
+    throw std::runtime_error("The benchmark needs GL_EXT_framebuffer_object.");
+
+  glGenFramebuffersEXT(1, &framebuffer);
+  glGenRenderbuffersEXT(1, &colorBuffer);
+  glGenRenderbuffersEXT(1, &depthBuffer);
+
+  glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, colorBuffer);
+  glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, GL_RGBA8, width, height);
+  glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, depthBuffer);
+  glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, GL_DEPTH_COMPONENT24,
+                           width, height);
+
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, framebuffer);
+  glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT,
+                               GL_RENDERBUFFER_EXT, colorBuffer);
+  glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT,
+                               GL_RENDERBUFFER_EXT, depthBuffer);
+  if (glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT) !=
+      GL_FRAMEBUFFER_COMPLETE_EXT)
+    throw std::runtime_error("Can't make the off-screen framebuffer.");
+
+  glViewport(0, 0, width, height);
+  glClearColor(0.1, 0.0, 0.4, 1.0);
+  glEnable(GL_DEPTH_TEST);
+  glEnable(GL_CULL_FACE);
+}
+
+static void destroyContext() {
+
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+  glDeleteFramebuffersEXT(1, &framebuffer);
+  glDeleteRenderbuffersEXT(1, &colorBuffer);
+  glDeleteRenderbuffersEXT(1, &depthBuffer);
+
+  eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  eglDestroyContext(display, context);
+  if (surface != EGL_NO_SURFACE) eglDestroySurface(display, surface);
+  eglTerminate(display);
+}
+
+////////////////////////////////////////////////////////////////////////
+// The scenes.
+
+static bsg::bsgPtr<bsg::lightList> makeLights() {
+
+  bsg::bsgPtr<bsg::lightList> lights = new bsg::lightList();
+  lights->addLight(glm::vec4(10.0f, 10.0f, 10.0f, 1.0f),
+                   glm::vec4(1.0f, 1.0f, 1.0f, 0.0f));
+  lights->addLight(glm::vec4(-10.0f, 10.0f, -10.0f, 1.0f),
+                   glm::vec4(0.5f, 0.5f, 0.8f, 0.0f));
+  return lights;
+}
+
+static bsg::bsgPtr<bsg::shaderMgr> makeShader(const std::string &vertex,
+                                              const std::string &fragment) {
+
+  bsg::bsgPtr<bsg::shaderMgr> shader = new bsg::shaderMgr();
+  shader->addLights(makeLights());
+  shader->addShader(bsg::GLSHADER_VERTEX, dataPath(vertex));
+  shader->addShader(bsg::GLSHADER_FRAGMENT, dataPath(fragment));
+  shader->compileShaders();
+
+  // The programs might be compiling in the background, and the
+  // first frames shouldn't pay for that.
+  shader->waitUntilReady();
+  return shader;
+}
+
+// What a scene needs to be benchmarked: the scene, where its middle
+// is, and how far away to fly around it.  Some of them move a piece
+// each frame, the way the demos do.
+struct benchScene {
+  std::string name;
+  bsg::scene scene;
+  glm::vec3 center;
+  float radius;
+  int nObjects;
+  bsg::bsgPtr<bsg::drawableCompound> moving;
+};
+
+// Like demo2 and treeDemo: a few shapes from the menagerie, one of
+// them moving, and the axes.
+static void makeDemoScene(benchScene &b) {
+
+  bsg::bsgPtr<bsg::shaderMgr> shader = makeShader("shaders/shader2.vp",
+                                                  "shaders/shader.fp");
+
+  bsg::bsgPtr<bsg::drawableCollection> shapes = new bsg::drawableCollection("shapes");
+
+  bsg::bsgPtr<bsg::drawableCompound> sphere =
+    new bsg::drawableSphere(shader, 16, 32, glm::vec4(1.0f, 0.2f, 0.2f, 1.0f));
+  sphere->setPosition(glm::vec3(2.0f, 0.0f, 0.0f));
+  shapes->addObject("sphere", bsg::bsgPtr<bsg::drawableMulti>(sphere));
+
+  bsg::bsgPtr<bsg::drawableCompound> cylinder =
+    new bsg::drawableCylinder(shader, 4, 32, glm::vec4(0.2f, 1.0f, 0.2f, 1.0f));
+  cylinder->setPosition(glm::vec3(-2.0f, 0.0f, 0.0f));
+  shapes->addObject("cylinder", bsg::bsgPtr<bsg::drawableMulti>(cylinder));
+
+  bsg::bsgPtr<bsg::drawableCompound> cone =
+    new bsg::drawableCone(shader, 4, 32, glm::vec4(0.2f, 0.2f, 1.0f, 1.0f));
+  cone->setPosition(glm::vec3(0.0f, 0.0f, 2.0f));
+  shapes->addObject("cone", bsg::bsgPtr<bsg::drawableMulti>(cone));
+
+  bsg::bsgPtr<bsg::drawableCompound> cube =
+    new bsg::drawableCube(shader, 4, glm::vec4(1.0f, 1.0f, 0.2f, 1.0f));
+  cube->setPosition(glm::vec3(0.0f, 0.0f, -2.0f));
+  shapes->addObject("cube", bsg::bsgPtr<bsg::drawableMulti>(cube));
+
+  b.scene.addObject("shapes", bsg::bsgPtr<bsg::drawableMulti>(shapes));
+  b.scene.addObject("axes", new bsg::drawableAxes(shader, 10.0f));
+
+  b.moving = sphere;
+  b.center = glm::vec3(0.0f);
+  b.radius = 8.0f;
+  b.nObjects = 5;
+}
+
+// Like textureDemo: a textured rectangle, and the axes.
+static void makeTextureScene(benchScene &b) {
+
+  bsg::bsgPtr<bsg::shaderMgr> shader = makeShader("shaders/textureShader.vp",
+                                                  "shaders/textureShader.fp");
+  bsg::bsgPtr<bsg::textureMgr> texture = new bsg::textureMgr();
+  texture->readFile(bsg::texturePNG, dataPath("data/gladiolas-sq.png"));
+  shader->addTexture(texture);
+
+  bsg::bsgPtr<bsg::shaderMgr> axesShader = makeShader("shaders/shader2.vp",
+                                                      "shaders/shader.fp");
+
+  b.scene.addObject("rectangle", new bsg::drawableRectangle(shader, 9.0f, 9.0f, 3));
+  b.scene.addObject("axes", new bsg::drawableAxes(axesShader, 100.0f));
+
+  b.center = glm::vec3(0.0f);
+  b.radius = 10.0f;
+  b.nObjects = 2;
+}
+
+// Like objDemoMinVR: the LEGO man.
+static void makeObjScene(benchScene &b) {
+
+  bsg::bsgPtr<bsg::shaderMgr> shader = makeShader("shaders/shader2.vp",
+                                                  "shaders/shader.fp");
+
+  b.scene.addObject("lego",
+                    new bsg::drawableObjModel(shader, dataPath("data/LEGO_Man.obj")));
+
+  b.center = glm::vec3(0.0f, 1.0f, 0.0f);
+  b.radius = 6.0f;
+  b.nObjects = 1;
+}
+
+// Lots of little objects, n by n by n cubes, each its own compound
+// object, grouped in a collection for each layer and row.  This is
+// the one that shows what each draw costs.
+static void makeGridScene(benchScene &b, const int &n) {
+
+  bsg::bsgPtr<bsg::shaderMgr> shader = makeShader("shaders/shader2.vp",
+                                                  "shaders/shader.fp");
+
+  // The names are given, rather than random, so that the objects are
+  // drawn in the same order every time.
+  char name[32];
+  float spacing = 2.0f;
+  for (int i = 0; i < n; i++) {
+    sprintf(name, "layer%04d", i);
+    bsg::bsgPtr<bsg::drawableCollection> layer = new bsg::drawableCollection(name);
+    for (int j = 0; j < n; j++) {
+      sprintf(name, "row%04d", j);
+      bsg::bsgPtr<bsg::drawableCollection> row = new bsg::drawableCollection(name);
+      for (int k = 0; k < n; k++) {
+        glm::vec4 color((float)i / n, (float)j / n, (float)k / n, 1.0f);
+        bsg::bsgPtr<bsg::drawableCompound> cube = new bsg::drawableCube(shader, 1, color);
+        cube->setPosition(glm::vec3(i, j, k) * spacing);
+        cube->setScale(glm::vec3(0.5f));
+        sprintf(name, "cube%04d", k);
+        row->addObject(name, bsg::bsgPtr<bsg::drawableMulti>(cube));
+      }
+      layer->addObject(row->getName(), bsg::bsgPtr<bsg::drawableMulti>(row));
+    }
+    b.scene.addObject(layer->getName(), bsg::bsgPtr<bsg::drawableMulti>(layer));
+  }
+
+  float middle = 0.5f * (n - 1) * spacing;
+  b.center = glm::vec3(middle);
+  b.radius = 2.5f * middle + 5.0f;
+  b.nObjects = n * n * n;
+}
+
+// One big mesh, a sphere with about two million triangles, to see
+// what the vertices cost when there are few draws.
+static void makeBigMeshScene(benchScene &b) {
+
+  bsg::bsgPtr<bsg::shaderMgr> shader = makeShader("shaders/shader2.vp",
+                                                  "shaders/shader.fp");
+
+  bsg::bsgPtr<bsg::drawableObj> mesh = new bsg::drawableObj();
+  bsg::drawableSphere::getSphere(mesh, 1000, 1000,
+                                 glm::vec4(0.8f, 0.8f, 0.8f, 1.0f));
+
+  bsg::bsgPtr<bsg::drawableCompound> sphere =
+    new bsg::drawableCompound("bigmesh", shader);
+  sphere->addObject(mesh);
+  sphere->setScale(glm::vec3(3.0f));
+  b.scene.addObject("bigmesh", bsg::bsgPtr<bsg::drawableMulti>(sphere));
+
+  b.center = glm::vec3(0.0f);
+  b.radius = 8.0f;
+  b.nObjects = 1;
+}
+
+static bool makeScene(benchScene &b, const std::string &name, const int &gridSize) {
+
+  b.name = name;
+  if (name == "demo") {
+    makeDemoScene(b);
+  } else if (name == "texture") {
+    makeTextureScene(b);
+  } else if (name == "obj") {
+    makeObjScene(b);
+  } else if (name == "grid") {
+    makeGridScene(b, gridSize);
+  } else if (name == "bigmesh") {
+    makeBigMeshScene(b);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Running them.
+
+// The results for one scene.  The times are in milliseconds, and the
+// counts are per frame.
+struct benchResult {
+  std::string name;
+  int nObjects;
+  double frameMean, frameP50, frameP90, frameP99, frameMax;
+  double submitP50, submitP99;
+  double loadMs;
+  bsg::drawStats stats;
+  size_t textureBytes;
+  size_t bufferBytes;
+  long peakRSSKB;
+};
+
+static double percentile(std::vector<double> sorted, const double &p) {
+
+  if (sorted.empty()) return 0.0;
+  std::sort(sorted.begin(), sorted.end());
+  size_t i = (size_t)(p * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(i, sorted.size() - 1)];
+}
+
+static double msSince(const std::chrono::high_resolution_clock::time_point &start) {
+  return std::chrono::duration<double, std::milli>(
+    std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// The camera goes once around the scene, bobbing up and down, and
+// moving in and out, so the near and far objects both get their
+// turn.  Where it is depends only on the frame number, so every run
+// draws the same frames.
+static void placeCamera(benchScene &b, const int &frame, const int &nFrames) {
+
+  float t = (float)frame / nFrames;
+  float angle = 2.0f * M_PI * t;
+  float radius = b.radius * (1.0f - 0.4f * sin(2.0f * angle));
+  float height = 0.3f * b.radius * sin(angle);
+
+  b.scene.setCameraPosition(b.center + glm::vec3(radius * cos(angle), height,
+                                                 radius * sin(angle)));
+  b.scene.setLookAtPosition(b.center);
+}
+
+static benchResult runScene(const std::string &name, const int &gridSize,
+                            const int &nFrames, const int &nWarmup,
+                            const float &aspect) {
+
+  std::chrono::high_resolution_clock::time_point start =
+    std::chrono::high_resolution_clock::now();
+
+  size_t bufferBytesBefore = bsg::drawStats::counts.bufferBytes;
+
+  benchScene b;
+  if (!makeScene(b, name, gridSize))
+    throw std::runtime_error("There's no scene called " + name + ".");
+  b.scene.setAspect(aspect);
+  b.scene.setFOV(M_PI / 3.0f);
+  b.scene.prepare();
+
+  benchResult result;
+  result.name = name;
+  result.nObjects = b.nObjects;
+
+  std::vector<double> frameMs, submitMs;
+  bsg::drawStats total;
+
+  for (int frame = -nWarmup; frame < nFrames; frame++) {
+
+    // The warmup frames go along the start of the path, so the
+    // buffers and the shader variants are ready when the real ones
+    // start.
+    placeCamera(b, std::max(frame, 0), nFrames);
+    if (b.moving.ptr())
+      b.moving->setPosition(glm::vec3(2.0f, sin(0.1f * frame), 0.0f));
+
+    std::chrono::high_resolution_clock::time_point frameStart =
+      std::chrono::high_resolution_clock::now();
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    b.scene.load();
+    b.scene.draw(b.scene.getViewMatrix(), b.scene.getProjMatrix());
+    double submitted = msSince(frameStart);
+
+    // Wait for the GPU, so its time counts too.  Without a swap,
+    // nothing else would hold us back.
+    glFinish();
+    double finished = msSince(frameStart);
+
+    if (frame == -nWarmup) result.loadMs = msSince(start);
+    if (frame < 0) continue;
+
+    frameMs.push_back(finished);
+    submitMs.push_back(submitted);
+    total += b.scene.getStats();
+  }
+
+  double sum = 0.0;
+  for (size_t i = 0; i < frameMs.size(); i++) sum += frameMs[i];
+  result.frameMean = frameMs.empty() ? 0.0 : sum / frameMs.size();
+  result.frameP50 = percentile(frameMs, 0.50);
+  result.frameP90 = percentile(frameMs, 0.90);
+  result.frameP99 = percentile(frameMs, 0.99);
+  result.frameMax = percentile(frameMs, 1.00);
+  result.submitP50 = percentile(submitMs, 0.50);
+  result.submitP99 = percentile(submitMs, 0.99);
+
+  // The counts per frame, rounded.
+  int n = std::max(nFrames, 1);
+  result.stats.drawCalls = (total.drawCalls + n / 2) / n;
+  result.stats.programChanges = (total.programChanges + n / 2) / n;
+  result.stats.bufferBinds = (total.bufferBinds + n / 2) / n;
+  result.stats.textureBinds = (total.textureBinds + n / 2) / n;
+  result.stats.uniformUploads = (total.uniformUploads + n / 2) / n;
+  result.stats.bufferUploads = (total.bufferUploads + n / 2) / n;
+  result.stats.bufferBytes = (total.bufferBytes + n / 2) / n;
+
+  // The scene has its process to itself, so the textures resident
+  // now, and all the buffers ever uploaded, are its own.
+  result.textureBytes = bsg::textureMgr::getResidentBytes();
+  result.bufferBytes = bsg::drawStats::counts.bufferBytes - bufferBytesBefore;
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  result.peakRSSKB = usage.ru_maxrss;
+
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////
+// The results.
+
+static std::string toJSON(const benchResult &r) {
+
+  std::ostringstream out;
+  out << "{\"name\":\"" << r.name << "\""
+      << ",\"objects\":" << r.nObjects
+      << ",\"frameMean\":" << r.frameMean
+      << ",\"frameP50\":" << r.frameP50
+      << ",\"frameP90\":" << r.frameP90
+      << ",\"frameP99\":" << r.frameP99
+      << ",\"frameMax\":" << r.frameMax
+      << ",\"submitP50\":" << r.submitP50
+      << ",\"submitP99\":" << r.submitP99
+      << ",\"loadMs\":" << r.loadMs
+      << ",\"drawCalls\":" << r.stats.drawCalls
+      << ",\"programChanges\":" << r.stats.programChanges
+      << ",\"bufferBinds\":" << r.stats.bufferBinds
+      << ",\"textureBinds\":" << r.stats.textureBinds
+      << ",\"uniformUploads\":" << r.stats.uniformUploads
+      << ",\"bufferUploadsPerFrame\":" << r.stats.bufferUploads
+      << ",\"bufferBytesPerFrame\":" << r.stats.bufferBytes
+      << ",\"textureBytes\":" << r.textureBytes
+      << ",\"bufferBytes\":" << r.bufferBytes
+      << ",\"peakRSSKB\":" << r.peakRSSKB << "}";
+  return out.str();
+}
+
+// Finds "key": in a line of our own JSON, and reads the value after
+// it.  That's all the JSON reading a baseline needs, since we wrote it.
+static bool jsonValue(const std::string &line, const std::string &key,
+                      std::string &value) {
+
+  std::string pattern = "\"" + key + "\":";
+  size_t pos = line.find(pattern);
+  if (pos == std::string::npos) return false;
+  pos += pattern.size();
+
+  if (line[pos] == '"') {
+    size_t end = line.find('"', pos + 1);
+    if (end == std::string::npos) return false;
+    value = line.substr(pos + 1, end - pos - 1);
+  } else {
+    size_t end = line.find_first_of(",}", pos);
+    value = line.substr(pos, end - pos);
+  }
+  return true;
+}
+
+static double jsonNumber(const std::string &line, const std::string &key) {
+  std::string value;
+  return jsonValue(line, key, value) ? atof(value.c_str()) : 0.0;
+}
+
+// Reads back what toJSON() wrote.
+static benchResult fromJSON(const std::string &line) {
+
+  benchResult r;
+  jsonValue(line, "name", r.name);
+  r.nObjects = (int)jsonNumber(line, "objects");
+  r.frameMean = jsonNumber(line, "frameMean");
+  r.frameP50 = jsonNumber(line, "frameP50");
+  r.frameP90 = jsonNumber(line, "frameP90");
+  r.frameP99 = jsonNumber(line, "frameP99");
+  r.frameMax = jsonNumber(line, "frameMax");
+  r.submitP50 = jsonNumber(line, "submitP50");
+  r.submitP99 = jsonNumber(line, "submitP99");
+  r.loadMs = jsonNumber(line, "loadMs");
+  r.stats.drawCalls = (unsigned int)jsonNumber(line, "drawCalls");
+  r.stats.programChanges = (unsigned int)jsonNumber(line, "programChanges");
+  r.stats.bufferBinds = (unsigned int)jsonNumber(line, "bufferBinds");
+  r.stats.textureBinds = (unsigned int)jsonNumber(line, "textureBinds");
+  r.stats.uniformUploads = (unsigned int)jsonNumber(line, "uniformUploads");
+  r.stats.bufferUploads = (unsigned int)jsonNumber(line, "bufferUploadsPerFrame");
+  r.stats.bufferBytes = (size_t)jsonNumber(line, "bufferBytesPerFrame");
+  r.textureBytes = (size_t)jsonNumber(line, "textureBytes");
+  r.bufferBytes = (size_t)jsonNumber(line, "bufferBytes");
+  r.peakRSSKB = (long)jsonNumber(line, "peakRSSKB");
+  return r;
+}
+
+// Runs one scene in a child process, with its own context.  The
+// child sends back the renderer, the GL version, and the result in
+// JSON, a line each.  Returns false if the child failed, after it has
+// said why.
+static bool runSceneAlone(const std::string &name, const int &gridSize,
+                          const int &nFrames, const int &nWarmup,
+                          const int &width, const int &height,
+                          std::string &renderer, std::string &version,
+                          benchResult &result) {
+
+  int fds[2];
+  if (pipe(fds) != 0) throw std::runtime_error("Can't make a pipe.");
+
+  // Or the child prints whatever is waiting in them, too.
+  fflush(stdout);
+  std::cout.flush();
+
+  pid_t pid = fork();
+  if (pid < 0) throw std::runtime_error("Can't start a process for " + name);
+
+  if (pid == 0) {
+    close(fds[0]);
+    int status = 0;
+    try {
+      makeContext(width, height);
+      std::string text = std::string((const char *)glGetString(GL_RENDERER)) +
+        "\n" + (const char *)glGetString(GL_VERSION) + "\n" +
+        toJSON(runScene(name, gridSize, nFrames, nWarmup,
+                        (float)width / height)) + "\n";
+      destroyContext();
+      for (size_t done = 0; done < text.size(); ) {
+        ssize_t n = write(fds[1], text.data() + done, text.size() - done);
+        if (n <= 0) break;
+        done += n;
+      }
+    } catch (std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      status = 1;
+    }
+    close(fds[1]);
+    std::cout.flush();
+    fflush(stdout);
+    _exit(status);
+  }
+
+  close(fds[1]);
+  std::string text;
+  char buffer[4096];
+  ssize_t n;
+  while ((n = read(fds[0], buffer, sizeof(buffer))) > 0) text.append(buffer, n);
+  close(fds[0]);
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) return false;
+
+  std::istringstream lines(text);
+  std::string json;
+  if (!std::getline(lines, renderer) || !std::getline(lines, version) ||
+      !std::getline(lines, json)) return false;
+  result = fromJSON(json);
+  return true;
+}
+
+// Compares the results with a baseline, and prints what got worse.
+// Times are allowed to be slower by the tolerance, or by a twentieth
+// of a millisecond, whichever is more, since the small scenes are
+// mostly timer noise.  The draw calls are the same every run, so any
+// more of those is a regression.
+static bool compareBaseline(const std::vector<benchResult> &results,
+                            const std::string &fileName,
+                            const double &tolerance) {
+
+  std::ifstream in(fileName.c_str());
+  if (!in) throw std::runtime_error("Can't read the baseline " + fileName);
+
+  std::map<std::string, std::string> baseline;
+  std::string line, name;
+  while (std::getline(in, line)) {
+    if (jsonValue(line, "name", name) && line.find("\"frameP50\"") != std::string::npos)
+      baseline[name] = line;
+  }
+
+  bool regressed = false;
+  printf("\n%-10s %-14s %12s %12s %9s\n", "scene", "measure", "baseline", "now", "change");
+  for (size_t i = 0; i < results.size(); i++) {
+    const benchResult &r = results[i];
+    std::map<std::string, std::string>::iterator it = baseline.find(r.name);
+    if (it == baseline.end()) {
+      printf("%-10s is not in the baseline.\n", r.name.c_str());
+      continue;
+    }
+
+    struct { const char *key; double now; bool exact; } measures[] = {
+      { "frameP50", r.frameP50, false },
+      { "frameP99", r.frameP99, false },
+      { "submitP50", r.submitP50, false },
+      { "drawCalls", (double)r.stats.drawCalls, true },
+      { "programChanges", (double)r.stats.programChanges, true },
+      { "textureBinds", (double)r.stats.textureBinds, true } };
+
+    for (size_t m = 0; m < sizeof(measures) / sizeof(measures[0]); m++) {
+      double was = jsonNumber(it->second, measures[m].key);
+      double now = measures[m].now;
+      double change = (was > 0.0) ? 100.0 * (now - was) / was : 0.0;
+      bool worse = measures[m].exact ? (now > was) :
+        (change > tolerance && now - was > 0.05);
+      printf("%-10s %-14s %12.3f %12.3f %+8.1f%% %s\n", r.name.c_str(),
+             measures[m].key, was, now, change, worse ? "REGRESSION" : "");
+      regressed = regressed || worse;
+    }
+  }
+  return regressed;
+}
+
+int main(int argc, char** argv) {
+
+  int nFrames = 300;
+  int nWarmup = 20;
+  int width = 1280, height = 720;
+  int gridSize = 16;
+  std::vector<std::string> sceneNames;
+  std::string outputFile, baselineFile;
+  double tolerance = 10.0;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-frames" && i + 1 < argc) {
+      nFrames = atoi(argv[++i]);
+    } else if (arg == "-warmup" && i + 1 < argc) {
+      nWarmup = atoi(argv[++i]);
+    } else if (arg == "-size" && i + 2 < argc) {
+      width = atoi(argv[++i]);
+      height = atoi(argv[++i]);
+    } else if (arg == "-grid" && i + 1 < argc) {
+      gridSize = atoi(argv[++i]);
+    } else if (arg == "-scene" && i + 1 < argc) {
+      sceneNames.push_back(argv[++i]);
+    } else if (arg == "-o" && i + 1 < argc) {
+      outputFile = argv[++i];
+    } else if (arg == "-baseline" && i + 1 < argc) {
+      baselineFile = argv[++i];
+    } else if (arg == "-tolerance" && i + 1 < argc) {
+      tolerance = atof(argv[++i]);
+    } else {
+      std::cerr << "Usage: bsgBench [-frames n] [-warmup n] [-size w h] [-grid n]" << std::endl
+                << "                [-scene name]... [-o results.json]" << std::endl
+                << "                [-baseline old.json] [-tolerance percent]" << std::endl
+                << "The scenes are demo, texture, obj, grid and bigmesh." << std::endl;
+      return 2;
+    }
+  }
+  nFrames = std::max(nFrames, 1);
+  nWarmup = std::max(nWarmup, 1);
+
+  if (sceneNames.empty()) {
+    const char *all[] = { "demo", "texture", "obj", "grid", "bigmesh" };
+    sceneNames.assign(all, all + 5);
+  }
+
+  std::string renderer, version;
+  std::vector<benchResult> results;
+  for (size_t i = 0; i < sceneNames.size(); i++) {
+    benchResult r;
+    if (!runSceneAlone(sceneNames[i], gridSize, nFrames, nWarmup,
+                       width, height, renderer, version, r)) return 2;
+
+    // The first scene is the first we hear of the renderer.
+    if (i == 0) {
+      std::cout << "Renderer: " << renderer << " / " << version << std::endl;
+      std::cout << width << "x" << height << ", " << nFrames << " frames, after "
+                << nWarmup << " to warm up." << std::endl;
+
+      printf("%-10s %8s %9s %9s %9s %9s %9s %8s %10s\n", "scene", "objects",
+             "mean ms", "p50 ms", "p90 ms", "p99 ms", "max ms", "draws", "peak MB");
+    }
+
+    printf("%-10s %8d %9.3f %9.3f %9.3f %9.3f %9.3f %8u %10.1f\n",
+           r.name.c_str(), r.nObjects, r.frameMean, r.frameP50, r.frameP90,
+           r.frameP99, r.frameMax, r.stats.drawCalls, r.peakRSSKB / 1024.0);
+    fflush(stdout);
+    results.push_back(r);
+  }
+
+  if (!outputFile.empty()) {
+    std::ofstream out(outputFile.c_str());
+    if (!out) throw std::runtime_error("Can't write " + outputFile);
+
+    out << "{\"renderer\":\"" << renderer << "\",\"version\":\"" << version
+        << "\",\"width\":" << width << ",\"height\":" << height
+        << ",\"frames\":" << nFrames << ",\"grid\":" << gridSize
+        << ",\"scenes\":[" << std::endl;
+    for (size_t i = 0; i < results.size(); i++) {
+      out << toJSON(results[i]) << ((i + 1 < results.size()) ? "," : "")
+          << std::endl;
+    }
+    out << "]}" << std::endl;
+  }
+
+  bool regressed = false;
+  if (!baselineFile.empty())
+    regressed = compareBaseline(results, baselineFile, tolerance);
+
+  return regressed ? 1 : 0;
+}
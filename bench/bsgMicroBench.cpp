@@ -0,0 +1,534 @@
+#include "bsg.h"
+#include "bsgMenagerie.h"
+#include "bsgObjModel.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+
+// Micro-benchmarks for the CPU side of the library: reading models,
+// making shapes, and finding things in the scene graph.  Each one is
+// run at several sizes, ten times apart, and the time per item is
+// printed for each size, along with how it compares to the time per
+// item at the smallest size.  That column stays near 1 for something
+// that takes time in proportion to its size, and grows by ten every
+// line for something quadratic, so a change that makes one of these
+// scale worse stands out.  No graphics context is needed, since
+// nothing is sent to the GPU.
+//
+// Usage: bsgMicroBench [-max n] [-time seconds] [name]...
+//
+// The names choose benchmarks by the start of their names, so "obj"
+// runs both of the OBJ benchmarks.  The default is all of them, up
+// to 100000 items.
+
+typedef std::chrono::high_resolution_clock benchClock;
+
+// How long to keep repeating each measurement.
+static double minSeconds = 0.2;
+
+// Runs the work over and over, with the setup before each run, and
+// returns the fastest run, in seconds.  The setup is not timed.
+template <class S, class W>
+double timeBest(S setup, W work) {
+
+  double best = 1.0e30, total = 0.0;
+  int runs = 0;
+  while ((total < minSeconds || runs < 2) && runs < 1000) {
+
+    setup();
+
+    benchClock::time_point start = benchClock::now();
+    work();
+    double seconds =
+      std::chrono::duration<double>(benchClock::now() - start).count();
+
+    best = std::min(best, seconds);
+    total += seconds;
+    runs++;
+  }
+  return best;
+}
+
+static void noSetup() {}
+
+// The number of times to repeat something small, so a single run
+// is long enough to time.
+static int repeatsFor(const int &n) {
+  return std::max(1, 100000 / n);
+}
+
+// One measurement: how many items were handled, and how long it took.
+struct benchResult {
+  size_t items;
+  double seconds;
+};
+
+struct benchmark {
+  const char *name;
+  const char *item;
+  // The largest size that makes sense, or zero for no limit.
+  int maxSize;
+  std::function<benchResult(int)> run;
+};
+
+////////////////////////////////////////////////////////////////////////
+// Reading OBJ files.
+
+static const std::string objFileName = "bsgMicroBench.obj";
+
+// Writes a flat k by k grid of quads, with texture coordinates and
+// normals, to be read back.  Returns the number of triangles.
+static size_t writeGridObj(const int &n) {
+
+  int k = std::max(1, (int)std::sqrt(n / 2.0));
+  std::ofstream out(objFileName.c_str());
+  if (!out.is_open())
+    throw std::runtime_error("Can't write " + objFileName);
+
+  for (int j = 0; j <= k; j++) {
+    for (int i = 0; i <= k; i++) {
+      out << "v " << (float)i / k << " " << (float)j / k << " "
+          << 0.1f * std::sin(0.3f * i) * std::cos(0.2f * j) << "\n";
+      out << "vt " << (float)i / k << " " << (float)j / k << "\n";
+      out << "vn 0 0 1\n";
+    }
+  }
+  for (int j = 0; j < k; j++) {
+    for (int i = 0; i < k; i++) {
+      int a = j * (k + 1) + i + 1;
+      int b = a + 1, c = a + k + 2, d = a + k + 1;
+      out << "f " << a << "/" << a << "/" << a << " "
+          << b << "/" << b << "/" << b << " "
+          << c << "/" << c << "/" << c << " "
+          << d << "/" << d << "/" << d << "\n";
+    }
+  }
+  return 2 * (size_t)k * k;
+}
+
+static benchResult objRead(const int &n, const bool &optimize) {
+
+  benchResult out;
+  out.items = writeGridObj(n);
+
+  bsg::bsgPtr<bsg::shaderMgr> shader = new bsg::shaderMgr();
+
+  // The model says what it's reading, every time.
+  std::streambuf *coutBuf = std::cout.rdbuf(NULL);
+  out.seconds = timeBest(noSetup, [&]() {
+      bsg::bsgPtr<bsg::drawableObjModel> model =
+        new bsg::drawableObjModel(shader, objFileName, true, optimize);
+    });
+  std::cout.rdbuf(coutBuf);
+
+  std::remove(objFileName.c_str());
+  return out;
+}
+
+////////////////////////////////////////////////////////////////////////
+// The scene graph.
+
+static std::vector<std::string> makeNames(const int &n) {
+  std::vector<std::string> names(n);
+  char buf[16];
+  for (int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "obj%07d", i);
+    names[i] = buf;
+  }
+  return names;
+}
+
+// A leaf for the scene graph.  They all share one little box, since
+// only the bounding boxes matter here.
+static bsg::bsgPtr<bsg::drawableCompound>
+makeLeaf(bsg::bsgPtr<bsg::shaderMgr> &shader,
+         bsg::bsgPtr<bsg::drawableObj> &box, const int &i) {
+
+  bsg::bsgPtr<bsg::drawableCompound> leaf = new bsg::drawableCompound(shader);
+  leaf->addObject(box);
+  leaf->setPosition(2.0f * (i % 1000), 2.0f * (i / 1000), 0.0f);
+  return leaf;
+}
+
+static bsg::bsgPtr<bsg::drawableObj> makeBox() {
+
+  bsg::bsgPtr<bsg::drawableObj> box = new bsg::drawableObj();
+  std::vector<glm::vec4> corners;
+  corners.push_back(glm::vec4(-0.5f, -0.5f, -0.5f, 1.0f));
+  corners.push_back(glm::vec4( 0.5f,  0.5f,  0.5f, 1.0f));
+  box->addData(bsg::GLDATA_VERTICES, "position", corners);
+  box->findBoundingBox();
+  return box;
+}
+
+// A two-level tree of n leaves, a hundred to a branch, which is how
+// a big scene tends to be organized.
+static bsg::bsgPtr<bsg::drawableCollection>
+makeTree(const int &n, bsg::bsgPtr<bsg::shaderMgr> &shader,
+         bsg::bsgPtr<bsg::drawableObj> &box,
+         const std::vector<std::string> &names) {
+
+  bsg::bsgPtr<bsg::drawableCollection> root =
+    new bsg::drawableCollection("root");
+  bsg::bsgPtr<bsg::drawableCollection> branch;
+
+  for (int i = 0; i < n; i++) {
+    if (i % 100 == 0) {
+      branch = new bsg::drawableCollection(names[i / 100]);
+      root->addObject(names[i / 100], branch);
+    }
+    branch->addObject(names[i], makeLeaf(shader, box, i));
+  }
+  return root;
+}
+
+// A chain of collections, each inside the one before, with the model
+// matrix asked for at the bottom.
+static benchResult modelMatrix(const int &n, const bool &moving) {
+
+  std::vector<bsg::bsgPtr<bsg::drawableCollection> > chain(n);
+  for (int i = 0; i < n; i++) {
+    chain[i] = new bsg::drawableCollection("level");
+    chain[i]->setPosition(0.0f, 0.001f, 0.0f);
+    if (i > 0) chain[i - 1]->addObject("level", chain[i]);
+  }
+
+  int repeats = repeatsFor(n);
+  volatile float sink = 0.0f;
+
+  benchResult out;
+  out.items = (size_t)n * repeats;
+  out.seconds = timeBest(noSetup, [&]() {
+      for (int r = 0; r < repeats; r++) {
+        if (moving) chain[0]->setPosition(0.0f, 0.001f * r, 0.0f);
+        sink = chain[n - 1]->getModelMatrix()[3][1];
+      }
+    });
+  return out;
+}
+
+static benchResult addObjects(const int &n) {
+
+  bsg::bsgPtr<bsg::shaderMgr> shader = new bsg::shaderMgr();
+  bsg::bsgPtr<bsg::drawableObj> box = makeBox();
+  std::vector<std::string> names = makeNames(n);
+
+  std::vector<bsg::bsgPtr<bsg::drawableMulti> > leaves(n);
+  for (int i = 0; i < n; i++) leaves[i] = makeLeaf(shader, box, i);
+
+  bsg::bsgPtr<bsg::drawableCollection> coll;
+
+  benchResult out;
+  out.items = n;
+  out.seconds = timeBest([&]() {
+      coll = new bsg::drawableCollection("coll");
+    }, [&]() {
+      for (int i = 0; i < n; i++) coll->addObject(names[i], leaves[i]);
+    });
+  return out;
+}
+
+static benchResult getObjects(const int &n) {
+
+  bsg::bsgPtr<bsg::shaderMgr> shader = new bsg::shaderMgr();
+  bsg::bsgPtr<bsg::drawableObj> box = makeBox();
+  std::vector<std::string> names = makeNames(n);
+
+  bsg::bsgPtr<bsg::drawableCollection> coll =
+    new bsg::drawableCollection("coll");
+  for (int i = 0; i < n; i++)
+    coll->addObject(names[i], makeLeaf(shader, box, i));
+
+  // Look them up in a scrambled order, as a program would.
+  std::vector<int> order(n);
+  for (int i = 0; i < n; i++) order[i] = (int)((i * 7919LL) % n);
+
+  int found = 0;
+  benchResult out;
+  out.items = n;
+  out.seconds = timeBest(noSetup, [&]() {
+      for (int i = 0; i < n; i++)
+        if (coll->getObject(names[order[i]]).ptr()) found++;
+    });
+
+  if (found == 0) std::cerr << "** Caution: getObject found nothing." << std::endl;
+  return out;
+}
+
+static benchResult getObjectsByPath(const int &n) {
+
+  bsg::bsgPtr<bsg::shaderMgr> shader = new bsg::shaderMgr();
+  bsg::bsgPtr<bsg::drawableObj> box = makeBox();
+  std::vector<std::string> names = makeNames(n);
+  bsg::bsgPtr<bsg::drawableCollection> root = makeTree(n, shader, box, names);
+
+  std::vector<bsg::bsgName> paths(n);
+  for (int i = 0; i < n; i++) {
+    paths[i].push_back(names[i / 100]);
+    paths[i].push_back(names[i]);
+  }
+
+  int found = 0;
+  benchResult out;
+  out.items = n;
+  out.seconds = timeBest(noSetup, [&]() {
+      for (int i = 0; i < n; i++)
+        if (root->getObject(paths[i]).ptr()) found++;
+    });
+
+  if (found == 0) std::cerr << "** Caution: getObject found nothing." << std::endl;
+  return out;
+}
+
+static benchResult getNames(const int &n) {
+
+  bsg::bsgPtr<bsg::shaderMgr> shader = new bsg::shaderMgr();
+  bsg::bsgPtr<bsg::drawableObj> box = makeBox();
+  std::vector<std::string> names = makeNames(n);
+  bsg::bsgPtr<bsg::drawableCollection> root = makeTree(n, shader, box, names);
+
+  size_t count = 0;
+  benchResult out;
+  out.items = n;
+  out.seconds = timeBest(noSetup, [&]() {
+      count = root->getNames().size();
+    });
+
+  if (count != (size_t)n)
+    std::cerr << "** Caution: getNames found " << count << " names, not "
+              << n << "." << std::endl;
+  return out;
+}
+
+static benchResult insideBoundingBox(const int &n) {
+
+  bsg::bsgPtr<bsg::shaderMgr> shader = new bsg::shaderMgr();
+  bsg::bsgPtr<bsg::drawableObj> box = makeBox();
+  std::vector<std::string> names = makeNames(n);
+  bsg::bsgPtr<bsg::drawableCollection> root = makeTree(n, shader, box, names);
+
+  // This point is only inside the first leaf.
+  glm::vec4 testPoint(0.1f, 0.1f, 0.1f, 1.0f);
+
+  size_t count = 0;
+  benchResult out;
+  out.items = n;
+  out.seconds = timeBest(noSetup, [&]() {
+      count = root->insideBoundingBox(testPoint).size();
+    });
+
+  if (count != 1)
+    std::cerr << "** Caution: insideBoundingBox found " << count
+              << " objects, not 1." << std::endl;
+  return out;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Making shapes.
+
+// The tessellation that gives a shape about n vertices.
+static int tessellationFor(const int &n, const float &verticesPerStep) {
+  return std::max(2, (int)std::sqrt(n / verticesPerStep));
+}
+
+static benchResult makeSpheres(const int &n) {
+
+  int theta = tessellationFor(n, 1.0f);
+  int phi = std::max(2, theta / 2);
+  int repeats = repeatsFor(n);
+  size_t vertices = 0;
+
+  benchResult out;
+  out.seconds = timeBest(noSetup, [&]() {
+      vertices = 0;
+      for (int r = 0; r < repeats; r++) {
+        bsg::bsgPtr<bsg::drawableObj> sphere = new bsg::drawableObj();
+        bsg::drawableSphere::getSphere(sphere, phi, theta,
+                                       glm::vec4(1.0f, 0.5f, 0.0f, 1.0f));
+        vertices += sphere->getCount();
+      }
+    });
+  out.items = vertices;
+  return out;
+}
+
+static benchResult makeCylinders(const int &n) {
+
+  int theta = tessellationFor(n, 1.0f);
+  int height = std::max(1, theta / 2);
+  int repeats = repeatsFor(n);
+  size_t vertices = 0;
+
+  benchResult out;
+  out.seconds = timeBest(noSetup, [&]() {
+      vertices = 0;
+      for (int r = 0; r < repeats; r++) {
+        bsg::bsgPtr<bsg::drawableObj> body = new bsg::drawableObj();
+        bsg::drawableCylinder::getCylinder(body, height, theta,
+                                           glm::vec4(0.0f, 0.5f, 1.0f, 1.0f));
+        vertices += body->getCount();
+      }
+    });
+  out.items = vertices;
+  return out;
+}
+
+static benchResult makeCubes(const int &n) {
+
+  // Six faces, each a strip of about 2 * tess * tess vertices.
+  int tess = tessellationFor(n, 12.0f);
+  int repeats = repeatsFor(n);
+  bsg::bsgPtr<bsg::shaderMgr> shader = new bsg::shaderMgr();
+  size_t vertices = 0;
+
+  benchResult out;
+  out.seconds = timeBest(noSetup, [&]() {
+      vertices = 0;
+      for (int r = 0; r < repeats; r++) {
+        bsg::bsgPtr<bsg::drawableCube> cube =
+          new bsg::drawableCube(shader, tess, glm::vec4(0.5f, 1.0f, 0.5f, 1.0f));
+        for (bsg::drawableCompound::iterator it = cube->begin();
+             it != cube->end(); it++)
+          vertices += (*it)->getCount();
+      }
+    });
+  out.items = vertices;
+  return out;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Getting an object ready to load.
+
+// The interleaving is done inside prepare(), which needs a program,
+// so it's opened up here to be timed by itself.
+class interleavedObj : public bsg::drawableObj {
+ public:
+  void interleave() { _interleave(); };
+};
+
+static void fillObj(bsg::drawableObj &obj, const int &n) {
+
+  std::vector<glm::vec4> vertices(n), colors(n), normals(n);
+  std::vector<glm::vec2> uvs(n);
+  for (int i = 0; i < n; i++) {
+    float t = 0.001f * i;
+    vertices[i] = glm::vec4(std::cos(t) * i, std::sin(t) * i, 0.01f * i, 1.0f);
+    colors[i] = glm::vec4(0.5f, 0.5f, t, 1.0f);
+    normals[i] = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+    uvs[i] = glm::vec2(t, 1.0f - t);
+  }
+  obj.addData(bsg::GLDATA_VERTICES, "position", vertices);
+  obj.addData(bsg::GLDATA_COLORS, "color", colors);
+  obj.addData(bsg::GLDATA_NORMALS, "normal", normals);
+  obj.addData(bsg::GLDATA_TEXCOORDS, "texture", uvs);
+  obj.setDrawType(GL_POINTS);
+}
+
+static benchResult findBoundingBox(const int &n) {
+
+  bsg::drawableObj obj;
+  fillObj(obj, n);
+  int repeats = repeatsFor(n);
+
+  benchResult out;
+  out.items = (size_t)n * repeats;
+  out.seconds = timeBest(noSetup, [&]() {
+      for (int r = 0; r < repeats; r++) obj.findBoundingBox();
+    });
+  return out;
+}
+
+static benchResult interleave(const int &n) {
+
+  interleavedObj obj;
+  fillObj(obj, n);
+  int repeats = repeatsFor(n);
+
+  benchResult out;
+  out.items = (size_t)n * repeats;
+  out.seconds = timeBest(noSetup, [&]() {
+      for (int r = 0; r < repeats; r++) obj.interleave();
+    });
+  return out;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv) {
+
+  int maxSize = 100000;
+  std::vector<std::string> chosen;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-max" && i + 1 < argc) {
+      maxSize = atoi(argv[++i]);
+    } else if (arg == "-time" && i + 1 < argc) {
+      minSeconds = atof(argv[++i]);
+    } else if (arg[0] == '-') {
+      std::cerr << "Usage: bsgMicroBench [-max n] [-time seconds] [name]..."
+                << std::endl;
+      return 1;
+    } else {
+      chosen.push_back(arg);
+    }
+  }
+
+  // The model matrix recursion goes one call deep per level, so the
+  // chains are kept short enough for the stack.
+  std::vector<benchmark> benchmarks = {
+    { "obj read", "triangle", 0,
+      [](int n) { return objRead(n, false); } },
+    { "obj read+optimize", "triangle", 0,
+      [](int n) { return objRead(n, true); } },
+    { "modelMatrix, still", "level", 10000,
+      [](int n) { return modelMatrix(n, false); } },
+    { "modelMatrix, root moving", "level", 10000,
+      [](int n) { return modelMatrix(n, true); } },
+    { "addObject", "child", 0, addObjects },
+    { "getObject(name)", "child", 0, getObjects },
+    { "getObject(bsgName)", "leaf", 0, getObjectsByPath },
+    { "getNames", "leaf", 0, getNames },
+    { "insideBoundingBox", "leaf", 0, insideBoundingBox },
+    { "sphere", "vertex", 0, makeSpheres },
+    { "cylinder", "vertex", 0, makeCylinders },
+    { "cube", "vertex", 0, makeCubes },
+    { "findBoundingBox", "vertex", 0, findBoundingBox },
+    { "interleave", "vertex", 0, interleave },
+  };
+
+  printf("%-26s %8s %10s %12s %10s %8s\n",
+         "benchmark", "size", "items", "ms/run", "ns/item", "vs first");
+
+  for (size_t b = 0; b < benchmarks.size(); b++) {
+
+    benchmark &bench = benchmarks[b];
+
+    bool run = chosen.empty();
+    for (size_t c = 0; c < chosen.size(); c++)
+      if (std::string(bench.name).compare(0, chosen[c].size(), chosen[c]) == 0)
+        run = true;
+    if (!run) continue;
+
+    int top = maxSize;
+    if (bench.maxSize > 0) top = std::min(top, bench.maxSize);
+
+    double firstNs = 0.0;
+    for (int n = 100; n <= top; n *= 10) {
+
+      benchResult result = bench.run(n);
+
+      double ns = 1.0e9 * result.seconds / std::max((size_t)1, result.items);
+      if (firstNs == 0.0) firstNs = ns;
+
+      printf("%-26s %8d %10zu %12.4f %10.2f %7.2fx\n",
+             bench.name, n, result.items,
+             1.0e3 * result.seconds, ns, ns / firstNs);
+    }
+    printf("%-26s (per %s)\n\n", "", bench.item);
+  }
+
+  return 0;
+}
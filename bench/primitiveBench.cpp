@@ -0,0 +1,118 @@
+#include "bsg.h"
+#include "bsgMenagerie.h"
+#include "bsgGenerators.h"
+#include <chrono>
+#include <thread>
+
+// A benchmark for making lots of shapes.  It compares building the
+// spheres one at a time with the menagerie function, as you would
+// when making a drawableSphere for each one, against building them
+// all at once with the bulk generators, first on one thread and then
+// on all of them.  No graphics context is needed, since nothing is
+// sent to the GPU.
+//
+// Usage: primitiveBench [number of shapes] [phi] [theta]
+
+// Times a function, and prints the number of vertices it made per
+// second.
+template <class F>
+double timeIt(const std::string &label, F f) {
+
+  std::chrono::high_resolution_clock::time_point start =
+    std::chrono::high_resolution_clock::now();
+
+  size_t nVertices = f();
+
+  double seconds = std::chrono::duration<double>(
+    std::chrono::high_resolution_clock::now() - start).count();
+
+  double rate = nVertices / seconds;
+  printf("%-36s %10lu vertices  %8.3f s  %8.2f Mvertices/s\n",
+         label.c_str(), (unsigned long)nVertices, seconds, rate / 1.0e6);
+  return rate;
+}
+
+int main(int argc, char** argv) {
+
+  int nShapes = (argc > 1) ? atoi(argv[1]) : 100000;
+  int phi = (argc > 2) ? atoi(argv[2]) : 8;
+  int theta = (argc > 3) ? atoi(argv[3]) : 16;
+
+  unsigned int nThreads = std::thread::hardware_concurrency();
+
+  std::cout << nShapes << " shapes, phi = " << phi << ", theta = " << theta
+            << ", " << nThreads << " threads." << std::endl;
+
+  // Some random positions, sizes, and colors.
+  srand(1);
+  std::vector<glm::vec4> spheres(nShapes);
+  std::vector<glm::vec4> colors(nShapes);
+  std::vector<glm::vec3> starts(nShapes), ends(nShapes);
+  std::vector<float> radii(nShapes);
+  std::vector<glm::vec2> sizes(nShapes);
+  std::vector<glm::vec4> texRects(nShapes);
+  for (int i = 0; i < nShapes; i++) {
+    glm::vec3 p = glm::vec3(rand() % 1000, rand() % 1000, rand() % 1000) * 0.01f;
+    spheres[i] = glm::vec4(p, 0.1f + (rand() % 10) * 0.01f);
+    colors[i] = glm::vec4((rand() % 256) / 255.0f, (rand() % 256) / 255.0f,
+                          (rand() % 256) / 255.0f, 1.0f);
+    starts[i] = p;
+    ends[i] = p + glm::vec3(rand() % 10, rand() % 10, 1 + rand() % 10) * 0.1f;
+    radii[i] = 0.05f;
+    sizes[i] = glm::vec2(0.1f, 0.15f);
+    texRects[i] = glm::vec4(0.0f, 0.0f, 1.0f / 16, 1.0f / 16);
+  }
+
+  // The objects are kept, as they would be in a real scene, so
+  // this isn't just reusing the same bit of memory over and over.
+  std::vector<bsg::bsgPtr<bsg::drawableObj> > objects;
+  objects.reserve(nShapes);
+  double oneAtATime = timeIt("spheres, one object each", [&]() {
+      size_t n = 0;
+      for (int i = 0; i < nShapes; i++) {
+        bsg::bsgPtr<bsg::drawableObj> sphere = new bsg::drawableObj();
+        bsg::drawableSphere::getSphere(sphere, phi, theta, colors[i]);
+        n += sphere->getCount();
+        objects.push_back(sphere);
+      }
+      return n;
+    });
+  objects.clear();
+
+  double bulkOne = timeIt("spheres, bulk, 1 thread", [&]() {
+      bsg::bsgPtr<bsg::drawableObj> out = new bsg::drawableObj();
+      bsg::primitiveGenerator::spheres(out, spheres, colors, phi, theta, 1);
+      return (size_t)nShapes * (phi + 1) * (theta + 1);
+    });
+
+  double bulkAll = timeIt("spheres, bulk, all threads", [&]() {
+      bsg::bsgPtr<bsg::drawableObj> out = new bsg::drawableObj();
+      bsg::primitiveGenerator::spheres(out, spheres, colors, phi, theta);
+      return (size_t)nShapes * (phi + 1) * (theta + 1);
+    });
+
+  timeIt("cylinders, bulk, all threads", [&]() {
+      bsg::bsgPtr<bsg::drawableObj> out = new bsg::drawableObj();
+      bsg::primitiveGenerator::cylinders(out, starts, ends, radii, colors, theta);
+      return (size_t)nShapes * 2 * (theta + 1);
+    });
+
+  timeIt("quads, bulk, all threads", [&]() {
+      bsg::bsgPtr<bsg::drawableObj> out = new bsg::drawableObj();
+      bsg::primitiveGenerator::quads(out, starts, sizes, texRects, colors);
+      return (size_t)nShapes * 4;
+    });
+
+  // The bulk spheres are indexed, so they have fewer vertices than
+  // the strips, and the vertex rates aren't directly comparable.
+  // Compare spheres per second instead.
+  size_t stripVertices = 2 * phi * (theta + 1);
+  size_t indexedVertices = (phi + 1) * (theta + 1);
+  double scale = (double)stripVertices / indexedVertices;
+
+  printf("\nSpeedup in spheres per second over one at a time:\n");
+  printf("  bulk, 1 thread:     %6.2fx\n", scale * bulkOne / oneAtATime);
+  printf("  bulk, all threads:  %6.2fx\n", scale * bulkAll / oneAtATime);
+
+  return 0;
+}
@@ -0,0 +1,115 @@
+#version 120
+
+// Goes with clusteredShader.vp.  The clusteredLightList has cut the
+// view into clusters, tiles across the screen and slices in depth,
+// and made a list of the lights that reach each one.  Each fragment
+// finds its cluster and adds up only those lights.
+//
+// Everything comes in float textures, read one texel at a time:
+//
+//  - clusterLights has a column for each light.  The first row is its
+//    position in camera space, with its radius in w, and the second
+//    row is its color.
+//
+//  - clusterGrid has a texel for each cluster: the place in the index
+//    list where the cluster's lights start, and how many there are.
+//    The tiles run across, then up, and the slices down the rows.
+//
+//  - clusterIndices is the index list, folded into rows.
+
+varying vec4 colorFrag;
+varying vec2 uvFrag;
+varying vec4 positionCS;
+varying vec4 normalCS;
+
+uniform sampler2D clusterLights;
+uniform sampler2D clusterGrid;
+uniform sampler2D clusterIndices;
+
+// The number of clusters across, up, and deep.
+uniform vec3 clusterDims;
+// The near plane, and the slices per unit of log(depth).
+uniform vec2 clusterDepth;
+// The sizes of the light texture and the index list.
+uniform vec2 clusterLightSize;
+uniform vec2 clusterIndexSize;
+// The viewport the clusters cover: x, y, width, height.
+uniform vec4 clusterViewport;
+
+#ifdef BSG_TEXTURE
+uniform sampler2D textureImage;
+#endif
+
+uniform bool twoSided;
+
+// Old drivers like a fixed bound on a loop.
+const int MAX_LIGHTS_PER_CLUSTER = 256;
+
+// Finds texel i of a table of the given size, counting across the rows.
+vec2 texelAt(float i, vec2 size) {
+  return vec2(mod(i, size.x) + 0.5, floor(i / size.x) + 0.5) / size;
+}
+
+void main() {
+
+  vec3 normal = normalize(normalCS.xyz);
+  if (twoSided && !gl_FrontFacing) normal = -normal;
+
+#ifdef BSG_TEXTURE
+  vec4 materialColor = texture2D(textureImage, uvFrag);
+#else
+  vec4 materialColor = colorFrag;
+#endif
+  float ambientCoefficient = 0.3;
+
+  vec3 eyeDirection = normalize(-positionCS.xyz);
+
+  // Which cluster are we in?
+  vec2 tile = floor((gl_FragCoord.xy - clusterViewport.xy) /
+                    clusterViewport.zw * clusterDims.xy);
+  tile = clamp(tile, vec2(0.0), clusterDims.xy - 1.0);
+  float depth = max(-positionCS.z, clusterDepth.x);
+  float slice = clamp(floor(log(depth / clusterDepth.x) * clusterDepth.y),
+                      0.0, clusterDims.z - 1.0);
+
+  float tilesPerSlice = clusterDims.x * clusterDims.y;
+  vec4 cluster = texture2D(clusterGrid,
+                           texelAt(slice * tilesPerSlice +
+                                   tile.y * clusterDims.x + tile.x,
+                                   vec2(tilesPerSlice, clusterDims.z)));
+  int first = int(cluster.r + 0.5);
+  int count = int(cluster.g + 0.5);
+
+  vec4 color = 0.05 * colorFrag;
+
+  for (int i = 0; i < MAX_LIGHTS_PER_CLUSTER; i++) {
+    if (i >= count) break;
+
+    float light = texture2D(clusterIndices,
+                            texelAt(float(first + i), clusterIndexSize)).r;
+    float column = (light + 0.5) / clusterLightSize.x;
+    vec4 lightPosition = texture2D(clusterLights, vec2(column, 0.25));
+    vec4 lightColor = texture2D(clusterLights, vec2(column, 0.75));
+
+    vec3 toLight = lightPosition.xyz - positionCS.xyz;
+    float distanceToLight = length(toLight);
+    if (distanceToLight >= lightPosition.w) continue;
+    vec3 lightDirection = toLight / distanceToLight;
+
+    // The usual falloff, brought smoothly down to zero at the edge of
+    // the light's reach, so the clusters it doesn't touch don't show.
+    float edge = distanceToLight / lightPosition.w;
+    float window = clamp(1.0 - edge * edge * edge * edge, 0.0, 1.0);
+    float attenuation = window * window /
+      (1.0 + 0.01 * distanceToLight * distanceToLight);
+
+    vec4 ambient = ambientCoefficient * lightColor * materialColor;
+
+    float cosAngleFromNormal = max(0.0, dot(normal, lightDirection));
+    vec4 diffuse = materialColor * lightColor * cosAngleFromNormal;
+
+    color += attenuation * (ambient + diffuse);
+  }
+
+  gl_FragColor = color;
+}
@@ -0,0 +1,20 @@
+#version 120
+
+// Goes with labelShader.vp.  Labels are annotations, not part of the
+// scene, so they are not lit; they are just the color they're given,
+// cut out by the glyph coverage in the font texture.
+
+varying vec4 colorFrag;
+varying vec2 uvFrag;
+varying vec4 positionWS;
+
+uniform sampler2D textureImage;
+
+void main() {
+
+  float a = texture2D(textureImage, uvFrag).r;
+
+  if (a < 0.1) discard;
+
+  gl_FragColor = vec4(colorFrag.xyz * a, 1);
+}
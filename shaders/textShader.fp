@@ -1,7 +1,7 @@
 #version 120
 
-// The number of lights is filled in before the shader is compiled.
-const int NUM_LIGHTS = XX;
+// NUM_LIGHTS, the number of lights, is defined by the shader
+// manager when the shader is compiled.
 const float MAX_DIST = 50.0;
 const float MAX_DIST_SQUARED = MAX_DIST * MAX_DIST;
 
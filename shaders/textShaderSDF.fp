@@ -0,0 +1,46 @@
+#version 120
+
+// This goes with textShader.vp, for text whose font texture was made
+// with a fontTextureMgr in signed distance field mode.  Each texel of
+// such a texture holds the distance to the nearest edge of the glyph,
+// with 0.5 right on the edge, more inside, and less outside.  Since
+// the distance interpolates smoothly, the edge stays sharp however
+// big the text gets, from glyphs rasterized at a modest size.
+
+// NUM_LIGHTS, the number of lights, is defined by the shader
+// manager when the shader is compiled.
+
+// Interpolated values from the vertex shaders
+varying vec4 colorFrag;
+varying vec2 uvFrag;
+varying vec4 positionWS;
+
+// Values that stay constant for the whole mesh.
+uniform sampler2D textureImage;
+uniform vec4 lightPositionWS[NUM_LIGHTS];
+uniform vec4 lightColor[NUM_LIGHTS];
+
+void main() {
+
+  float distance = texture2D(textureImage, uvFrag).r;
+
+  // Blend across about one pixel's worth of distance at the edge, so
+  // it is antialiased at any scale.
+  float width = fwidth(distance);
+  float a = smoothstep(0.5 - width, 0.5 + width, distance);
+
+  if (a < 0.1) discard;
+
+  vec4 materialColor = vec4(colorFrag.xyz * a, 1);
+
+  float ambientCoefficient = 0.3;
+  vec4 color = 0.5 * materialColor;
+
+  // The lighting effects are additive, so we run through the lights,
+  // and add their effects.  As in textShader.fp, that's just ambient.
+  for (int i = 0; i < NUM_LIGHTS; i++) {
+    color += ambientCoefficient * lightColor[i] * materialColor;
+  }
+
+  gl_FragColor = color;
+}
@@ -1,7 +1,7 @@
 #version 120
 
-// The number of lights is filled in before the shader is compiled.
-const int NUM_LIGHTS = XX;
+// NUM_LIGHTS, the number of lights, is defined by the shader
+// manager when the shader is compiled.
 const float MAX_DIST = 50.0;
 const float MAX_DIST_SQUARED = MAX_DIST * MAX_DIST;
 
@@ -19,8 +19,16 @@ uniform sampler2D textureImage;
 uniform vec4 lightPositionWS[NUM_LIGHTS];
 uniform vec4 lightColor[NUM_LIGHTS];
 
+// Set for objects drawn two-sided.  The back faces of those objects
+// are not separate triangles, so their normals have to be flipped
+// here.
+uniform bool twoSided;
+
 void main() {
 
+  vec4 normal = normalCS;
+  if (twoSided && !gl_FrontFacing) normal = -normal;
+
   vec4 materialColor = texture2D(textureImage, uvFrag);
   //vec4 materialColor = colorFrag;
   //0.6 * vec4(1.0, 1.0, 1.0, 1.0);
@@ -45,13 +53,13 @@ void main() {
     //  - light is at the vertical of the triangle -> 1
     //  - light is perpendicular to the triangle -> 0
     //  - light is behind the triangle -> 0
-    float cosAngleFromNormal = max(0.0, dot(normalCS, lightDirectionCS[i]));
+    float cosAngleFromNormal = max(0.0, dot(normal, lightDirectionCS[i]));
 
     // Diffuse : "color" of the object
     vec4 diffuse = materialColor * lightColor[i] * cosAngleFromNormal;
     
     // Direction in which the triangle reflects the light
-    vec4 reflectDir = reflect(-lightDirectionCS[i], normalCS);
+    vec4 reflectDir = reflect(-lightDirectionCS[i], normal);
 
     // Cosine of the angle between the Eye vector and the Reflect vector,
     // clamped to remain above 0.
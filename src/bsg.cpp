@@ -1,4 +1,6 @@
 #include "bsg.h"
+#include "bsgTextureFile.h"
+#include "bsgProfiler.h"
 #include "../external/freetype-gl/freetype-gl.h"
 
 // Stb Image library
@@ -6,8 +8,17 @@
 #include "stb_image.h"
 
 #include <time.h>
+#include <condition_variable>
+#include <sstream>
 #include <stdlib.h>
 
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #define BUFFER_OFFSET(i) ((char *)NULL + (i))
 
 namespace bsg {
@@ -23,6 +34,78 @@ void bsgUtils::printMat(const std::string& name, const glm::mat4& mat) {
   }
 }
 
+float bsgUtils::pixelsPerUnit(const glm::mat4 &modelMatrix,
+                              const glm::vec3 &center,
+                              const glm::mat4 &viewMatrix,
+                              const glm::mat4 &projMatrix) {
+
+  // A length in model space is scaled by the largest scale along the
+  // way to world space.
+  float scale = glm::max(glm::length(glm::vec3(modelMatrix[0])),
+                         glm::max(glm::length(glm::vec3(modelMatrix[1])),
+                                  glm::length(glm::vec3(modelMatrix[2]))));
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+
+  // projMatrix[1][1] is the cotangent of half the vertical field of
+  // view, so this is the number of pixels per unit of length, at
+  // unit distance.
+  float pixels = 0.5f * viewport[3] * projMatrix[1][1];
+
+  // An orthographic projection doesn't shrink things with distance.
+  if (projMatrix[3][3] == 1.0f) return scale * pixels;
+
+  glm::vec4 eye = viewMatrix * modelMatrix * glm::vec4(center, 1.0f);
+  float distance = glm::max(-eye.z, 1.0e-4f);
+
+  return scale * pixels / distance;
+}
+
+drawStats drawStats::counts;
+
+drawStats drawStats::operator-(const drawStats &other) const {
+
+  drawStats out;
+  out.drawCalls = drawCalls - other.drawCalls;
+  out.programChanges = programChanges - other.programChanges;
+  out.bufferBinds = bufferBinds - other.bufferBinds;
+  out.textureBinds = textureBinds - other.textureBinds;
+  out.uniformUploads = uniformUploads - other.uniformUploads;
+  out.bufferUploads = bufferUploads - other.bufferUploads;
+  out.bufferBytes = bufferBytes - other.bufferBytes;
+  out.textureUploads = textureUploads - other.textureUploads;
+  out.textureBytes = textureBytes - other.textureBytes;
+  return out;
+}
+
+drawStats &drawStats::operator+=(const drawStats &other) {
+
+  drawCalls += other.drawCalls;
+  programChanges += other.programChanges;
+  bufferBinds += other.bufferBinds;
+  textureBinds += other.textureBinds;
+  uniformUploads += other.uniformUploads;
+  bufferUploads += other.bufferUploads;
+  bufferBytes += other.bufferBytes;
+  textureUploads += other.textureUploads;
+  textureBytes += other.textureBytes;
+  return *this;
+}
+
+std::ostream &operator<<(std::ostream &os, const drawStats &stats) {
+
+  return os << stats.drawCalls << " draws, "
+            << stats.programChanges << " programs, "
+            << stats.bufferBinds << " buffer binds, "
+            << stats.textureBinds << " texture binds, "
+            << stats.uniformUploads << " uniforms, "
+            << stats.bufferUploads << " buffer uploads ("
+            << stats.bufferBytes << " bytes), "
+            << stats.textureUploads << " texture uploads ("
+            << stats.textureBytes << " bytes)";
+}
+
 // Get a handle for our lighting uniforms.  We are not binding the
 // attribute to a known location, just asking politely for it.  Note
 // that what is going on here is that OpenGL is actually matching
@@ -34,19 +117,21 @@ void lightList::load(const GLint programID) {
   // If there aren't any lights, don't bother.
   if (_lightPositions.size() > 0) {
 
-    _lightPositions.ID = glGetUniformLocation(programID,
-                                              _lightPositions.name.c_str());
-    _lightColors.ID = glGetUniformLocation(programID,
-                                           _lightColors.name.c_str());
+    _lightPositions.ID = shaderMgr::findUniform(programID,
+                                                _lightPositions.name);
+    _lightColors.ID = shaderMgr::findUniform(programID, _lightColors.name);
   }
 }
 
 // Update any changes to the light's position and color.  This must be
-// preceded by a glUseProgram(programID) call.
-void lightList::draw() {
+// preceded by a glUseProgram() call.  The IDs were found in load(),
+// so the plain list doesn't need the program here, but the clustered
+// one does.
+void lightList::draw(const GLint) {
 
   // If there aren't any lights, don't bother.
   if (_lightPositions.size() > 0) {
+    drawStats::counts.uniformUploads += 2;
     glUniform4fv(_lightPositions.ID,
                  _lightPositions.size(),
                  &_lightPositions.getData()[0].x);
@@ -56,18 +141,147 @@ void lightList::draw() {
   }
 }
 
-void textureMgr::readFile(const textureType& type, const std::string& fileName) {
+void lightList::addDefines(std::map<std::string, std::string> &defines) {
+
+  char numLights[16];
+  sprintf(numLights, "%d", getNumLights());
+  defines["NUM_LIGHTS"] = numLights;
+}
+
+std::map<std::string, textureMgr::residentTexture> textureMgr::_registry;
+size_t textureMgr::_residentBytes = 0;
+
+void textureMgr::_release() {
+
+  _pending = false;
+  _placeholder = bsgPtr<textureMgr>();
+
+  if (_registryKey.empty()) return;
+
+  std::map<std::string, residentTexture>::iterator it =
+    _registry.find(_registryKey);
+  if (it != _registry.end() && --it->second.users == 0) {
+    // If it's still being read, the decoder finds no entry when it's
+    // done, and throws the image away.
+    if (it->second.textureID) glDeleteTextures(1, &it->second.textureID);
+    _residentBytes -= it->second.bytes;
+    _registry.erase(it);
+  }
+
+  _registryKey.clear();
+  _textureBufferID = 0;
+}
+
+std::string textureMgr::_makeKey(const textureType &type,
+                                 const std::string &fileName,
+                                 const textureSampling &sampling) {
+
+  char key[80];
+  sprintf(key, "%d:%x:%x:%x:%g:", type, sampling.minFilter, sampling.magFilter,
+          sampling.wrap, sampling.anisotropy);
+  return key + ((type == textureCHK) ? "" : fileName);
+}
+
+// Sets the sampling of the bound texture, making mipmaps if they're
+// needed and the file didn't have them.  The bytes are increased to
+// include them.
+void textureMgr::_setSampling(const std::string &fileName,
+                              const textureSampling &sampling,
+                              const int &levels, const bool &compressed,
+                              size_t &bytes) {
+
+  // A filter that uses mipmaps needs them to exist.
+  GLenum minFilter = sampling.minFilter;
+  if (sampling.usesMipmaps()) {
+    if (levels > 1) {
+      // The file may stop short of 1x1, so tell GL where it stops.
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    } else if (compressed) {
+      // We can't decompress to make them.
+      std::cerr << "Caution: " << fileName << " has no mipmaps, "
+                << "so it will be sampled without them." << std::endl;
+      minFilter = GL_LINEAR;
+    } else if (GLEW_VERSION_3_0 || GLEW_ARB_framebuffer_object) {
+      glGenerateMipmap(GL_TEXTURE_2D);
+      bytes += bytes / 3;
+    } else if (GLEW_EXT_framebuffer_object) {
+      glGenerateMipmapEXT(GL_TEXTURE_2D);
+      bytes += bytes / 3;
+    } else {
+      std::cerr << "Caution: Can't make mipmaps for " << fileName
+                << ", so it will be sampled without them." << std::endl;
+      minFilter = GL_LINEAR;
+    }
+  }
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, sampling.magFilter);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, sampling.wrap);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, sampling.wrap);
+
+  // Anisotropic filtering takes more samples along the direction the
+  // texture is squashed in, so it stays sharp at a slant.
+  if (sampling.anisotropy > 1.0f && GLEW_EXT_texture_filter_anisotropic) {
+    static GLfloat maxAnisotropy = 0.0f;
+    if (maxAnisotropy == 0.0f)
+      glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT,
+                    std::min(sampling.anisotropy, std::max(maxAnisotropy, 1.0f)));
+  }
+}
+
+void textureMgr::readFile(const textureType& type, const std::string& fileName,
+                          const textureSampling &sampling) {
+
+  // Let go of whatever we had before.
+  _release();
+
+  // Has somebody read this one already?
+  std::string registryKey = _makeKey(type, fileName, sampling);
+  std::map<std::string, residentTexture>::iterator it =
+    _registry.find(registryKey);
+
+  // One that failed in the background is read again here, so the
+  // error gets reported, and whoever else had it keeps their share.
+  if (it != _registry.end() && !it->second.failed) {
+    it->second.users++;
+    _registryKey = registryKey;
+
+    // It may still be on its way, if it was asked for with
+    // readFileAsync().
+    if (it->second.pending) {
+      _pending = true;
+      _placeholder = get(textureCHK, "");
+      _textureBufferID = _placeholder->getTextureID();
+      return;
+    }
+
+    _textureBufferID = it->second.textureID;
+    _width = it->second.width;
+    _height = it->second.height;
+    return;
+  }
+
+  _levels = 1;
+  _compressed = false;
 
   switch(type) {
   case textureDDS:
-    throw std::runtime_error("still working on DDS, try PNG");
+    _textureBufferID = _loadDDS(fileName);
     break;
 
-  case textureBMP:
-    throw std::runtime_error("still working on BMP, try PNG");
+  case textureKTX:
+    _textureBufferID = _loadKTX(fileName);
+    break;
+
+  case textureBSG:
+    _textureBufferID = _loadBSGT(fileName);
     break;
 
+  // stb_image reads all of these.
   case texturePNG:
+  case textureJPG:
+  case textureBMP:
     _textureBufferID = _loadPNG(fileName);
     break;
 
@@ -81,9 +295,285 @@ void textureMgr::readFile(const textureType& type, const std::string& fileName)
   default:
     throw std::runtime_error("What texture type is this?");
   }
+
+  drawStats::counts.textureBinds++;
+  glBindTexture(GL_TEXTURE_2D, _textureBufferID);
+  _setSampling(fileName, sampling, _levels, _compressed, _bytes);
+
+  residentTexture entry;
+  entry.textureID = _textureBufferID;
+  entry.users = 1;
+  entry.width = _width;
+  entry.height = _height;
+  entry.bytes = _bytes;
+  entry.pending = false;
+  entry.failed = false;
+  if (it != _registry.end()) entry.users += it->second.users;
+  _registry[registryKey] = entry;
+  _residentBytes += _bytes;
+  _registryKey = registryKey;
+}
+
+// The images read in the background are decoded by a pool of worker
+// threads.  The decoded images wait in the done list until the render
+// thread sends them to the GPU.  Nothing here touches OpenGL or the
+// registry, which belong to the render thread.
+struct textureJob {
+  std::string registryKey;
+  std::string fileName;
+  textureSampling sampling;
+  unsigned char *data;
+  int width, height, components;
+};
+
+class textureDecoder {
+ private:
+  std::vector<std::thread> _workers;
+  std::list<textureJob *> _todo;
+  std::list<textureJob *> _done;
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  bool _stopping;
+
+  void _work() {
+    while (true) {
+      textureJob *job;
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _wake.wait(lock, [this]() { return _stopping || !_todo.empty(); });
+        if (_stopping) return;
+        job = _todo.front();
+        _todo.pop_front();
+      }
+
+      // Three components stay three; anything else becomes four.
+      int components = 0;
+      job->data = NULL;
+      if (stbi_info(job->fileName.c_str(), &job->width, &job->height,
+                    &components)) {
+        job->components = (components == 3) ? 3 : 4;
+        job->data = stbi_load(job->fileName.c_str(), &job->width,
+                              &job->height, &components, job->components);
+      }
+
+      std::unique_lock<std::mutex> lock(_mutex);
+      _done.push_back(job);
+    }
+  }
+
+ public:
+  textureDecoder() : _stopping(false) {
+
+    // The flag is global in stb_image, so set it before there are
+    // any threads to race over it.  The render thread sets it to the
+    // same thing.
+    stbi_set_flip_vertically_on_load(true);
+
+    unsigned int n = std::thread::hardware_concurrency();
+    n = (n > 1) ? n - 1 : 1;
+    for (unsigned int i = 0; i < n; i++)
+      _workers.push_back(std::thread(&textureDecoder::_work, this));
+  };
+
+  ~textureDecoder() {
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _stopping = true;
+    }
+    _wake.notify_all();
+    for (size_t i = 0; i < _workers.size(); i++) _workers[i].join();
+
+    for (std::list<textureJob *>::iterator it = _todo.begin();
+         it != _todo.end(); it++) delete *it;
+    for (std::list<textureJob *>::iterator it = _done.begin();
+         it != _done.end(); it++) {
+      stbi_image_free((*it)->data);
+      delete *it;
+    }
+  };
+
+  void add(textureJob *job) {
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _todo.push_back(job);
+    }
+    _wake.notify_one();
+  };
+
+  textureJob *next() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_done.empty()) return NULL;
+    textureJob *job = _done.front();
+    _done.pop_front();
+    return job;
+  };
+
+  // The one pool, started the first time it's needed, and stopped
+  // when the program exits.
+  static textureDecoder &get() {
+    static textureDecoder decoder;
+    return decoder;
+  };
+};
+
+void textureMgr::readFileAsync(const std::string &fileName,
+                               const textureSampling &sampling) {
+
+  // If it's already here, or on its way, this is no different.
+  std::string registryKey = _makeKey(texturePNG, fileName, sampling);
+  std::map<std::string, residentTexture>::iterator it =
+    _registry.find(registryKey);
+  if (it != _registry.end() && !it->second.failed) {
+    readFile(texturePNG, fileName, sampling);
+    return;
+  }
+
+  _release();
+
+  // If it failed before, it is tried again, and the others who had
+  // it are still counted.
+  residentTexture entry;
+  entry.textureID = 0;
+  entry.users = 1;
+  it = _registry.find(registryKey);
+  if (it != _registry.end()) entry.users += it->second.users;
+  entry.width = entry.height = 0;
+  entry.bytes = 0;
+  entry.pending = true;
+  entry.failed = false;
+  _registry[registryKey] = entry;
+  _registryKey = registryKey;
+
+  textureJob *job = new textureJob;
+  job->registryKey = registryKey;
+  job->fileName = fileName;
+  job->sampling = sampling;
+  textureDecoder::get().add(job);
+
+  // Something to look at in the meantime.
+  _pending = true;
+  _placeholder = get(textureCHK, "");
+  _textureBufferID = _placeholder->getTextureID();
+  _width = _placeholder->getWidth();
+  _height = _placeholder->getHeight();
+}
+
+int textureMgr::uploadPending(const size_t &maxBytes) {
+
+  BSG_PROFILE_SCOPE("textureMgr::uploadPending");
+
+  static GLuint pixelBuffer = 0;
+
+  int nUploaded = 0;
+  size_t nBytes = 0;
+  textureJob *job;
+  while (nBytes < maxBytes && (job = textureDecoder::get().next())) {
+
+    // Is anybody still waiting for it?
+    std::map<std::string, residentTexture>::iterator it =
+      _registry.find(job->registryKey);
+    if (it == _registry.end() || !it->second.pending) {
+      stbi_image_free(job->data);
+      delete job;
+      continue;
+    }
+    residentTexture &entry = it->second;
+    entry.pending = false;
+
+    if (!job->data) {
+      std::cerr << "Caution: Can't read texture " << job->fileName
+                << std::endl;
+      entry.failed = true;
+      delete job;
+      continue;
+    }
+
+    size_t size = (size_t)job->width * job->height * job->components;
+    GLenum format = (job->components == 3) ? GL_RGB : GL_RGBA;
+
+    glGenTextures(1, &entry.textureID);
+    drawStats::counts.textureBinds++;
+    glBindTexture(GL_TEXTURE_2D, entry.textureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    drawStats::counts.textureUpload(size);
+
+    if (GLEW_ARB_pixel_buffer_object) {
+      // Copy the pixels into a buffer the driver owns, and it sends
+      // them along to the texture on its own time, instead of
+      // making us wait.  Asking for new storage each time means we
+      // never wait for the last upload to finish, either.
+      if (!pixelBuffer) glGenBuffers(1, &pixelBuffer);
+      drawStats::counts.bufferBinds += 2;
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, pixelBuffer);
+      glBufferData(GL_PIXEL_UNPACK_BUFFER_ARB, size, NULL, GL_STREAM_DRAW);
+      void *mapped = glMapBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY);
+      if (mapped) {
+        memcpy(mapped, job->data, size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER_ARB);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, job->width, job->height, 0,
+                     format, GL_UNSIGNED_BYTE, (const GLvoid *)0);
+      } else {
+        drawStats::counts.bufferBinds++;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, job->width, job->height, 0,
+                     format, GL_UNSIGNED_BYTE, job->data);
+      }
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+    } else {
+      glTexImage2D(GL_TEXTURE_2D, 0, format, job->width, job->height, 0,
+                   format, GL_UNSIGNED_BYTE, job->data);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    entry.bytes = size;
+    _setSampling(job->fileName, job->sampling, 1, false, entry.bytes);
+    entry.width = job->width;
+    entry.height = job->height;
+    _residentBytes += entry.bytes;
+
+    nBytes += size;
+    nUploaded++;
+
+    stbi_image_free(job->data);
+    delete job;
+  }
+
+  return nUploaded;
 }
 
-fontTextureMgr::fontTextureMgr(): textureMgr() {
+int textureMgr::getNumPending() {
+
+  // The registry knows what's on its way, without asking the workers.
+  int n = 0;
+  for (std::map<std::string, residentTexture>::iterator it = _registry.begin();
+       it != _registry.end(); it++) {
+    if (it->second.pending) n++;
+  }
+  return n;
+}
+
+// Switches to the real image, if it has arrived.
+void textureMgr::_checkPending() {
+
+  std::map<std::string, residentTexture>::iterator it =
+    _registry.find(_registryKey);
+  if (it == _registry.end() || it->second.pending) return;
+
+  _pending = false;
+
+  // If it couldn't be read, the checkerboard stays.
+  if (it->second.failed) return;
+
+  _textureBufferID = it->second.textureID;
+  _width = it->second.width;
+  _height = it->second.height;
+  _placeholder = bsgPtr<textureMgr>();
+}
+
+const float fontTextureMgr::defaultFontSize = 200.0f;
+const float fontTextureMgr::defaultSDFFontSize = 40.0f;
+
+fontTextureMgr::fontTextureMgr(const bool &sdf): textureMgr(), _sdf(sdf) {
   // Texture atlas stores individual glyphs. The point of the atlas is to pack
   // as many glyphs as possible into a small space. See this blog post 
   // http://wdobbie.com/post/gpu-text-rendering-with-vector-textures/
@@ -91,89 +581,318 @@ fontTextureMgr::fontTextureMgr(): textureMgr() {
   // I chose this size atlas somewhat arbitrarily. This number is big enough
   // to make a texture that doesn't look pixellated. But if you bump up the
   // font size (below), you will likely need to bump up the size of the
-  // atlas, as well.
-  _width = 2048;
-  _height = 2048;
+  // atlas, as well.  If it fills up anyway, it grows, up to _maxSize.
+  // A distance field keeps its edges sharp from far smaller glyphs,
+  // so the atlas can be a quarter the size each way.
+  if (_sdf) {
+    _width = 512;
+    _height = 512;
+    _fontSize = defaultSDFFontSize;
+  } else {
+    _width = 2048;
+    _height = 2048;
+    _fontSize = defaultFontSize;
+  }
   _atlas = texture_atlas_new(_width, _height, 1);
+
+  _maxSize = 4096;
+  _generation = 0;
+  _textureAllocated = false;
+  _textureBufferID = 0;
+  _dirtyX0 = _dirtyY0 = _dirtyX1 = _dirtyY1 = 0;
+}
+
+fontTextureMgr::~fontTextureMgr() {
+
+  if (_worker.joinable()) _worker.join();
+
+  if (_textureAllocated) glDeleteTextures(1, &_textureBufferID);
+
+  for (std::map<fontKey, texture_font_t *>::iterator it = _fontsMap.begin();
+       it != _fontsMap.end(); it++) {
+    if (it->second) texture_font_delete(it->second);
+  }
+  texture_atlas_delete(_atlas);
 }
 
 void fontTextureMgr::readFile(const textureType& type, const std::string& fileName) {
   switch (type) {
   case textureTTF:
-    _textureBufferID = _loadTTF(fileName);
+    addFont(fileName, _fontSize);
     break;
   default:
     throw std::runtime_error("What texture type is this?");
   }
 }
 
+void fontTextureMgr::addFont(const std::string &fileName, const float &size) {
+  std::lock_guard<std::recursive_mutex> lock(_mutex);
+
+  if (getFont(fileName, size)) return;
+  _loadTTF(fileName, size);
+}
+
 // If this texture manager is a font, we need to be able to return a
 // texture_font_t object so that somebody can access crucial info
 // such as the location of a glyph in the text atlas (the texture), and how much
 // kerning it should get, for the specific font in question (indicated by
 // fileName). If this texture manager doesn't have that particular font loaded
 // alread, it returns null to let the user know they should load it in.
-texture_font_t *fontTextureMgr::getFont(const std::string &fileName) {
-  return _fontsMap[fileName];
+texture_font_t *fontTextureMgr::getFont(const std::string &fileName,
+                                        const float &size) {
+  std::lock_guard<std::recursive_mutex> lock(_mutex);
+
+  std::map<fontKey, texture_font_t *>::iterator it =
+    _fontsMap.find(fontKey(fileName, size));
+  return (it == _fontsMap.end()) ? NULL : it->second;
 }
 
-GLuint fontTextureMgr::_loadTTF(const std::string ttfPath) {
+void fontTextureMgr::_loadTTF(const std::string ttfPath, const float &size) {
   // std::cout << "loading ttf " << ttfPath << std::endl;
 
   // Build a new texture font from its description and size. This texture_font_t
   // object will be in charge of building bitmap glyphs, putting them in the
   // atlas, and storing information about their coordinates in the atlas
   // and how much kerning each individual glyph gets, etc.
-  // Same as above, I chose a font size arbitrarily, just using one that seemed
-  // to work and allow us to avoid pixellation.
-  // #TODO: eventually in the future, it would be ideal to choose both the font
-  // size and the atlas size intelligently, based on the size of the text the
-  // user of this interface requested. For now, we don't handle that yet.
-  // On the other hand, however, note that we are planning to allow users to
-  // reuse font atlases since they can fit multiple fonts. Does this change the
-  // design choices we will make around this?
-  texture_font_t *font = texture_font_new_from_file(_atlas, 200, ttfPath.c_str());
-  _fontsMap[ttfPath] = font;
-
-  // Cache some glyphs to speed things up.
-  texture_font_load_glyphs(font,
-                          (std::string(" !\"#$%&'()*+,-./0123456789:;<=>?") +
-                          std::string("@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_") +
-                          std::string("`abcdefghijklmnopqrstuvwxyz{|}~")).c_str());
-
-  // Generate one texture and store its ID in the texture variable. Then, since
-  // OpenGL is a state machine, bind that texture so OpenGL knows to use it
-  // until it's told otherwise.
-  GLuint texture;
-  glGenTextures(1, &texture);
-  glBindTexture(GL_TEXTURE_2D, texture);
+  // The glyphs themselves aren't made until somebody asks for them, so
+  // any character in the font can be used, and the ones that never
+  // are don't take up room in the atlas.
+  texture_font_t *font = _newFont(_atlas, ttfPath, size);
+  if (!font)
+    throw std::runtime_error("Can't read font file: " + ttfPath);
+  _fontsMap[fontKey(ttfPath, size)] = font;
 
-  // These are some preferences we set, instructing OpenGL how to use the
-  // currently bound texture. Setting WRAP to CLAMP is sort of like setting
-  // CSS background-repeat: no-repeat. It means tex coords will be clamped to
-  // one repetition of the texture, rather than allowing the texture to
-  // repeat in a tiled way.
-  glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
-  glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
-
-  // And setting MIN_FILTER and MAG_FILTER to GL_NEAREST means that when
-  // deciding what color to make a particular pixel in world space, based upon
-  // the texture we are working with, it just chooses the nearest pixel
-  // rather than using any kind of linear interpolation.
-  glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
-  glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
-
-  // Sets up how the texture image is defined in memory. We give it a width
-  // and a height, and send it the data present in _atlas->data.
-  glTexImage2D( GL_TEXTURE_2D, 0, GL_RED, _atlas->width, _atlas->height,
-                0, GL_RED, GL_UNSIGNED_BYTE, _atlas->data );
-  return texture;
+  // The texture itself is made at the first draw, when the glyphs
+  // are there to go in it.
+}
+
+texture_font_t *fontTextureMgr::_newFont(texture_atlas_t *atlas,
+                                         const std::string &fileName,
+                                         const float &size) {
+
+  texture_font_t *font = texture_font_new_from_file(atlas, size, fileName.c_str());
+
+  // freetype-gl computes the distance field itself, out to the
+  // padding around each glyph, so leave it some room.
+  if (font && _sdf) {
+    font->rendermode = RENDER_SIGNED_DISTANCE_FIELD;
+    font->padding = 4;
+  }
+  return font;
+}
+
+void fontTextureMgr::_markDirty(const texture_glyph_t *glyph) {
+
+  // The glyph's region in the atlas, with a little extra to cover
+  // any padding around it.
+  const size_t pad = 4;
+  size_t x0 = glyph->s0 * _atlas->width;
+  size_t y0 = glyph->t0 * _atlas->height;
+  size_t x1 = std::min(_atlas->width, x0 + glyph->width + 2 * pad);
+  size_t y1 = std::min(_atlas->height, y0 + glyph->height + 2 * pad);
+  x0 = (x0 > pad) ? x0 - pad : 0;
+  y0 = (y0 > pad) ? y0 - pad : 0;
+
+  if (_dirtyX1 <= _dirtyX0 || _dirtyY1 <= _dirtyY0) {
+    _dirtyX0 = x0; _dirtyY0 = y0;
+    _dirtyX1 = x1; _dirtyY1 = y1;
+  } else {
+    _dirtyX0 = std::min(_dirtyX0, x0);
+    _dirtyY0 = std::min(_dirtyY0, y0);
+    _dirtyX1 = std::max(_dirtyX1, x1);
+    _dirtyY1 = std::max(_dirtyY1, y1);
+  }
+}
+
+void fontTextureMgr::_resetAtlas() {
+
+  // Grow if we can, otherwise just start over at the same size, and
+  // the glyphs that are still in use will be made again as they are
+  // asked for.
+  size_t width = _atlas->width;
+  size_t height = _atlas->height;
+  if (2 * width <= _maxSize && 2 * height <= _maxSize) {
+    width *= 2;
+    height *= 2;
+  }
+
+  std::cerr << "Font atlas is full, starting over at "
+            << width << "x" << height << "." << std::endl;
+
+  texture_atlas_t *atlas = texture_atlas_new(width, height, 1);
+
+  for (std::map<fontKey, texture_font_t *>::iterator it = _fontsMap.begin();
+       it != _fontsMap.end(); it++) {
+    texture_font_delete(it->second);
+    it->second = _newFont(atlas, it->first.first, it->first.second);
+  }
+
+  texture_atlas_delete(_atlas);
+  _atlas = atlas;
+  _width = width;
+  _height = height;
+
+  _textureAllocated = false;
+  _dirtyX0 = _dirtyY0 = _dirtyX1 = _dirtyY1 = 0;
+  _generation++;
+}
+
+texture_glyph_t *fontTextureMgr::_getGlyph(texture_font_t *font,
+                                           const char *codepoint,
+                                           const bool &canReset) {
+
+  texture_glyph_t *glyph = texture_font_find_glyph(font, codepoint);
+  if (glyph) return glyph;
+
+  // Not there yet, so rasterize it.  This comes back null if there's
+  // no room left in the atlas.
+  glyph = texture_font_get_glyph(font, codepoint);
+  if (!glyph) {
+    if (!canReset) return NULL;
+
+    // The fonts are all made over, so find this one's key first.
+    fontKey key;
+    for (std::map<fontKey, texture_font_t *>::iterator it = _fontsMap.begin();
+         it != _fontsMap.end(); it++) {
+      if (it->second == font) key = it->first;
+    }
+
+    _resetAtlas();
+    font = _fontsMap[key];
+    if (!font) return NULL;
+    glyph = texture_font_get_glyph(font, codepoint);
+    if (!glyph) return NULL;
+  }
+
+  _markDirty(glyph);
+  return glyph;
+}
+
+texture_glyph_t *fontTextureMgr::getGlyph(const std::string &fileName,
+                                          const float &size,
+                                          const char *codepoint) {
+  std::lock_guard<std::recursive_mutex> lock(_mutex);
+
+  texture_font_t *font = getFont(fileName, size);
+  if (!font) {
+    addFont(fileName, size);
+    font = getFont(fileName, size);
+  }
+
+  return _getGlyph(font, codepoint, true);
+}
+
+float fontTextureMgr::getKerning(const texture_glyph_t *glyph,
+                                 const char *previous) {
+  std::lock_guard<std::recursive_mutex> lock(_mutex);
+
+  return texture_glyph_get_kerning(glyph, previous);
+}
+
+void fontTextureMgr::preloadGlyphs(const std::string &fileName,
+                                   const float &size,
+                                   const std::string &text,
+                                   const bool &background) {
+
+  if (!getFont(fileName, size)) addFont(fileName, size);
+
+  // Only one of these at a time.
+  if (_worker.joinable()) _worker.join();
+
+  if (!background) {
+    for (size_t i = 0; i < text.size(); i += bsgUtils::utf8Length(&text[i]))
+      getGlyph(fileName, size, &text[i]);
+    return;
+  }
+
+  // The worker takes the lock for one glyph at a time, so the drawing
+  // thread can get in between.  It doesn't start the atlas over if it
+  // fills up, since that would pull glyphs out from under whoever is
+  // drawing; it just stops, and leaves the rest to be made on demand.
+  _worker = std::thread([this, fileName, size, text]() {
+      for (size_t i = 0; i < text.size();
+           i += bsgUtils::utf8Length(&text[i])) {
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
+        texture_font_t *font = getFont(fileName, size);
+        if (!font || !_getGlyph(font, &text[i], false)) break;
+      }
+    });
+}
+
+void fontTextureMgr::_upload() {
+  std::lock_guard<std::recursive_mutex> lock(_mutex);
+
+  // Usually there's nothing new.
+  bool dirty = (_dirtyX1 > _dirtyX0 && _dirtyY1 > _dirtyY0);
+  if (_textureAllocated && !dirty) return;
+
+  if (_textureBufferID == 0) {
+    // Generate one texture and store its ID in the texture variable. Then, since
+    // OpenGL is a state machine, bind that texture so OpenGL knows to use it
+    // until it's told otherwise.
+    glGenTextures(1, &_textureBufferID);
+    drawStats::counts.textureBinds++;
+    glBindTexture(GL_TEXTURE_2D, _textureBufferID);
+
+    // These are some preferences we set, instructing OpenGL how to use the
+    // currently bound texture. Setting WRAP to CLAMP is sort of like setting
+    // CSS background-repeat: no-repeat. It means tex coords will be clamped to
+    // one repetition of the texture, rather than allowing the texture to
+    // repeat in a tiled way.
+    glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+    glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+
+    // And setting MIN_FILTER and MAG_FILTER to GL_NEAREST means that when
+    // deciding what color to make a particular pixel in world space, based upon
+    // the texture we are working with, it just chooses the nearest pixel
+    // rather than using any kind of linear interpolation.  A distance
+    // field is the exception: interpolating it is the whole point.
+    GLfloat filter = _sdf ? GL_LINEAR : GL_NEAREST;
+    glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter );
+    glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter );
+  } else {
+    drawStats::counts.textureBinds++;
+    glBindTexture(GL_TEXTURE_2D, _textureBufferID);
+  }
+
+  // The atlas rows are one byte per pixel, with no padding.
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  if (!_textureAllocated) {
+    // Sets up how the texture image is defined in memory. We give it a width
+    // and a height, and send it the data present in _atlas->data.  This
+    // happens the first time, and again whenever the atlas starts over.
+    drawStats::counts.textureUpload(_atlas->width * _atlas->height);
+    glTexImage2D( GL_TEXTURE_2D, 0, GL_RED, _atlas->width, _atlas->height,
+                  0, GL_RED, GL_UNSIGNED_BYTE, _atlas->data );
+    _textureAllocated = true;
+
+  } else {
+    // Just the rectangle that has new glyphs in it.
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, _atlas->width);
+    drawStats::counts.textureUpload((_dirtyX1 - _dirtyX0) * (_dirtyY1 - _dirtyY0));
+    glTexSubImage2D(GL_TEXTURE_2D, 0, _dirtyX0, _dirtyY0,
+                    _dirtyX1 - _dirtyX0, _dirtyY1 - _dirtyY0,
+                    GL_RED, GL_UNSIGNED_BYTE,
+                    _atlas->data + _dirtyY0 * _atlas->width + _dirtyX0);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+  }
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  _dirtyX0 = _dirtyY0 = _dirtyX1 = _dirtyY1 = 0;
+}
+
+void fontTextureMgr::draw() {
+
+  _upload();
+  textureMgr::draw();
 }
 
 GLuint textureMgr::_loadCheckerBoard (const int size, int numFields) {
   const int boardSize = 64;
   _width = size;
   _height = size;
+  _bytes = size * size * 3;
   int fieldWidth = size/numFields;
 
   GLubyte image[boardSize][boardSize][3];
@@ -191,11 +910,11 @@ GLuint textureMgr::_loadCheckerBoard (const int size, int numFields) {
 
   GLuint texture;
   glGenTextures(1, &texture);
+  drawStats::counts.textureBinds++;
   glBindTexture(GL_TEXTURE_2D, texture);
+  drawStats::counts.textureUpload(_width * _height * 3);
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, _width, _height,
                0, GL_RGB, GL_UNSIGNED_BYTE, image);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
   return texture;
 }
@@ -347,19 +1066,327 @@ GLuint textureMgr::_loadPNG(const std::string imagePath) {
   if (!data) {
 	  throw(stbi_failure_reason());
   }
-  // Generate the OpenGL texture object
+  _width = width;
+  _height = height;
+
+  // Generate the OpenGL texture object.  We asked stb for four
+  // components whatever the file has, so that's what the data is.
   GLuint texture;
   glGenTextures(1, &texture);
+  drawStats::counts.textureBinds++;
   glBindTexture(GL_TEXTURE_2D, texture);
-  if (components == 3) {
-	  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height,
-		  0, GL_RGB, GL_UNSIGNED_BYTE, data);
-  } else if (components == 4) {
-	  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height,
-		  0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+  GLint internalFormat = (components == 4) ? GL_RGBA : GL_RGB;
+  drawStats::counts.textureUpload(width * height * 4);
+  glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height,
+               0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+  _bytes = width * height * ((components == 4) ? 4 : 3);
+  stbi_image_free(data);
+
+  return texture;
+}
+
+// Reads a whole binary file, for the DDS and KTX readers.
+static void readImageFile(const std::string &imagePath,
+                          std::vector<char> &bytes) {
+
+  std::ifstream in(imagePath.c_str(), std::ios::in | std::ios::binary);
+  if (!in.is_open())
+    throw std::runtime_error("Cannot open: " + imagePath);
+
+  bytes.assign(std::istreambuf_iterator<char>(in),
+               std::istreambuf_iterator<char>());
+}
+
+// Both formats are little-endian, and so is everything we run on.
+static GLuint readU32(const std::vector<char> &bytes, const size_t &offset) {
+
+  GLuint value;
+  memcpy(&value, &bytes[offset], 4);
+  return value;
+}
+
+// Complains if the GPU can't read this compressed format.  Formats we
+// don't know about are left for GL to complain about.
+static void checkCompression(const std::string &imagePath,
+                             const GLenum &internalFormat) {
+
+  switch (internalFormat) {
+  case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+  case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+  case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+  case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+    if (!GLEW_EXT_texture_compression_s3tc)
+      throw std::runtime_error(imagePath + " is S3TC compressed, and this GPU can't read that.");
+    break;
+
+  case GL_COMPRESSED_RGBA_BPTC_UNORM_ARB:
+  case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM_ARB:
+    if (!GLEW_ARB_texture_compression_bptc)
+      throw std::runtime_error(imagePath + " is BC7 compressed, and this GPU can't read that.");
+    break;
   }
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+// Makes a texture out of a chain of mipmap levels, each half the size
+// of the last, starting with the full-size image.
+GLuint textureMgr::_uploadLevels(const GLenum &internalFormat,
+                                 const GLenum &format, const GLenum &type,
+                                 const bool &compressed,
+                                 const int &width, const int &height,
+                                 const std::vector<const char *> &data,
+                                 const std::vector<size_t> &sizes) {
+
+  GLuint texture;
+  glGenTextures(1, &texture);
+  drawStats::counts.textureBinds++;
+  glBindTexture(GL_TEXTURE_2D, texture);
+
+  _bytes = 0;
+  for (size_t level = 0; level < data.size(); level++) {
+    int w = std::max(1, width >> level);
+    int h = std::max(1, height >> level);
+
+    if (compressed) {
+      glCompressedTexImage2D(GL_TEXTURE_2D, level, internalFormat, w, h, 0,
+                             sizes[level], data[level]);
+    } else {
+      glTexImage2D(GL_TEXTURE_2D, level, internalFormat, w, h, 0,
+                   format, type, data[level]);
+    }
+    drawStats::counts.textureUpload(sizes[level]);
+    _bytes += sizes[level];
+  }
+
+  _width = width;
+  _height = height;
+  _levels = data.size();
+  _compressed = compressed;
+
+  return texture;
+}
+
+GLuint textureMgr::_loadDDS(const std::string imagePath) {
+
+  std::vector<char> bytes;
+  readImageFile(imagePath, bytes);
+
+  // A four-byte magic number, then a 124-byte header.
+  if (bytes.size() < 128 || memcmp(&bytes[0], "DDS ", 4) != 0)
+    throw std::runtime_error(imagePath + " is not a DDS file.");
+
+  int height = readU32(bytes, 12);
+  int width = readU32(bytes, 16);
+  int levels = std::max(1, (int)readU32(bytes, 28));
+  GLuint pixelFlags = readU32(bytes, 80);
+  const char *fourCC = &bytes[84];
+
+  if (readU32(bytes, 112) & 0x200)
+    throw std::runtime_error(imagePath + " is a cube map, which we can't use yet.");
+
+  GLenum internalFormat = 0, format = 0;
+  int blockBytes = 0, pixelBytes = 0;
+  size_t offset = 128;
+
+  if (pixelFlags & 0x4) {
+    // Compressed, named by the FourCC code.  BC7 only comes with the
+    // longer DX10 header, which names the format by DXGI number.
+    if (memcmp(fourCC, "DXT1", 4) == 0) {
+      internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    } else if (memcmp(fourCC, "DXT3", 4) == 0) {
+      internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+    } else if (memcmp(fourCC, "DXT5", 4) == 0) {
+      internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    } else if (memcmp(fourCC, "DX10", 4) == 0 && bytes.size() >= 148) {
+      offset = 148;
+      // The rest of the DX10 header: the dimension (3 is 2D), flags
+      // (4 is a cube), and the number of array slices.
+      if (readU32(bytes, 136) & 0x4)
+        throw std::runtime_error(imagePath + " is a cube map, which we can't use yet.");
+      if (readU32(bytes, 132) != 3)
+        throw std::runtime_error(imagePath + " is not a 2D texture, which is all we can use yet.");
+      if (readU32(bytes, 140) != 1)
+        throw std::runtime_error(imagePath + " is a texture array, which we can't use yet.");
+      switch (readU32(bytes, 128)) {
+      case 71: case 72: internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; break;
+      case 74: case 75: internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT; break;
+      case 77: case 78: internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; break;
+      case 98: internalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM_ARB; break;
+      case 99: internalFormat = GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM_ARB; break;
+      case 28: case 29: internalFormat = GL_RGBA; format = GL_RGBA; break;
+      }
+    }
+    if (internalFormat && !format)
+      blockBytes = (internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT) ? 8 : 16;
+  } else if (pixelFlags & 0x40) {
+    // Not compressed: 24 or 32 bits, in RGB or BGR order.
+    int bits = readU32(bytes, 88);
+    bool redFirst = (readU32(bytes, 92) == 0xff);
+    if (bits == 32) {
+      internalFormat = GL_RGBA;
+      format = redFirst ? GL_RGBA : GL_BGRA;
+    } else if (bits == 24) {
+      internalFormat = GL_RGB;
+      format = redFirst ? GL_RGB : GL_BGR;
+    }
+  }
+  if (format) pixelBytes = (internalFormat == GL_RGBA) ? 4 : 3;
+
+  if (!internalFormat)
+    throw std::runtime_error(imagePath + " is in a DDS format we can't read.");
+  if (blockBytes) checkCompression(imagePath, internalFormat);
+
+  // The levels follow one another, with no padding.
+  std::vector<const char *> data;
+  std::vector<size_t> sizes;
+  for (int level = 0; level < levels; level++) {
+    size_t w = std::max(1, width >> level);
+    size_t h = std::max(1, height >> level);
+    size_t size = blockBytes ?
+      ((w + 3) / 4) * ((h + 3) / 4) * blockBytes : w * h * pixelBytes;
+    if (offset + size > bytes.size())
+      throw std::runtime_error(imagePath + " is cut short.");
+
+    data.push_back(&bytes[offset]);
+    sizes.push_back(size);
+    offset += size;
+  }
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  GLuint texture = _uploadLevels(internalFormat, format, GL_UNSIGNED_BYTE,
+                                 blockBytes > 0, width, height, data, sizes);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  return texture;
+}
+
+GLuint textureMgr::_loadKTX(const std::string imagePath) {
+
+  std::vector<char> bytes;
+  readImageFile(imagePath, bytes);
+
+  static const unsigned char identifier[12] =
+    { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+  if (bytes.size() < 64 || memcmp(&bytes[0], identifier, 12) != 0)
+    throw std::runtime_error(imagePath + " is not a KTX file.");
+  if (readU32(bytes, 12) != 0x04030201)
+    throw std::runtime_error(imagePath + " was written big-endian.");
+
+  GLenum type = readU32(bytes, 16);
+  GLenum format = readU32(bytes, 24);
+  GLenum internalFormat = readU32(bytes, 28);
+  int width = readU32(bytes, 36);
+  int height = std::max(1, (int)readU32(bytes, 40));
+  int levels = std::max(1, (int)readU32(bytes, 56));
+
+  if (readU32(bytes, 44) > 0 || readU32(bytes, 48) > 0 || readU32(bytes, 52) > 1)
+    throw std::runtime_error(imagePath + " is not a plain 2D texture.");
+
+  // A type of zero means compressed.
+  bool compressed = (type == 0);
+  if (compressed) checkCompression(imagePath, internalFormat);
+
+  // Skip the key/value pairs.  Each level starts with its size, and
+  // is padded out to four bytes, as are the rows within it, which is
+  // what GL expects by default.
+  size_t offset = 64 + readU32(bytes, 60);
+  std::vector<const char *> data;
+  std::vector<size_t> sizes;
+  for (int level = 0; level < levels; level++) {
+    if (offset + 4 > bytes.size())
+      throw std::runtime_error(imagePath + " is cut short.");
+    size_t size = readU32(bytes, offset);
+    offset += 4;
+    if (offset + size > bytes.size())
+      throw std::runtime_error(imagePath + " is cut short.");
+
+    data.push_back(&bytes[offset]);
+    sizes.push_back(size);
+    offset += (size + 3) & ~(size_t)3;
+  }
+
+  return _uploadLevels(internalFormat, format, type, compressed,
+                       width, height, data, sizes);
+}
+
+// The file is mapped into memory instead of read, so the pixels go
+// from the page cache to the driver without another copy of our own.
+GLuint textureMgr::_loadBSGT(const std::string imagePath) {
+
+#ifdef WIN32
+  std::vector<char> contents;
+  readImageFile(imagePath, contents);
+  const char *bytes = contents.empty() ? NULL : &contents[0];
+  size_t length = contents.size();
+#else
+  int fd = open(imagePath.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("Cannot open: " + imagePath);
+
+  struct stat status;
+  size_t length = (fstat(fd, &status) == 0) ? status.st_size : 0;
+  void *mapped = length ?
+    mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+  close(fd);
+  if (mapped == MAP_FAILED)
+    throw std::runtime_error("Cannot map: " + imagePath);
+  const char *bytes = (const char *)mapped;
+#endif
+
+  bsgTextureFileHeader header;
+  std::vector<const char *> data;
+  std::vector<size_t> sizes;
+  std::string problem;
+
+  if (length < sizeof(header)) {
+    problem = imagePath + " is not a .bsgt file.";
+  } else {
+    memcpy(&header, bytes, sizeof(header));
+    size_t tableEnd = sizeof(header) +
+      (size_t)header.levels * sizeof(bsgTextureFileLevel);
+
+    if (memcmp(header.magic, "BSGT", 4) != 0) {
+      problem = imagePath + " is not a .bsgt file.";
+    } else if (header.version != bsgTextureFileVersion) {
+      problem = imagePath + " is from a different version of bsgTexConvert.";
+    } else if (header.levels < 1 || tableEnd > length) {
+      problem = imagePath + " is cut short.";
+    } else {
+      for (uint32_t level = 0; level < header.levels; level++) {
+        bsgTextureFileLevel entry;
+        memcpy(&entry, bytes + sizeof(header) + level * sizeof(entry),
+               sizeof(entry));
+        if (entry.offset + entry.size > length) {
+          problem = imagePath + " is cut short.";
+          break;
+        }
+        data.push_back(bytes + entry.offset);
+        sizes.push_back(entry.size);
+      }
+    }
+  }
+
+  GLuint texture = 0;
+  if (problem.empty()) {
+    try {
+      bool compressed = (header.type == 0);
+      if (compressed) checkCompression(imagePath, header.internalFormat);
+
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+      texture = _uploadLevels(header.internalFormat, header.format,
+                              header.type, compressed,
+                              header.width, header.height, data, sizes);
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    } catch (std::exception &e) {
+      problem = e.what();
+    }
+  }
+
+#ifndef WIN32
+  munmap(mapped, length);
+#endif
+
+  if (!problem.empty())
+    throw std::runtime_error(problem);
 
   return texture;
 }
@@ -367,17 +1394,20 @@ GLuint textureMgr::_loadPNG(const std::string imagePath) {
 void textureMgr::load(const GLuint programID) {
 
   // Get a handle for the texture uniform.
-  _textureAttribID = glGetUniformLocation(programID,
-                                          _textureAttribName.c_str());
+  _textureAttribID = shaderMgr::findUniform(programID, _textureAttribName);
 }
 
 void textureMgr::draw() {
 
+  if (_pending) _checkPending();
+
   // Bind the texture in Texture Unit 0
   glActiveTexture(GL_TEXTURE0);
+  drawStats::counts.textureBinds++;
   glBindTexture(GL_TEXTURE_2D, _textureBufferID);
 
   // Set our "myTextureSampler" sampler to user Texture Unit 0
+  drawStats::counts.uniformUploads++;
   glUniform1i(_textureAttribID, 0);
 
   // The data is actually loaded into the buffer in the loadXX() method.
@@ -416,153 +1446,625 @@ std::string shaderMgr::_getProgramInfoLog(GLuint obj) {
   }
 }
 
+// Reads a shader file, and the files it #includes.  Each file is only
+// included once, which also keeps a file from including itself.
+std::string shaderMgr::_readSource(const std::string &fileName,
+                                   std::set<std::string> &included,
+                                   const int &depth) {
+
+  if (depth > 16)
+    throw std::runtime_error("Shader includes nested too deep: " + fileName);
+
+  if (!included.insert(fileName).second) return "";
+
+  std::ifstream shaderStream(fileName.c_str(), std::ios::in);
+  if (!shaderStream.is_open())
+    throw std::runtime_error("Cannot open: " + fileName);
+
+  // Included files are found relative to this one.
+  std::string dir;
+  size_t slash = fileName.find_last_of("/\\");
+  if (slash != std::string::npos) dir = fileName.substr(0, slash + 1);
+
+  std::string text, line;
+  while (getline(shaderStream, line)) {
+
+    size_t start = line.find_first_not_of(" \t");
+    if (start != std::string::npos &&
+        line.compare(start, 8, "#include") == 0) {
+      size_t open = line.find_first_of("\"<", start + 8);
+      size_t close = (open == std::string::npos) ? open :
+        line.find_first_of("\">", open + 1);
+      if (close == std::string::npos)
+        throw std::runtime_error("Bad #include in " + fileName + ": " + line);
+
+      std::string includeFile = line.substr(open + 1, close - open - 1);
+      if (includeFile[0] != '/') includeFile = dir + includeFile;
+      text += _readSource(includeFile, included, depth + 1);
+      continue;
+    }
+
+    text += "\n" + line;
+  }
+
+  return text;
+}
+
 void shaderMgr::addShader(const GLSHADERTYPE type,
                           const std::string& shaderFile) {
 
-  // Read the shader code from the given file.
-  std::ifstream shaderStream(shaderFile.c_str(), std::ios::in);
-  if (shaderStream.is_open()) {
-    std::string line = "";
+  // Read the shader code from the given file, and whatever it
+  // includes, into the appropriate _shaderSource slot.
+  std::set<std::string> included;
+  _shaderSource[type] += _readSource(shaderFile, included, 0);
 
-    // Suck all the text into the appropriate _shaderText slot.
-    while(getline(shaderStream, line)) _shaderText[type] += "\n" + line;
+  _shaderFiles[type] = shaderFile;
+}
 
-    // Close the stream.
-    shaderStream.close();
+// The symbols a variant is compiled with, for the present state of
+// the lights, texture, and defines.
+std::map<std::string, std::string> shaderMgr::_variantDefines() {
 
-  } else {
-    throw std::runtime_error("Cannot open: " + shaderFile);
+  std::map<std::string, std::string> defines = _defines;
+
+  _lightList->addDefines(defines);
+
+  if (_textureLoaded) defines["BSG_TEXTURE"] = "1";
+
+  return defines;
+}
+
+std::string shaderMgr::_variantKey(const std::map<std::string,
+                                   std::string> &defines) {
+
+  std::string key;
+  for (std::map<std::string, std::string>::const_iterator it = defines.begin();
+       it != defines.end(); it++) {
+    key += it->first + "=" + it->second + ";";
   }
+  return key;
+}
 
-  _shaderFiles[type] = shaderFile;
+// Is the word in the text, not as part of a longer name?
+static bool hasWord(const std::string &text, const std::string &word) {
 
-  if (_lightList->getNumLights() > 0) {
-    // Edit the shader source to reflect the input number of lights.  If
-    // there is no 'XX' in the shader code, this will cause an ugly
-    // error we have to catch.
-    char numLightsAsString[5];
-    sprintf(numLightsAsString, "%d", _lightList->getNumLights());
-    try {
-      _shaderText[type].replace(_shaderText[type].find("XX"), 2,
-                                numLightsAsString);
-    } catch (...) {
-      std::cerr << "Caution: Shader ("
-                << shaderFile
-                << ") does not care about number of lights." << std::endl;
+  for (size_t at = text.find(word); at != std::string::npos;
+       at = text.find(word, at + 1)) {
+    size_t end = at + word.size();
+    bool wordStart = (at == 0) || !(isalnum(text[at - 1]) || text[at - 1] == '_');
+    bool wordEnd = (end == text.size()) ||
+      !(isalnum(text[end]) || text[end] == '_');
+    if (wordStart && wordEnd) return true;
+  }
+  return false;
+}
+
+// Does this shader source need lights to compile?  It does if the
+// code (not a comment) uses NUM_LIGHTS or XX, unless it tests
+// NUM_LIGHTS with #if and friends, in which case it presumably copes
+// with none.
+static bool needsLights(const std::string &source) {
+
+  // Blank out the comments, keeping the line breaks.
+  std::string code = source;
+  for (size_t i = 0; i < code.size(); i++) {
+    if (code.compare(i, 2, "//") == 0) {
+      while (i < code.size() && code[i] != '\n') code[i++] = ' ';
+    } else if (code.compare(i, 2, "/*") == 0) {
+      size_t end = code.find("*/", i + 2);
+      end = (end == std::string::npos) ? code.size() : end + 2;
+      for (; i < end; i++) if (code[i] != '\n') code[i] = ' ';
+      i--;
     }
-  } else {
-    if (_shaderText[type].find("XX") != std::string::npos) {
-      std::cerr << "Caution: Shader ("
-                << shaderFile
-                << ") is meant to use lights, and you have added no lights."
-                << std::endl;
+  }
+
+  bool uses = false;
+  std::istringstream lines(code);
+  std::string line;
+  while (std::getline(lines, line)) {
+    size_t first = line.find_first_not_of(" \t");
+    if (first != std::string::npos && line[first] == '#') {
+      if ((line.compare(first, 3, "#if") == 0 ||
+           line.compare(first, 5, "#elif") == 0) &&
+          hasWord(line, "NUM_LIGHTS")) return false;
+    } else if (hasWord(line, "NUM_LIGHTS") || hasWord(line, "XX")) {
+      uses = true;
+    }
+  }
+  return uses;
+}
+
+// Puts the defines into a shader's source.  They have to go after the
+// #version line, since nothing but comments may come before it.
+std::string shaderMgr::_preprocess(const GLSHADERTYPE &type,
+                                   const std::map<std::string,
+                                   std::string> &defines) {
+
+  std::string source = _shaderSource[type];
+  if (source.empty()) return source;
+
+  std::string defineText;
+  for (std::map<std::string, std::string>::const_iterator it = defines.begin();
+       it != defines.end(); it++) {
+    defineText += "\n#define " + it->first + " " + it->second;
+  }
+
+  size_t insertAt = 0;
+  size_t version = source.find("#version");
+  if (version != std::string::npos) {
+    insertAt = source.find('\n', version);
+    if (insertAt == std::string::npos) insertAt = source.size();
+  }
+  source.insert(insertAt, defineText);
+
+  // The old way to get the number of lights in was to write 'XX' for
+  // it, so fill those in, too.
+  std::map<std::string, std::string>::const_iterator n =
+    defines.find("NUM_LIGHTS");
+  const std::string numLights = (n == defines.end()) ? "0" : n->second;
+  for (size_t xx = source.find("XX"); xx != std::string::npos;
+       xx = source.find("XX", xx)) {
+    bool wordStart = (xx == 0) || !(isalnum(source[xx - 1]) || source[xx - 1] == '_');
+    bool wordEnd = (xx + 2 == source.size()) ||
+      !(isalnum(source[xx + 2]) || source[xx + 2] == '_');
+    if (wordStart && wordEnd) {
+      source.replace(xx, 2, numLights);
+      xx += numLights.size();
+    } else {
+      xx += 2;
+    }
+  }
+
+  if (numLights == "0" && needsLights(_shaderSource[type])) {
+    std::cerr << "Caution: Shader ("
+              << _shaderFiles[type]
+              << ") is meant to use lights, and you have added no lights."
+              << std::endl;
+  }
+
+  return source;
+}
+
+std::map<uint64_t, shaderMgr::cachedProgram> shaderMgr::_programCache;
+std::string shaderMgr::_binaryCacheDir;
+bool shaderMgr::_binaryCacheDirSet = false;
+
+shaderMgr::~shaderMgr() {
+
+  // Let go of the programs, and delete any we were the last one
+  // using.
+  for (std::map<std::string, variant>::iterator v = _variants.begin();
+       v != _variants.end(); v++) {
+    std::map<uint64_t, cachedProgram>::iterator it =
+      _programCache.find(v->second.hash);
+    if (it != _programCache.end() &&
+        it->second.programID == v->second.programID) {
+      if (--it->second.users > 0) continue;
+      for (int type = GLSHADER_VERTEX; type <= GLSHADER_GEOMETRY; type++)
+        if (it->second.shaderIDs[type]) glDeleteShader(it->second.shaderIDs[type]);
+      _programCache.erase(it);
+    }
+    _programInfo.erase(v->second.programID);
+    glDeleteProgram(v->second.programID);
+  }
+}
+
+uint64_t shaderMgr::hashString(const std::string &text, const uint64_t &seed) {
+
+  uint64_t hash = seed;
+  for (size_t i = 0; i < text.size(); i++) {
+    hash ^= (unsigned char)text[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+// Identifies the driver, so binaries from some other one aren't used.
+uint64_t shaderMgr::_driverHash() {
+
+  static uint64_t hash = 0;
+  if (hash == 0) {
+    GLenum names[4] = { GL_VENDOR, GL_RENDERER, GL_VERSION,
+                        GL_SHADING_LANGUAGE_VERSION };
+    hash = 14695981039346656037ULL;
+    for (int i = 0; i < 4; i++) {
+      const char *value = (const char *)glGetString(names[i]);
+      if (value) hash = hashString(std::string(value) + "\n", hash);
     }
   }
+  return hash;
+}
+
+std::string shaderMgr::_binaryFileName(const uint64_t &hash) {
+
+  char name[32];
+  sprintf(name, "%016llx.bin", (unsigned long long)hash);
+  return _binaryCacheDir + "/" + name;
+}
+
+// The binary files start with this header, then the program binary.
+struct programBinaryHeader {
+  char magic[4];
+  uint64_t driverHash;
+  GLenum format;
+  GLint length;
+};
+
+bool shaderMgr::_loadBinary(const uint64_t &hash, GLuint &programID) {
+
+  if (_binaryCacheDir.empty() || !GLEW_ARB_get_program_binary) return false;
+
+  std::ifstream in(_binaryFileName(hash).c_str(),
+                   std::ios::in | std::ios::binary);
+  if (!in.is_open()) return false;
+
+  programBinaryHeader header;
+  in.read((char *)&header, sizeof(header));
+  if (!in || strncmp(header.magic, "BSGP", 4) != 0 ||
+      header.driverHash != _driverHash() || header.length <= 0)
+    return false;
+
+  std::vector<char> binary(header.length);
+  in.read(&binary[0], header.length);
+  if (!in) return false;
+
+  programID = glCreateProgram();
+  glProgramBinary(programID, header.format, &binary[0], header.length);
+
+  // The driver can refuse a binary for its own reasons, in which case
+  // we just compile it after all.
+  GLint linked = GL_FALSE;
+  glGetProgramiv(programID, GL_LINK_STATUS, &linked);
+  if (linked != GL_TRUE) {
+    glDeleteProgram(programID);
+    return false;
+  }
+  return true;
+}
+
+void shaderMgr::_saveBinary(const uint64_t &hash, const GLuint &programID) {
+
+  if (_binaryCacheDir.empty() || !GLEW_ARB_get_program_binary) return;
+
+  GLint linked = GL_FALSE;
+  glGetProgramiv(programID, GL_LINK_STATUS, &linked);
+  if (linked != GL_TRUE) return;
+
+  programBinaryHeader header;
+  memcpy(header.magic, "BSGP", 4);
+  header.driverHash = _driverHash();
+  glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &header.length);
+  if (header.length <= 0) return;
+
+  std::vector<char> binary(header.length);
+  glGetProgramBinary(programID, header.length, NULL, &header.format,
+                     &binary[0]);
+
+  std::ofstream out(_binaryFileName(hash).c_str(),
+                    std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!out.is_open()) {
+    std::cerr << "Caution: Can't write shader cache file "
+              << _binaryFileName(hash) << std::endl;
+    return;
+  }
+  out.write((const char *)&header, sizeof(header));
+  out.write(&binary[0], header.length);
+}
+
+// Finds or makes the program for the text in _shaderText.
+GLuint shaderMgr::_acquireProgram(const uint64_t &hash) {
+
+  // Somebody in this process has compiled it already?
+  std::map<uint64_t, cachedProgram>::iterator it = _programCache.find(hash);
+  if (it != _programCache.end()) {
+    it->second.users++;
+    return it->second.programID;
+  }
+
+  // Some earlier run, then?  If not, start compiling it.  It's saved
+  // for next time when it's finished.
+  cachedProgram entry;
+  entry.users = 1;
+  entry.pending = false;
+  for (int i = 0; i < 3; i++) entry.shaderIDs[i] = 0;
+  if (_loadBinary(hash, entry.programID)) {
+    _reflect(entry.programID);
+  } else {
+    _startBuild(entry);
+  }
+
+  _programCache[hash] = entry;
+
+  return entry.programID;
+}
+
+shaderMgr::cachedProgram *shaderMgr::_programInUse() {
+
+  std::map<std::string, variant>::iterator v = _variants.find(_variantInUse);
+  if (v == _variants.end()) return NULL;
+
+  std::map<uint64_t, cachedProgram>::iterator it =
+    _programCache.find(v->second.hash);
+  if (it == _programCache.end()) return NULL;
+
+  return &(it->second);
+}
+
+bool shaderMgr::isReady() {
+
+  if (!_compiled) return false;
+
+  cachedProgram *program = _programInUse();
+  if (!program || !program->pending) return true;
+
+  // Asking for the link status would make us wait, but the extension
+  // lets us ask whether it's done without that.
+  if (GLEW_KHR_parallel_shader_compile) {
+    GLint done = GL_FALSE;
+    glGetProgramiv(program->programID, GL_COMPLETION_STATUS_KHR, &done);
+    if (done != GL_TRUE) return false;
+  }
+
+  _finishBuild(_variants[_variantInUse].hash, *program);
+  return true;
+}
+
+void shaderMgr::waitUntilReady() {
+
+  if (!_compiled) compileShaders();
+
+  cachedProgram *program = _programInUse();
+  if (program && program->pending)
+    _finishBuild(_variants[_variantInUse].hash, *program);
+}
+
+// Makes the program match the lights, texture, and defines, compiling
+// a new variant if this combination hasn't been seen before.
+void shaderMgr::_selectVariant() {
+
+  // Nothing that goes into the key has changed.
+  if (_compiled && _version == _selectedVersion &&
+      _lightList->getVersion() == _selectedLightsVersion) return;
+  _selectedVersion = _version;
+  _selectedLightsVersion = _lightList->getVersion();
+
+  std::map<std::string, std::string> defines = _variantDefines();
+  std::string key = _variantKey(defines);
+  if (_compiled && key == _variantInUse) return;
+
+  std::map<std::string, variant>::iterator it = _variants.find(key);
+  if (it == _variants.end()) {
+
+    for (int type = GLSHADER_VERTEX; type <= GLSHADER_GEOMETRY; type++)
+      _shaderText[type] = _preprocess((GLSHADERTYPE)type, defines);
+
+    // The key for the program cache is the whole text of the program.
+    variant v;
+    v.hash = hashString(_shaderText[GLSHADER_VERTEX]);
+    v.hash = hashString(std::string(1, '\0'), v.hash);
+    v.hash = hashString(_shaderText[GLSHADER_FRAGMENT], v.hash);
+    v.hash = hashString(std::string(1, '\0'), v.hash);
+    v.hash = hashString(_shaderText[GLSHADER_GEOMETRY], v.hash);
+    v.programID = _acquireProgram(v.hash);
+
+    it = _variants.insert(std::pair<std::string, variant>(key, v)).first;
+  }
+
+  _programID = it->second.programID;
+  _variantInUse = key;
 }
 
 void shaderMgr::compileShaders() {
 
+  if (!_binaryCacheDirSet) {
+    const char *dir = getenv("BSG_SHADER_CACHE");
+    setBinaryCacheDir(dir ? dir : "");
+  }
+
+  _selectVariant();
+  _compiled = true;
+}
+
+// Hands the shaders to the driver to compile and link, without asking
+// how it went, since asking makes us wait for the answer.
+void shaderMgr::_startBuild(cachedProgram &entry) {
+
+  // Let the driver use as many threads as it likes.
+  static bool threadsSet = false;
+  if (!threadsSet && GLEW_KHR_parallel_shader_compile) {
+    glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    threadsSet = true;
+  }
+
   // geom is true if there *is* a geometry shader in place.
   bool geom = (!_shaderText[GLSHADER_GEOMETRY].empty());
 
-  _shaderIDs[GLSHADER_VERTEX] = glCreateShader(GL_VERTEX_SHADER);
-  _shaderIDs[GLSHADER_FRAGMENT] = glCreateShader(GL_FRAGMENT_SHADER);
-  if (geom) _shaderIDs[GLSHADER_GEOMETRY] = glCreateShader(GL_GEOMETRY_SHADER);
+  GLenum glTypes[3] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER,
+                        GL_GEOMETRY_SHADER };
+
+  // Now create a program to contain our two (or three) shaders.
+  entry.programID = glCreateProgram();
 
-  // The OpenGL calls don't really like the modern C++ types, so we
-  // convert back to old-fashioned char*.
-  const char* vs = _shaderText[GLSHADER_VERTEX].c_str();
-  const char* fs = _shaderText[GLSHADER_FRAGMENT].c_str();
-  const char* gs;
-  if (geom) gs = _shaderText[GLSHADER_GEOMETRY].c_str();
+  for (int type = GLSHADER_VERTEX; type <= GLSHADER_GEOMETRY; type++) {
+    entry.shaderFiles[type] = _shaderFiles[type];
+    if (type == GLSHADER_GEOMETRY && !geom) continue;
 
-  // Feed the shader source to OpenGL.
-  glShaderSource(_shaderIDs[GLSHADER_VERTEX], 1, &vs, NULL);
-  glShaderSource(_shaderIDs[GLSHADER_FRAGMENT], 1, &fs, NULL);
-  if (geom) glShaderSource(_shaderIDs[GLSHADER_GEOMETRY], 1, &gs, NULL);
+    // The OpenGL calls don't really like the modern C++ types, so we
+    // convert back to old-fashioned char*.
+    const char *text = _shaderText[type].c_str();
+
+    // Feed the shader source to OpenGL, compile it, and attach it.
+    entry.shaderIDs[type] = glCreateShader(glTypes[type]);
+    glShaderSource(entry.shaderIDs[type], 1, &text, NULL);
+    glCompileShader(entry.shaderIDs[type]);
+    glAttachShader(entry.programID, entry.shaderIDs[type]);
+  }
+
+  // If we're going to save the binary, the driver has to know before
+  // the link.
+  if (!_binaryCacheDir.empty() && GLEW_ARB_get_program_binary)
+    glProgramParameteri(entry.programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                        GL_TRUE);
+
+  // Assemble the shaders into a single program with 'link', which
+  // will make sure that the inputs to the fragment shader correspond
+  // with outputs from the vertex shader, and so on.
+  glLinkProgram(entry.programID);
+
+  entry.pending = true;
+}
+
+// Reports any errors from the compile and link, and cleans up.  This
+// waits for the driver if it isn't done yet.
+void shaderMgr::_finishBuild(const uint64_t &hash, cachedProgram &entry) {
+
+  const char *kinds[3] = { "Vertex", "Fragment", "Geometry" };
 
-  // Compile the shader source.  If there are any errors, print them.
   std::string errorLog;
-  glCompileShader(_shaderIDs[GLSHADER_VERTEX]);
-  errorLog = _getShaderInfoLog(_shaderIDs[GLSHADER_VERTEX]);
+  for (int type = GLSHADER_VERTEX; type <= GLSHADER_GEOMETRY; type++) {
+    if (entry.shaderIDs[type] == 0) continue;
+
+    errorLog = _getShaderInfoLog(entry.shaderIDs[type]);
+    if (errorLog.size() > 1) {
+      std::cerr << "** " << kinds[type] << " compile error in "
+                << entry.shaderFiles[type]
+                << std::endl << errorLog << std::endl;
+    }
+  }
+
+  errorLog = _getProgramInfoLog(entry.programID);
   if (errorLog.size() > 1) {
-    std::cerr << "** Vertex compile error in "
-              << _shaderFiles[GLSHADER_VERTEX]
+    std::cerr << "** Shader link error in "
+              << entry.shaderFiles[GLSHADER_VERTEX] << ", "
+              << entry.shaderFiles[GLSHADER_FRAGMENT] << ", "
+              << entry.shaderFiles[GLSHADER_GEOMETRY]
               << std::endl << errorLog << std::endl;
-    //std::cerr << _shaderText[GLSHADER_VERTEX] << std::endl;
   }
 
+  // The shaders are linked into the program, so we can delete the raw
+  // shaders.
+  for (int type = GLSHADER_VERTEX; type <= GLSHADER_GEOMETRY; type++) {
+    if (entry.shaderIDs[type] == 0) continue;
+    glDeleteShader(entry.shaderIDs[type]);
+    entry.shaderIDs[type] = 0;
+  }
 
-  glCompileShader(_shaderIDs[GLSHADER_FRAGMENT]);
-  errorLog = _getShaderInfoLog(_shaderIDs[GLSHADER_FRAGMENT]);
-  if (errorLog.size() > 1)
-    std::cerr << "** Fragment compile error in "
-              << _shaderFiles[GLSHADER_FRAGMENT]
-              << std::endl << errorLog << std::endl;
+  entry.pending = false;
+
+  _reflect(entry.programID);
+  _saveBinary(hash, entry.programID);
+}
+
+std::unordered_map<GLuint, shaderMgr::programInfo> shaderMgr::_programInfo;
+
+// Lists the active uniforms and attributes of a newly linked program.
+void shaderMgr::_reflect(const GLuint &programID) {
+
+  programInfo &info = _programInfo[programID];
+  info.uniforms.clear();
+  info.attribs.clear();
+
+  GLint linked = GL_FALSE;
+  glGetProgramiv(programID, GL_LINK_STATUS, &linked);
+  if (linked != GL_TRUE) return;
+
+  GLint maxLength = 0, maxAttribLength = 0;
+  glGetProgramiv(programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+  glGetProgramiv(programID, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxAttribLength);
+  std::vector<char> name(std::max(std::max(maxLength, maxAttribLength), 1) + 1);
+
+  GLint count = 0;
+  glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &count);
+  for (GLint i = 0; i < count; i++) {
+    shaderVariable v;
+    GLsizei length = 0;
+    glGetActiveUniform(programID, i, name.size(), &length, &v.size, &v.type,
+                       &name[0]);
+    std::string uniformName(&name[0], length);
+    v.location = glGetUniformLocation(programID, uniformName.c_str());
+    info.uniforms[uniformName] = v;
+
+    // Arrays come back as "name[0]", but can be asked for as just
+    // "name", so file them both ways.
+    size_t bracket = uniformName.rfind("[0]");
+    if (bracket != std::string::npos && bracket + 3 == uniformName.size())
+      info.uniforms[uniformName.substr(0, bracket)] = v;
+  }
 
-  if (geom) {
-    glCompileShader(_shaderIDs[GLSHADER_GEOMETRY]);
-    errorLog = _getShaderInfoLog(_shaderIDs[GLSHADER_GEOMETRY]);
-    if (errorLog.size() > 1)
-      std::cerr << "** Geometry compile error in "
-                << _shaderFiles[GLSHADER_GEOMETRY]
-                << std::endl << errorLog << std::endl;
+  glGetProgramiv(programID, GL_ACTIVE_ATTRIBUTES, &count);
+  for (GLint i = 0; i < count; i++) {
+    shaderVariable v;
+    GLsizei length = 0;
+    glGetActiveAttrib(programID, i, name.size(), &length, &v.size, &v.type,
+                      &name[0]);
+    std::string attribName(&name[0], length);
+    v.location = glGetAttribLocation(programID, attribName.c_str());
+    info.attribs[attribName] = v;
   }
+}
 
-  // Now create a program to contain our two (or three) shaders, and
-  // attach the shaders to it.
-  _programID = glCreateProgram();
-  glAttachShader(_programID, _shaderIDs[GLSHADER_VERTEX]);
-  glAttachShader(_programID, _shaderIDs[GLSHADER_FRAGMENT]);
-  if (geom) glAttachShader(_programID, _shaderIDs[GLSHADER_GEOMETRY]);
+GLint shaderMgr::_find(const GLuint &programID, const std::string &name,
+                       const bool &uniform) {
 
-  // Assemble the shaders into a single program with 'link', which
-  // will make sure that the inputs to the fragment shader correspond
-  // with outputs from the vertex shader, and so on.
-  glLinkProgram(_programID);
-  errorLog = _getProgramInfoLog(_programID);
-  if (errorLog.size() > 1) {
-    std::cerr << "** Shader link error in"
-              << _shaderFiles[GLSHADER_VERTEX] << ", "
-              << _shaderFiles[GLSHADER_FRAGMENT] << ", "
-              << _shaderFiles[GLSHADER_GEOMETRY]
-              << std::endl << errorLog << std::endl;
+  std::unordered_map<GLuint, programInfo>::iterator it =
+    _programInfo.find(programID);
+  if (it == _programInfo.end()) {
+    return uniform ? glGetUniformLocation(programID, name.c_str()) :
+      glGetAttribLocation(programID, name.c_str());
   }
 
-  // The shaders are linked into the program, so we can delete the raw
-  // shaders.
-  glDeleteShader(_shaderIDs[GLSHADER_VERTEX]);
-  glDeleteShader(_shaderIDs[GLSHADER_FRAGMENT]);
-  if (geom) glDeleteShader(_shaderIDs[GLSHADER_GEOMETRY]);
-
-  _compiled = true;
+  shaderVariableTable &table = uniform ? it->second.uniforms : it->second.attribs;
+  shaderVariableTable::iterator v = table.find(name);
+  return (v == table.end()) ? -1 : v->second.location;
 }
 
+// These don't wait for a program that's still compiling, since that
+// would undo the point of compiling in the background.
 GLuint shaderMgr::getAttribID(const std::string& attribName) {
-  glUseProgram(_programID);
-  return glGetAttribLocation(_programID, attribName.c_str());
+  if (!isReady()) return -1;
+  return _find(_programID, attribName, false);
 }
 
 GLuint shaderMgr::getUniformID(const std::string& unifName) {
-  glUseProgram(_programID);
-  return glGetUniformLocation(_programID, unifName.c_str());
+  if (!isReady()) return -1;
+  return _find(_programID, unifName, true);
+}
+
+const shaderVariableTable &shaderMgr::getUniforms() {
+  waitUntilReady();
+  return _programInfo[_programID].uniforms;
+}
+
+const shaderVariableTable &shaderMgr::getAttribs() {
+  waitUntilReady();
+  return _programInfo[_programID].attribs;
 }
 
 void shaderMgr::addLights(const bsgPtr<lightList> lightList) {
-  if (_compiled) {
-    throw std::runtime_error("Must load lights before compiling shader.");
-  } else {
-    _lightList = lightList;
-  }
+  _lightList = lightList;
+  _version++;
 }
 
 void shaderMgr::load() {
+
+  BSG_PROFILE_SCOPE("shaderMgr::load");
+
+  // The lights, texture, or defines may have changed since the last
+  // time, and want a different variant of the program.
+  if (_compiled) _selectVariant();
+
+  // Asking about a program that is still compiling would make us wait
+  // for it, so don't.
+  if (!isReady()) return;
+
+  drawStats::counts.programChanges++;
+  glUseProgram(_programID);
   _lightList->load(_programID);
   if (_textureLoaded) _texture->load(_programID);
 }
 
 void shaderMgr::draw() {
-  _lightList->draw();
+  _lightList->draw(_programID);
   if (_textureLoaded) _texture->draw();
 }
 
@@ -572,13 +2074,16 @@ void drawableObj::addData(const GLDATATYPE type,
 
   switch(type) {
   case(GLDATA_VERTICES):
-    _vertices = drawableObjData<glm::vec4>(name, data);
+    _vertices.name = name;
+    _vertices.setData(data);
     break;
   case(GLDATA_COLORS):
-    _colors = drawableObjData<glm::vec4>(name, data);
+    _colors.name = name;
+    _colors.setData(data);
     break;
   case(GLDATA_NORMALS):
-    _normals = drawableObjData<glm::vec4>(name, data);
+    _normals.name = name;
+    _normals.setData(data);
     break;
   case(GLDATA_TEXCOORDS):
     throw std::runtime_error("Do not use vec4 for texture coordinates.");
@@ -593,7 +2098,50 @@ void drawableObj::addData(const GLDATATYPE type,
 
   switch(type) {
   case(GLDATA_TEXCOORDS):
-    _uvs = drawableObjData<glm::vec2>(name, data);
+    _uvs.name = name;
+    _uvs.setData(data);
+    break;
+  case(GLDATA_COLORS):
+  case(GLDATA_NORMALS):
+  case(GLDATA_VERTICES):
+    throw std::runtime_error("Vec2 is only for texture coordinates.");
+    break;
+  }
+  _loadedIntoBuffer = false;
+}
+
+void drawableObj::swapData(const GLDATATYPE type,
+                           const std::string& name,
+                           std::vector<glm::vec4>& data) {
+
+  switch(type) {
+  case(GLDATA_VERTICES):
+    _vertices.name = name;
+    _vertices.swapData(data);
+    break;
+  case(GLDATA_COLORS):
+    _colors.name = name;
+    _colors.swapData(data);
+    break;
+  case(GLDATA_NORMALS):
+    _normals.name = name;
+    _normals.swapData(data);
+    break;
+  case(GLDATA_TEXCOORDS):
+    throw std::runtime_error("Do not use vec4 for texture coordinates.");
+    break;
+  }
+  _loadedIntoBuffer = false;
+}
+
+void drawableObj::swapData(const GLDATATYPE type,
+                           const std::string& name,
+                           std::vector<glm::vec2>& data) {
+
+  switch(type) {
+  case(GLDATA_TEXCOORDS):
+    _uvs.name = name;
+    _uvs.swapData(data);
     break;
   case(GLDATA_COLORS):
   case(GLDATA_NORMALS):
@@ -664,6 +2212,94 @@ void drawableObj::setData(const GLDATATYPE type,
   _loadedIntoBuffer = false;
 }
 
+void drawableObj::_markDirty(const size_t &first, const size_t &n) {
+
+  if (_dirtyEnd <= _dirtyBegin) {
+    _dirtyBegin = first;
+    _dirtyEnd = first + n;
+  } else {
+    _dirtyBegin = std::min(_dirtyBegin, first);
+    _dirtyEnd = std::max(_dirtyEnd, first + n);
+  }
+
+  // The interleaved buffer is rebuilt and sent again whole.
+  if (_interleaved) _loadedIntoBuffer = false;
+}
+
+void drawableObj::updateData(const GLDATATYPE type,
+                             const size_t &first,
+                             const std::vector<glm::vec4> &data) {
+
+  if (data.empty()) return;
+
+  drawableObjData<glm::vec4> *target;
+  switch(type) {
+  case(GLDATA_VERTICES):
+    target = &_vertices;
+    break;
+  case(GLDATA_COLORS):
+    target = &_colors;
+    break;
+  case(GLDATA_NORMALS):
+    target = &_normals;
+    break;
+  case(GLDATA_TEXCOORDS):
+  default:
+    throw std::runtime_error("Do not use vec4 for texture coordinates.");
+  }
+
+  if (first + data.size() > target->size())
+    throw std::runtime_error("updateData can't make the data any longer.");
+
+  target->updateData(first, data);
+  _markDirty(first, data.size());
+}
+
+void drawableObj::updateData(const GLDATATYPE type,
+                             const size_t &first,
+                             const std::vector<glm::vec2> &data) {
+
+  if (data.empty()) return;
+
+  if (type != GLDATA_TEXCOORDS)
+    throw std::runtime_error("Vec2 is only for texture coordinates.");
+
+  if (first + data.size() > _uvs.size())
+    throw std::runtime_error("updateData can't make the data any longer.");
+
+  _uvs.updateData(first, data);
+  _markDirty(first, data.size());
+}
+
+std::vector<glm::vec4> drawableObj::getData(const GLDATATYPE type) {
+
+  switch(type) {
+  case(GLDATA_VERTICES):
+    return _vertices.getData();
+  case(GLDATA_COLORS):
+    return _colors.getData();
+  case(GLDATA_NORMALS):
+    return _normals.getData();
+  case(GLDATA_TEXCOORDS):
+  default:
+    throw std::runtime_error("Texture coordinates are vec2, use getTexCoords().");
+  }
+}
+
+void drawableObj::setIndices(const std::vector<GLuint> &indices) {
+
+  _indices.setData(indices);
+  _count = indices.empty() ? _vertices.size() : indices.size();
+  _indicesChanged = true;
+}
+
+void drawableObj::swapIndices(std::vector<GLuint> &indices) {
+
+  _indices.swapData(indices);
+  _count = _indices.empty() ? _vertices.size() : _indices.size();
+  _indicesChanged = true;
+}
+
 bool drawableObj::insideBoundingBox(const glm::vec4 &testPoint,
                                     const glm::mat4 &modelMatrix) {
 
@@ -685,7 +2321,7 @@ void drawableObj::_getAttribLocations(GLuint programID) {
 
   bool badID = false;
 
-  _vertices.ID = glGetAttribLocation(programID, _vertices.name.c_str());
+  _vertices.ID = shaderMgr::findAttrib(programID, _vertices.name);
 
   // Check to make sure the ID awarded is sane.  If not, probably the
   // name does not match the name in the shader.
@@ -695,7 +2331,7 @@ void drawableObj::_getAttribLocations(GLuint programID) {
   }
 
   if (!_colors.empty()) {
-    _colors.ID = glGetAttribLocation(programID, _colors.name.c_str());
+    _colors.ID = shaderMgr::findAttrib(programID, _colors.name);
 
     if (_colors.ID < 0) {
       std::cerr << "** Caution: Bad ID for colors attribute '" << _colors.name << "'" << std::endl;
@@ -703,7 +2339,7 @@ void drawableObj::_getAttribLocations(GLuint programID) {
     }
   }
   if (!_normals.empty()) {
-    _normals.ID = glGetAttribLocation(programID, _normals.name.c_str());
+    _normals.ID = shaderMgr::findAttrib(programID, _normals.name);
 
     if (_normals.ID < 0) {
       std::cerr << "** Caution: Bad ID for normals attribute '" << _normals.name << "'" << std::endl;
@@ -711,7 +2347,7 @@ void drawableObj::_getAttribLocations(GLuint programID) {
     }
   }
   if (!_uvs.empty()) {
-    _uvs.ID = glGetAttribLocation(programID, _uvs.name.c_str());
+    _uvs.ID = shaderMgr::findAttrib(programID, _uvs.name);
 
     if (_uvs.ID < 0) {
       std::cerr << "** Caution: Bad ID for texture attribute '" << _uvs.name << "'" << std::endl;
@@ -724,6 +2360,24 @@ void drawableObj::_getAttribLocations(GLuint programID) {
   }
 }
 
+bsgPtr<drawableObj> drawableObj::copy() {
+
+  bsgPtr<drawableObj> out = new drawableObj(*this);
+
+  out->_vertices.bufferID = 0;
+  out->_colors.bufferID = 0;
+  out->_normals.bufferID = 0;
+  out->_uvs.bufferID = 0;
+  out->_indices.bufferID = 0;
+  out->_interleavedData.bufferID = 0;
+  out->_loadedIntoBuffer = false;
+  out->_dirtyBegin = out->_dirtyEnd = 0;
+  out->_indicesChanged = false;
+  out->_indexBufferSize = 0;
+
+  return out;
+}
+
 void drawableObj::findBoundingBox() {
 
   // Find the bounding box for this object.
@@ -766,6 +2420,15 @@ void drawableObj::prepare(GLuint programID) {
 
   if (!_haveBoundingBox) findBoundingBox();
 
+  // The buffers are only made and filled once.  Preparing again for
+  // another program, like a new variant of the shader, only finds the
+  // attribute locations in that program.
+  GLuint bufferID = _interleaved ? _interleavedData.bufferID : _vertices.bufferID;
+  if (bufferID != 0) {
+    _getAttribLocations(programID);
+    return;
+  }
+
   if (_interleaved) {
     _prepareInterleaved(programID);
   } else {
@@ -796,9 +2459,19 @@ void drawableObj::_prepareInterleaved(GLuint programID) {
 
   // Prepare a data buffer for the interleaved data.
   glGenBuffers(1, &_interleavedData.bufferID);
+  if (!_indices.empty()) glGenBuffers(1, &_indices.bufferID);
+
+  _getAttribLocations(programID);
+
+  _loadInterleaved();
+}
 
-  // Now interleave the data.
-  for (int i = 0; i < _vertices.size(); i++) {
+void drawableObj::_interleave() {
+
+  // Start over, in case the data has changed since the last time.
+  _interleavedData.setData(std::vector<float>());
+
+  for (size_t i = 0; i < _vertices.size(); i++) {
 
     // Load the x,y,z vertices.
     _interleavedData.addData(_vertices[i].x);
@@ -821,10 +2494,6 @@ void drawableObj::_prepareInterleaved(GLuint programID) {
       _interleavedData.addData(_uvs[i].t);
     }
   }
-
-  _getAttribLocations(programID);
-
-  _loadInterleaved();
 }
 
 void drawableObj::_prepareSeparate(GLuint programID) {
@@ -834,6 +2503,7 @@ void drawableObj::_prepareSeparate(GLuint programID) {
   if (!_colors.empty()) glGenBuffers(1, &_colors.bufferID);
   if (!_normals.empty()) glGenBuffers(1, &_normals.bufferID);
   if (!_uvs.empty()) glGenBuffers(1, &_uvs.bufferID);
+  if (!_indices.empty()) glGenBuffers(1, &_indices.bufferID);
 
   _getAttribLocations(programID);
 
@@ -855,20 +2525,28 @@ void drawableObj::load() {
   } else {
     _loadSeparate();
   }
+
+  // A new index array doesn't mean the vertices have to be sent again.
+  if (_indicesChanged) _loadIndices();
 }
 
 void drawableObj::_loadInterleaved() {
 
   if (!_loadedIntoBuffer) {
 
+    _interleave();
+
     // Load it into a buffer.
+    drawStats::counts.bufferBinds += 2;
+    drawStats::counts.bufferUpload(_interleavedData.byteSize());
     glBindBuffer(GL_ARRAY_BUFFER, _interleavedData.bufferID);
     glBufferData(GL_ARRAY_BUFFER, _interleavedData.byteSize(),
-                 _interleavedData.beginAddress(), GL_STATIC_DRAW);
-
-
+                 _interleavedData.beginAddress(), _usage());
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    _loadIndices();
     _loadedIntoBuffer = true;
+    _dirtyBegin = _dirtyEnd = 0;
   }
 }
 
@@ -876,34 +2554,125 @@ void drawableObj::_loadInterleaved() {
 void drawableObj::_loadSeparate() {
 
   if (!_loadedIntoBuffer) {
+    drawStats::counts.bufferBinds += 2;
+    drawStats::counts.bufferUpload(_vertices.byteSize());
     glBindBuffer(GL_ARRAY_BUFFER, _vertices.bufferID);
     glBufferData(GL_ARRAY_BUFFER, _vertices.byteSize(), _vertices.beginAddress(),
-                 GL_STATIC_DRAW);
+                 _usage());
 
     if (!_colors.empty()) {
+      drawStats::counts.bufferBinds++;
+      drawStats::counts.bufferUpload(_colors.byteSize());
       glBindBuffer(GL_ARRAY_BUFFER, _colors.bufferID);
       glBufferData(GL_ARRAY_BUFFER, _colors.byteSize(), _colors.beginAddress(),
-                   GL_STATIC_DRAW);
+                   _usage());
     }
     if (!_normals.empty()) {
+      drawStats::counts.bufferBinds++;
+      drawStats::counts.bufferUpload(_normals.byteSize());
       glBindBuffer(GL_ARRAY_BUFFER, _normals.bufferID);
       glBufferData(GL_ARRAY_BUFFER, _normals.byteSize(), _normals.beginAddress(),
-                   GL_STATIC_DRAW);
+                   _usage());
     }
     if (!_uvs.empty()) {
+      drawStats::counts.bufferBinds++;
+      drawStats::counts.bufferUpload(_uvs.byteSize());
       glBindBuffer(GL_ARRAY_BUFFER, _uvs.bufferID);
       glBufferData(GL_ARRAY_BUFFER, _uvs.byteSize(), _uvs.beginAddress(),
-                   GL_STATIC_DRAW);
+                   _usage());
     }
-
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    _loadIndices();
     _loadedIntoBuffer = true;
+    _dirtyBegin = _dirtyEnd = 0;
+
+  } else if (_dirtyEnd > _dirtyBegin) {
+    _updateSeparate();
+  }
+}
+
+void drawableObj::_updateSeparate() {
+
+  // Send only the vertices that changed.
+  GLintptr first = _dirtyBegin;
+  GLsizeiptr n = _dirtyEnd - _dirtyBegin;
+
+  drawStats::counts.bufferBinds += 2;
+  drawStats::counts.bufferUpload(n * sizeof(glm::vec4));
+  glBindBuffer(GL_ARRAY_BUFFER, _vertices.bufferID);
+  glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(glm::vec4),
+                  n * sizeof(glm::vec4), _vertices.beginAddress() + first);
+
+  if (!_colors.empty()) {
+    drawStats::counts.bufferBinds++;
+    drawStats::counts.bufferUpload(n * sizeof(glm::vec4));
+    glBindBuffer(GL_ARRAY_BUFFER, _colors.bufferID);
+    glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(glm::vec4),
+                    n * sizeof(glm::vec4), _colors.beginAddress() + first);
+  }
+  if (!_normals.empty()) {
+    drawStats::counts.bufferBinds++;
+    drawStats::counts.bufferUpload(n * sizeof(glm::vec4));
+    glBindBuffer(GL_ARRAY_BUFFER, _normals.bufferID);
+    glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(glm::vec4),
+                    n * sizeof(glm::vec4), _normals.beginAddress() + first);
+  }
+  if (!_uvs.empty()) {
+    drawStats::counts.bufferBinds++;
+    drawStats::counts.bufferUpload(n * sizeof(glm::vec2));
+    glBindBuffer(GL_ARRAY_BUFFER, _uvs.bufferID);
+    glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(glm::vec2),
+                    n * sizeof(glm::vec2), _uvs.beginAddress() + first);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  _dirtyBegin = _dirtyEnd = 0;
+}
+
+void drawableObj::_loadIndices() {
+
+  _indicesChanged = false;
+  if (_indices.empty()) return;
+
+  // The index buffer might have been added after prepare().
+  if (_indices.bufferID == 0) glGenBuffers(1, &_indices.bufferID);
+
+  drawStats::counts.bufferBinds += 2;
+  drawStats::counts.bufferUpload(_indices.byteSize());
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indices.bufferID);
+
+  // A dynamic object's indices are written into the buffer it has, if
+  // they fit, rather than making a new one.
+  if (_dynamic && _indices.byteSize() <= _indexBufferSize) {
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, _indices.byteSize(),
+                    _indices.beginAddress());
+  } else {
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, _indices.byteSize(),
+                 _indices.beginAddress(), _usage());
+    _indexBufferSize = _indices.byteSize();
+  }
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void drawableObj::_drawArrays() {
+
+  drawStats::counts.drawCalls++;
+  if (_indices.empty()) {
+    glDrawArrays(_drawType, 0, _count);
+  } else {
+    drawStats::counts.bufferBinds += 2;
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indices.bufferID);
+    glDrawElements(_drawType, _count, GL_UNSIGNED_INT, BUFFER_OFFSET(0));
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
   }
 }
 
 
 void drawableObj::draw() {
 
+  BSG_PROFILE_DETAIL_SCOPE("drawableObj::draw");
+
   // Enable all the attribute arrays we'll use.
   glEnableVertexAttribArray(_vertices.ID);
   if (!_colors.empty()) glEnableVertexAttribArray(_colors.ID);
@@ -926,6 +2695,7 @@ void drawableObj::draw() {
 
 void drawableObj::_drawInterleaved() {
 
+  drawStats::counts.bufferBinds++;
   glBindBuffer(GL_ARRAY_BUFFER, _interleavedData.bufferID);
 
   // Since the point of the interleaving is to make the transfer of
@@ -948,34 +2718,37 @@ void drawableObj::_drawInterleaved() {
                             GL_FLOAT, GL_FALSE, _stride, BUFFER_OFFSET(_uvPos));
   }
 
-  glDrawArrays(_drawType, 0, _count);
+  _drawArrays();
 }
 
 
 void drawableObj::_drawSeparate() {
 
+  drawStats::counts.bufferBinds++;
   glBindBuffer(GL_ARRAY_BUFFER, _vertices.bufferID);
   glVertexAttribPointer(_vertices.ID, _vertices.componentsPerVertex(),
                         GL_FLOAT, 0, 0, 0);
 
   if (!_colors.empty()) {
+    drawStats::counts.bufferBinds++;
     glBindBuffer(GL_ARRAY_BUFFER, _colors.bufferID);
     glVertexAttribPointer(_colors.ID, _colors.componentsPerVertex(),
                           GL_FLOAT, 0, 0, 0);
   }
   if (!_normals.empty()) {
+    drawStats::counts.bufferBinds++;
     glBindBuffer(GL_ARRAY_BUFFER, _normals.bufferID);
     glVertexAttribPointer(_normals.ID, _normals.componentsPerVertex(),
                           GL_FLOAT, 0, 0, 0);
   }
   if (!_uvs.empty()) {
+    drawStats::counts.bufferBinds++;
     glBindBuffer(GL_ARRAY_BUFFER, _uvs.bufferID);
     glVertexAttribPointer(_uvs.ID, _uvs.componentsPerVertex(),
                           GL_FLOAT, 0, 0, 0);
   }
 
-  glDrawArrays(_drawType, 0, _count);
-
+  _drawArrays();
 }
 
 std::string bsgName::printName() const {
@@ -1060,7 +2833,7 @@ bsgNameList drawableCompound::insideBoundingBox(const glm::vec4 &testPoint) {
 }
 
 
-void drawableCompound::prepare() {
+void drawableCompound::_prepareUniforms() {
 
   _pShader->useProgram();
   _pShader->prepare();
@@ -1069,6 +2842,18 @@ void drawableCompound::prepare() {
   _normalMatrixID = _pShader->getUniformID(_normalMatrixName);
   _viewMatrixID = _pShader->getUniformID(_viewMatrixName);
   _projMatrixID = _pShader->getUniformID(_projMatrixName);
+  _twoSidedID = _pShader->getUniformID(_twoSidedName);
+
+  _preparedProgram = _pShader->getProgram();
+}
+
+void drawableCompound::prepare() {
+
+  // If the shader is still compiling, this happens in load(), once
+  // it's done.
+  if (!_pShader->isReady()) return;
+
+  _prepareUniforms();
 
   // Prepare each component object.
   for (DrawableObjList::iterator it = _objects.begin();
@@ -1079,13 +2864,23 @@ void drawableCompound::prepare() {
 
 void drawableCompound::load() {
 
-  _pShader->useProgram();
+  BSG_PROFILE_SCOPE("drawableCompound::load");
+
   _pShader->load();
 
   // Review the current state of the transformation matrices, and pack
   // them all into the total model matrix.
   _totalModelMatrix = getModelMatrix();
 
+  // Nothing to do with a shader that's still compiling.
+  if (!_pShader->isReady()) return;
+
+  // A shader that has just finished compiling means preparing the
+  // objects for the first time.  After that, a new variant only means
+  // finding the uniform and attribute IDs again; the buffers are kept.
+  if (_pShader->getProgram() != _preparedProgram) prepare();
+  _pShader->useProgram();
+
   // Load each component object.
   for (DrawableObjList::iterator it = _objects.begin();
        it != _objects.end(); it++) {
@@ -1093,8 +2888,10 @@ void drawableCompound::load() {
   }
 }
 
-void drawableCompound::draw(const glm::mat4& viewMatrix,
-                            const glm::mat4& projMatrix) {
+void drawableCompound::_drawUniforms(const glm::mat4& viewMatrix,
+                                     const glm::mat4& projMatrix) {
+
+  BSG_PROFILE_SCOPE("uniforms");
 
   _pShader->useProgram();
   _pShader->draw();
@@ -1102,6 +2899,7 @@ void drawableCompound::draw(const glm::mat4& viewMatrix,
   // Load the model matrix.  This adjusts the position of each object.
   // Remember that all the objects in a compound object use the same
   // shader and the same model matrix.
+  drawStats::counts.uniformUploads += 5;
   glUniformMatrix4fv(_modelMatrixID, 1, false, &_totalModelMatrix[0][0]);
 
   // Calculate the normal matrix to use for lighting.
@@ -1117,10 +2915,40 @@ void drawableCompound::draw(const glm::mat4& viewMatrix,
   // std::cout << "model" << glm::to_string(_modelMatrix) << std::endl;
   // std::cout << "proj" << glm::to_string(projMatrix) << std::endl;
 
-  for (DrawableObjList::iterator it = _objects.begin();
-       it != _objects.end(); it++) {
+  // The shader is shared with other objects, so the two-sided flag
+  // has to be set on every draw, not just for the two-sided ones.
+  glUniform1i(_twoSidedID, _twoSided);
+}
+
+void drawableCompound::_drawObjects(DrawableObjList &objects) {
+
+  BSG_PROFILE_GPU("drawableCompound::draw");
+
+  // A two-sided object needs its back faces, so turn off culling
+  // while we draw it, and put it back the way we found it after.
+  bool cullFace = false;
+  if (_twoSided) {
+    cullFace = glIsEnabled(GL_CULL_FACE);
+    if (cullFace) glDisable(GL_CULL_FACE);
+  }
+
+  for (DrawableObjList::iterator it = objects.begin();
+       it != objects.end(); it++) {
     (*it)->draw();
   }
+
+  if (cullFace) glEnable(GL_CULL_FACE);
+}
+
+void drawableCompound::draw(const glm::mat4& viewMatrix,
+                            const glm::mat4& projMatrix) {
+
+  if (!_ready()) return;
+
+  BSG_PROFILE_SCOPE("drawableCompound::draw");
+
+  _drawUniforms(viewMatrix, projMatrix);
+  _drawObjects(_objects);
 }
 
 void drawableCompound::addObjectBoundingBox(bsgPtr<drawableObj> &obj) {
@@ -1405,23 +3233,124 @@ void drawableCollection::prepare() {
   }
 }
 
+std::string drawableCollection::printStats(const std::string &prefix) const {
+
+  std::ostringstream out;
+  out << prefix << _name << ": " << _stats;
+
+  for (CollectionMap::const_iterator it = _collection.begin();
+       it != _collection.end(); it++) {
+    drawableCollection *coll = bPtr(drawableCollection, it->second);
+    if (coll) out << std::endl << coll->printStats(prefix + "| ");
+  }
+
+  return out.str();
+}
+
 void drawableCollection::load() {
 
+  drawStats before = drawStats::counts;
+
   // Then draw all the objects.
   for (CollectionMap::iterator it =  _collection.begin();
        it != _collection.end(); it++) {
     it->second->load();
   }
+
+  _stats = drawStats::counts - before;
 }
 
 void drawableCollection::draw(const glm::mat4 &viewMatrix,
                               const glm::mat4 &projMatrix) {
 
+  drawStats before = drawStats::counts;
+
   // Then draw all the objects.
   for (CollectionMap::iterator it =  _collection.begin();
        it != _collection.end(); it++) {
     it->second->draw(viewMatrix, projMatrix);
   }
+
+  _stats += drawStats::counts - before;
+}
+
+void drawableLOD::addLevel(const bsgPtr<drawableMulti> &level,
+                           const float &error) {
+
+  level->setParent(this);
+  _levels.push_back(level);
+  _errors.push_back(error);
+}
+
+bsgNameList drawableLOD::insideBoundingBox(const glm::vec4 &testPoint) {
+
+  if (_levels.empty()) return bsgNameList();
+  return _levels[0]->insideBoundingBox(testPoint);
+}
+
+bsgNameList drawableLOD::getNames() {
+
+  if (_levels.empty()) return bsgNameList();
+  return _levels[0]->getNames();
+}
+
+std::string drawableLOD::printObj(const std::string &prefix) const {
+
+  std::string out = prefix + "<drawableLOD:" + _name + ">";
+
+  for (size_t i = 0; i < _levels.size(); i++) {
+    out += "\n" + _levels[i]->printObj(prefix + "| ");
+  }
+
+  return out;
+}
+
+void drawableLOD::prepare() {
+
+  for (size_t i = 0; i < _levels.size(); i++) _levels[i]->prepare();
+}
+
+void drawableLOD::load() {
+
+  for (size_t i = 0; i < _levels.size(); i++) _levels[i]->load();
+}
+
+void drawableLOD::draw(const glm::mat4 &viewMatrix,
+                       const glm::mat4 &projMatrix) {
+
+  if (_levels.empty()) return;
+
+  int last = _levels.size() - 1;
+  if (_current > last) _current = last;
+
+  float pixels = bsgUtils::pixelsPerUnit(getModelMatrix(), _center,
+                                         viewMatrix, projMatrix);
+
+  // Can we get away with a coarser level?  Only if it's well under
+  // the threshold.
+  float coarsen = _pixelThreshold * (1.0f - _hysteresis);
+  int choice = _current;
+  for (int i = last; i > _current; i--) {
+    if (_errors[i] * pixels <= coarsen) {
+      choice = i;
+      break;
+    }
+  }
+
+  // Do we need a finer one?  Only if the current one is well over.
+  if (choice == _current &&
+      _errors[_current] * pixels > _pixelThreshold * (1.0f + _hysteresis)) {
+    choice = 0;
+    for (int i = _current - 1; i > 0; i--) {
+      if (_errors[i] * pixels <= _pixelThreshold) {
+        choice = i;
+        break;
+      }
+    }
+  }
+
+  _current = choice;
+  _levels[_current]->draw(viewMatrix, projMatrix);
 }
 
 
@@ -1498,13 +3427,56 @@ glm::mat4 scene::getViewMatrix() {
 
 void scene::load() {
 
+  // A scene is loaded once a frame, so this is where the profiler's
+  // frames start.
+  BSG_PROFILE_FRAME();
+  BSG_PROFILE_SCOPE("scene::load");
+
+  drawStats before = drawStats::counts;
+
+  // Any textures that have been read in the background can go to the
+  // GPU now.
+  textureMgr::uploadPending();
+
   _sceneRoot.load();
+
+  _stats = drawStats::counts - before;
 }
 
 void scene::draw(const glm::mat4 &viewMatrix,
                  const glm::mat4 &projMatrix) {
 
+  // The self time of this scope is the traversal.  The GPU is timed
+  // around the draws of each compound, and GPU scopes can't nest, so
+  // there isn't one here.
+  BSG_PROFILE_SCOPE("scene::draw");
+
+  drawStats before = drawStats::counts;
+
   _sceneRoot.draw(viewMatrix, projMatrix);
+
+  _stats += drawStats::counts - before;
+}
+
+drawStats scene::getObjectStats(bsgName &name) {
+
+  if (!name.empty() && name.front().compare("sceneRoot") == 0 &&
+      name.size() == 1)
+    return _sceneRoot.getStats();
+
+  bsgPtr<drawableMulti> object = getObject(name);
+  if (object.ptr() == NULL) return drawStats();
+
+  drawableCollection *coll = bPtr(drawableCollection, object);
+  if (!coll) return drawStats();
+
+  return coll->getStats();
+}
+
+void scene::printStats(std::ostream &os, const bool &subtrees) {
+
+  os << "frame: " << _stats << std::endl;
+  if (subtrees) os << _sceneRoot.printStats("  ") << std::endl;
 }
 
 }
@@ -3,6 +3,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdexcept>
 #include <memory.h>
 #include <math.h>
@@ -10,10 +11,15 @@
 #include <GL/freeglut.h>
 #include <string>
 #include <vector>
+#include <algorithm>
 #include <list>
 #include <map>
+#include <set>
+#include <unordered_map>
 #include <iostream>
 #include <fstream>
+#include <thread>
+#include <mutex>
 
 // Include GLM
 #include <glm/glm.hpp>
@@ -165,6 +171,15 @@ class bsgPtr {
 
   operator bool() const { return _pData != 0; };
 
+  /// Copy from a pointer to a derived class, sharing the count, so
+  /// a bsgPtr<fontTextureMgr> can be handed to something that wants a
+  /// bsgPtr<textureMgr>.  (The base class needs a virtual destructor.)
+  template <class U>
+  bsgPtr(const bsgPtr<U> &sp) : _pData(sp._pData), _reference(sp._reference) {
+    _reference->addRef();
+  }
+  template <class U> friend class bsgPtr;
+
   T& operator*() { return *_pData; };
   T* operator->() const { return _pData; };
   T* ptr() const { return _pData; }; // Use this for casts.
@@ -200,6 +215,68 @@ class bsgUtils {
   static void printVec4(const std::string intro, const glm::vec4 in) {
     std::cout << intro << "(" << in.x << "," << in.y << "," << in.z << "," << in.w << ")" << std::endl;}
 
+  /// \brief How many pixels does a unit of length cover on the screen?
+  ///
+  /// The unit is in the model space of the given model matrix, and
+  /// the answer is for the given point in that space.  It depends on
+  /// the current viewport (from GL_VIEWPORT) as well as the matrices.
+  static float pixelsPerUnit(const glm::mat4 &modelMatrix,
+                             const glm::vec3 &center,
+                             const glm::mat4 &viewMatrix,
+                             const glm::mat4 &projMatrix);
+
+  /// \brief The length in bytes of the UTF-8 character starting at c.
+  ///
+  /// A malformed lead byte counts as one, so a bad string doesn't
+  /// stop anything that steps through it.
+  static int utf8Length(const char *c) {
+    unsigned char b = (unsigned char)*c;
+    if (b < 0xC0) return 1;
+    if (b < 0xE0) return 2;
+    if (b < 0xF0) return 3;
+    return 4;
+  };
+
+};
+
+/// \brief Counts of the OpenGL calls made while drawing.
+///
+/// The library counts the calls that cost the most as it makes them:
+/// the draws, the changes of shader program, buffer and texture, the
+/// uniforms set, and the data sent to buffers and textures.  The
+/// running totals are in drawStats::counts, which never goes back to
+/// zero.  The difference between two copies of it is what happened
+/// in between, which is how the scene and each drawableCollection
+/// keep their numbers for the frame.  See scene::getStats().
+///
+/// Only calls made on the drawing thread are counted, which is all
+/// of them.
+struct drawStats {
+  unsigned int drawCalls;       ///< glDrawArrays and glDrawElements.
+  unsigned int programChanges;  ///< glUseProgram.
+  unsigned int bufferBinds;     ///< glBindBuffer.
+  unsigned int textureBinds;    ///< glBindTexture.
+  unsigned int uniformUploads;  ///< glUniform*.
+  unsigned int bufferUploads;   ///< glBufferData and glBufferSubData.
+  size_t bufferBytes;
+  unsigned int textureUploads;  ///< glTexImage* and glTexSubImage*.
+  size_t textureBytes;
+
+  drawStats() : drawCalls(0), programChanges(0), bufferBinds(0),
+                textureBinds(0), uniformUploads(0), bufferUploads(0),
+                bufferBytes(0), textureUploads(0), textureBytes(0) {};
+
+  /// \brief Count data sent to a buffer or a texture.
+  void bufferUpload(const size_t &bytes) { bufferUploads++; bufferBytes += bytes; };
+  void textureUpload(const size_t &bytes) { textureUploads++; textureBytes += bytes; };
+
+  drawStats operator-(const drawStats &other) const;
+  drawStats &operator+=(const drawStats &other);
+
+  /// \brief The running totals.
+  static drawStats counts;
+
+  friend std::ostream &operator<<(std::ostream &os, const drawStats &stats);
 };
 
 /// \brief Some data for an OpenGL object.
@@ -230,7 +307,7 @@ class drawableObjData {
     ID = 0; bufferID = 0;
     _fakeData.reserve(50);
   };
- drawableObjData(const std::string inName, const std::vector<T> inData) :
+ drawableObjData(const std::string &inName, const std::vector<T> &inData) :
   name(inName), _data(inData) {}
 
   // Copy constructor
@@ -243,7 +320,11 @@ class drawableObjData {
 
   std::vector<T> getData() const { return _data; };
   void addData(T d) { _data.push_back(d); };
-  void setData(const std::vector<T> data) { _data = data; };
+  void setData(const std::vector<T> &data) { _data = data; };
+  void swapData(std::vector<T> &data) { _data.swap(data); };
+  void updateData(const size_t &first, const std::vector<T> &data) {
+    std::copy(data.begin(), data.end(), _data.begin() + first);
+  };
 
   T* beginAddress() { return &_data[0]; };
 
@@ -286,26 +367,31 @@ class drawableObjData {
 /// redundancy out of the system is an exercise left for the reader.
 ///
 class lightList {
- private:
+ protected:
 
   /// The positions of the lights in the list.
   drawableObjData<glm::vec4> _lightPositions;
   /// The colors of the lights in the list.
   drawableObjData<glm::vec4> _lightColors;
 
+  /// Counts the changes that might change the #defines, so a shader
+  /// can tell when it needs another variant.
+  int _version;
+
   /// The default names of things in the shaders, put here for easy
   /// comparison or editing.  If you're mucking around with the
   /// shaders, don't forget that these are names of arrays inside the
-  /// shader, and that the size of the arrays is set with 'XX', see
-  /// the shader constructors below.
+  /// shader, and that the size of the arrays is NUM_LIGHTS, see
+  /// shaderMgr::addLights().
   void _setupDefaultNames() {
     setNames("lightPositionWS", "lightColor");
   }
 
  public:
-  lightList() {
+  lightList() : _version(0) {
     _setupDefaultNames();
   };
+  virtual ~lightList() {};
 
   /// \brief Control the lighting names used in the shader.
   ///
@@ -318,13 +404,14 @@ class lightList {
 
   /// \brief Add lights to the list.
   ///
-  /// Since the shaders are compiled and linked after the number of
-  /// lights is set, this is pretty much a one-way street.  Add
-  /// lights, but don't subtract them.  If you want to extinguish one,
-  /// just move it far away, or dial its intensity way down.
+  /// Adding a light means the shaders that use this list switch to
+  /// a variant compiled for the new number of lights, at their next
+  /// load().  There's no removing lights; if you want to extinguish
+  /// one, just move it far away, or dial its intensity way down.
   int addLight(const glm::vec4 &position, const glm::vec4 &color) {
     _lightPositions.addData(position);
     _lightColors.addData(color);
+    _version++;
     return _lightPositions.size();
   };
   int addLight(const glm::vec4 &position) {
@@ -338,12 +425,14 @@ class lightList {
   std::vector<glm::vec4> getPositions() { return _lightPositions.getData(); };
   void setPositions(const std::vector<glm::vec4> positions) {
     _lightPositions.setData(positions);
+    _version++;
   };
   GLuint getPositionID() { return _lightPositions.ID; };
 
   std::vector<glm::vec4> getColors() { return _lightColors.getData(); };
   void setColors(const std::vector<glm::vec4> &colors) {
     _lightColors.setData(colors);
+    _version++;
   };
   GLuint getColorID() { return _lightColors.ID; };
 
@@ -365,7 +454,7 @@ class lightList {
   /// shader that uses them.
   //
   // This must be preceded by a glUseProgram(programID) call.
-  void load(const GLint programID);
+  virtual void load(const GLint programID);
 
   /// \brief "Draw" these lights.
   ///
@@ -375,24 +464,71 @@ class lightList {
   /// positions and colors are loaded into the shader's uniforms.
   //
   // This must be preceded by a glUseProgram(programID) call.
-  void draw();
+  virtual void draw(const GLint programID);
+
+  /// \brief The #defines a shader using these lights is compiled with.
+  ///
+  /// For a plain list, that's NUM_LIGHTS, the size of the arrays.
+  virtual void addDefines(std::map<std::string, std::string> &defines);
+
+  /// \brief Goes up whenever the #defines might have changed.
+  int getVersion() { return _version; };
 };
 
 typedef enum {
   texturePNG = 0, //! Use for a PNG file.
-  textureDDS = 1, //! Not implemented.
-  textureBMP = 2, //! Not implemented.
+  textureDDS = 1, //! A DDS file, with its mipmaps, maybe compressed.
+  textureBMP = 2, //! Use for a BMP file.
   textureCHK = 3, //! Will provide a checkerboard texture.
-  textureJPG = 4, //! Not implemented.
-  textureTTF = 5  //! Not implemented yet (MKE)
+  textureJPG = 4, //! Use for a JPEG file.
+  textureTTF = 5, //! Not implemented yet (MKE)
+  textureKTX = 6, //! A KTX file, with its mipmaps, maybe compressed.
+  textureBSG = 7  //! A .bsgt file, made by tools/bsgTexConvert.
 } textureType;
 
 
+/// \brief How a texture is sampled.
+///
+/// The filters are the GL_TEXTURE_MIN_FILTER and GL_TEXTURE_MAG_FILTER
+/// values, and the wrap is used for both GL_TEXTURE_WRAP_S and _T.
+/// The default is trilinear filtering, with mipmaps, which are made
+/// for images that don't come with their own.  The anisotropy is the
+/// most samples taken for a texture seen at a slant, if the hardware
+/// can do that at all; 1 turns it off.
+struct textureSampling {
+  GLenum minFilter;
+  GLenum magFilter;
+  GLenum wrap;
+  GLfloat anisotropy;
+
+  textureSampling(const GLenum &min = GL_LINEAR_MIPMAP_LINEAR,
+                  const GLenum &mag = GL_LINEAR,
+                  const GLenum &w = GL_REPEAT,
+                  const GLfloat &a = 8.0f) :
+    minFilter(min), magFilter(mag), wrap(w), anisotropy(a) {};
+
+  /// \brief Blocky sampling, one texel per pixel, no mipmaps.
+  static textureSampling nearest() {
+    return textureSampling(GL_NEAREST, GL_NEAREST, GL_REPEAT, 1.0f);
+  };
+
+  /// \brief Does the min filter need mipmaps?
+  bool usesMipmaps() const {
+    return minFilter != GL_NEAREST && minFilter != GL_LINEAR;
+  };
+};
+
 /// \brief A manager of textures and texture files.
 ///
 ///  A class to hold a texture and take care of loading it into the
 ///  OpenGL slots where it belongs.
 ///
+///  Textures read from files are shared.  If some other textureMgr
+///  has already read the same file, with the same sampling, this one
+///  uses the same GL texture instead of reading and uploading it
+///  again.  The texture is deleted when the last textureMgr using it
+///  goes away.
+///
 class textureMgr {
  protected:
   GLfloat _width, _height;
@@ -406,30 +542,142 @@ class textureMgr {
     _textureAttribName = std::string("textureImage");
   };
 
+  /// The textures in use, by file name, type, and sampling, and how
+  /// many textureMgrs are using each one.
+  ///
+  /// A texture being read in the background is pending, with no
+  /// texture ID yet.  If the file can't be read, it is failed, and
+  /// the next readFile() or readFileAsync() of it tries again.
+  struct residentTexture {
+    GLuint textureID;
+    int users;
+    GLfloat width, height;
+    size_t bytes;
+    bool pending;
+    bool failed;
+  };
+  static std::map<std::string, residentTexture> _registry;
+  static size_t _residentBytes;
+
+  /// Our entry in the registry, or empty if we don't have one.
+  std::string _registryKey;
+  size_t _bytes;
+  void _release();
+  static std::string _makeKey(const textureType &type,
+                              const std::string &fileName,
+                              const textureSampling &sampling);
+  static void _setSampling(const std::string &fileName,
+                           const textureSampling &sampling,
+                           const int &levels, const bool &compressed,
+                           size_t &bytes);
+
+  /// The number of mipmap levels in the file we read, and whether
+  /// they're block-compressed.  Only DDS and KTX files have more than
+  /// one level, or compression.
+  int _levels;
+  bool _compressed;
+
+  /// While our image is being read in the background, we show this
+  /// instead.
+  bool _pending;
+  bsgPtr<textureMgr> _placeholder;
+  void _checkPending();
 
   GLuint _loadPNG(const std::string imagePath);
+  GLuint _loadDDS(const std::string imagePath);
+  GLuint _loadKTX(const std::string imagePath);
+  GLuint _loadBSGT(const std::string imagePath);
+  GLuint _uploadLevels(const GLenum &internalFormat, const GLenum &format,
+                       const GLenum &type, const bool &compressed,
+                       const int &width, const int &height,
+                       const std::vector<const char *> &data,
+                       const std::vector<size_t> &sizes);
   GLuint _loadCheckerBoard (const int size, int numFields);
 
  public:
-  textureMgr() { _setupDefaultNames(); };
+  textureMgr() : _width(0), _height(0), _textureBufferID(0), _bytes(0),
+    _levels(1), _compressed(false), _pending(false) {
+    _setupDefaultNames(); };
+  virtual ~textureMgr() { _release(); };
 
   /// \brief Reads a texture from an image file.
   ///
-  /// The type can be texturePNG, in which case fileName better be a
-  /// PNG file name, or textureCHK, in which case you get a
-  /// checkerboard pattern, and the file name is ignored.
-  void readFile(const textureType &type, const std::string &fileName);
+  /// The type can be texturePNG, textureJPG, or textureBMP, in which
+  /// case fileName better be that kind of file, or textureCHK, in
+  /// which case you get a checkerboard pattern, and the file name is
+  /// ignored.  If the file is already loaded with the same sampling,
+  /// it is shared rather than read again.
+  ///
+  /// A textureDDS or textureKTX file brings its own mipmaps, and may
+  /// be block-compressed: BC1 (DXT1), BC2 (DXT3), and BC3 (DXT5) need
+  /// GL_EXT_texture_compression_s3tc, and BC7 needs
+  /// GL_ARB_texture_compression_bptc.  Compressed textures take a
+  /// quarter to an eighth of the memory, and are quicker to sample.
+  /// The images are used as they are stored, so they should be
+  /// flipped, bottom row first, when the file is made, as most tools
+  /// will do if asked.
+  ///
+  /// A textureBSG file is the quickest to read of all, since it is
+  /// already flipped, mipmapped, and maybe compressed, and goes
+  /// straight from the disk to the GPU.  See bsgTextureFile.h.
+  void readFile(const textureType &type, const std::string &fileName,
+                const textureSampling &sampling = textureSampling());
+
+  /// \brief Make a textureMgr and read a file into it.
+  ///
+  /// Just a shorter way to write the usual three lines.
+  static bsgPtr<textureMgr> get(const textureType &type,
+                                const std::string &fileName,
+                                const textureSampling &sampling = textureSampling()) {
+    bsgPtr<textureMgr> texture = new textureMgr();
+    texture->readFile(type, fileName, sampling);
+    return texture;
+  };
+
+  /// \brief Read an image file in the background.
+  ///
+  /// The file is decoded by a pool of worker threads, and sent to
+  /// the GPU through a pixel buffer object by uploadPending().  Until
+  /// it arrives, the texture is a checkerboard.  Anything stb_image
+  /// can read will do: PNG, JPEG, BMP, TGA, and so on.  As with
+  /// readFile(), a file that is already loaded, or on its way, is
+  /// shared.  If the file can't be read, there's a caution, and the
+  /// checkerboard stays; reading it again tries again.
+  void readFileAsync(const std::string &fileName,
+                     const textureSampling &sampling = textureSampling());
+
+  /// \brief Is this texture still waiting for its image?
+  bool isPending() { return _pending; };
+
+  /// \brief Send decoded images to the GPU.
+  ///
+  /// This must be called on the thread with the GL context, and is
+  /// called once a frame by scene::load(), so you only need it if
+  /// you're not using a scene.  It stops when it has sent more than
+  /// maxBytes, so a pile of big images doesn't stall one frame, and
+  /// returns the number of textures sent.
+  static int uploadPending(const size_t &maxBytes = 16 << 20);
+
+  /// \brief The number of images still being read or waiting to be sent.
+  static int getNumPending();
+
+  /// \brief The number of textures read from files and still in use.
+  static int getNumResident() { return _registry.size(); };
+
+  /// \brief About how much GPU memory those textures take, in bytes.
+  static size_t getResidentBytes() { return _residentBytes; };
 
   /// \brief Prepare the texture to be rendered.
   ///
   /// Meant to be used during the shaderMgr.load() step.
-  void load(const GLuint programID);
+  virtual void load(const GLuint programID);
 
   /// \brief Call this just before the draw.
   ///
   /// Binds the texture for use by OpenGL.  This is meant to be used
-  /// during the shaderMgr.draw() step.
-  void draw();
+  /// during the shaderMgr.draw() step.  A texture that was waiting
+  /// for its image switches to it here, once it has arrived.
+  virtual void draw();
 
   /// \brief Return the ID of the texture buffer.
   GLuint getTextureID() { return _textureBufferID; };
@@ -450,17 +698,137 @@ class textureMgr {
 ///  (the texture), and how much kerning that glyph gets, etc.
 class fontTextureMgr : public textureMgr {
  private:
-  GLuint _loadTTF(const std::string ttfPath);
-  std::map<std::string, texture_font_t *> _fontsMap;
+  void _loadTTF(const std::string ttfPath, const float &size);
+  texture_font_t *_newFont(texture_atlas_t *atlas,
+                           const std::string &fileName,
+                           const float &size);
+
+  // Signed distance field mode, and the size fonts are made at
+  // unless somebody asks for another.
+  bool _sdf;
+  float _fontSize;
+
+  // The fonts, by file name and size in pixels.
+  typedef std::pair<std::string, float> fontKey;
+  std::map<fontKey, texture_font_t *> _fontsMap;
   texture_atlas_t *_atlas;
- 
+
+  // The glyphs are rasterized into the atlas as they are asked for.
+  // This is the part of the atlas that has changed since it was last
+  // sent to the GPU.
+  size_t _dirtyX0, _dirtyY0, _dirtyX1, _dirtyY1;
+  void _markDirty(const texture_glyph_t *glyph);
+  void _upload();
+
+  // When the atlas fills up, it is thrown away and started over,
+  // bigger if possible.  Every glyph has to be found again after
+  // that, so anybody holding glyphs checks this number.
+  int _generation;
+  size_t _maxSize;
+  bool _textureAllocated;
+  void _resetAtlas();
+  texture_glyph_t *_getGlyph(texture_font_t *font,
+                             const char *codepoint,
+                             const bool &canReset);
+
+  // For loading glyphs in the background.  The mutex protects the
+  // atlas and the fonts.
+  std::recursive_mutex _mutex;
+  std::thread _worker;
+
  public:
-  fontTextureMgr();
+  /// \brief Make a font texture.
+  ///
+  /// If sdf is true, the glyphs are stored as signed distance fields
+  /// instead of coverage.  Each texel then holds the distance to the
+  /// nearest glyph edge, which can be interpolated and thresholded
+  /// in the shader (see shaders/textShaderSDF.fp) to give a sharp
+  /// edge at any magnification.  That means the glyphs can be much
+  /// smaller, so the atlas is a sixteenth the size, and has room for
+  /// many more fonts.  Text drawn with an SDF texture must use the
+  /// SDF shader.
+  fontTextureMgr(const bool &sdf = false);
+  ~fontTextureMgr();
+
+  /// The size, in pixels, that fonts are rasterized at unless you ask
+  /// for something else.
+  static const float defaultFontSize;
+
+  /// The same, for signed distance field fonts.
+  static const float defaultSDFFontSize;
+
+  /// \brief Is this a signed distance field texture?
+  bool isSDF() { return _sdf; };
+
+  /// \brief The size fonts are rasterized at unless you ask otherwise.
+  float getFontSize() { return _fontSize; };
+
+  /// \brief Loads a font at the default size.
   void readFile(const textureType &type, const std::string &fileName);
-  texture_font_t *getFont(const std::string &fileName);
+
+  /// \brief Loads a font at some size other than the default.
+  ///
+  /// The same file can be loaded at several sizes, and they all share
+  /// the one atlas texture.
+  void addFont(const std::string &fileName, const float &size);
+
+  /// \brief Returns a font, or null if it hasn't been loaded.
+  texture_font_t *getFont(const std::string &fileName, const float &size);
+
+  /// \brief Returns a font at the usual size, or null.
+  texture_font_t *getFont(const std::string &fileName) {
+    return getFont(fileName, _fontSize);
+  };
+
+  /// \brief Returns a glyph, rasterizing it if it's not in the atlas.
+  ///
+  /// The codepoint is a pointer to a UTF-8 character, which can be
+  /// more than one byte long.  Any character in the font works, not
+  /// just ASCII.  The new glyph is sent to the GPU at the next draw,
+  /// with only the part of the atlas that changed.  If the atlas is
+  /// full, it is started over, and glyphs returned before are no
+  /// longer any good; check getGeneration() to notice that.
+  texture_glyph_t *getGlyph(const std::string &fileName,
+                            const float &size,
+                            const char *codepoint);
+
+  /// \brief The kerning between two glyphs of the same font.
+  ///
+  /// The previous character is a UTF-8 pointer, like the codepoint
+  /// for getGlyph().
+  float getKerning(const texture_glyph_t *glyph, const char *previous);
+
+  /// \brief Rasterize some characters ahead of time.
+  ///
+  /// The text is UTF-8.  If background is true, this happens on a
+  /// worker thread and returns right away.
+  void preloadGlyphs(const std::string &fileName,
+                     const float &size,
+                     const std::string &text,
+                     const bool &background = false);
+
+  /// \brief Changes whenever the atlas is started over.
+  int getGeneration() { return _generation; };
+
+  /// \brief The largest the atlas is allowed to grow.
+  void setMaxSize(const size_t &maxSize) { _maxSize = maxSize; };
+
+  /// \brief Sends any new glyphs to the GPU, then binds the texture.
+  void draw();
 };
 
 
+/// \brief An active uniform or attribute of a shader program.
+///
+/// The type is the GL type, like GL_FLOAT_VEC4, and the size is the
+/// number of elements, for an array, or 1.
+struct shaderVariable {
+  GLint location;
+  GLenum type;
+  GLint size;
+};
+typedef std::unordered_map<std::string, shaderVariable> shaderVariableTable;
+
 ///  /brief A collection of shaders that work together as a shader program.
 ///
 ///  Holds the code for the pieces of a shader collection.  Use this
@@ -471,11 +839,14 @@ class fontTextureMgr : public textureMgr {
 class shaderMgr {
  private:
   /// The shader text and compilation log together are stored here,
-  /// using the GLSHADERTYPE as an index to keep them straight.
+  /// using the GLSHADERTYPE as an index to keep them straight.  The
+  /// source is the text as read from the files, with the #include
+  /// lines filled in, and the text is what's compiled: the source
+  /// with the #defines for the variant in use.
+  std::vector<std::string> _shaderSource;
   std::vector<std::string> _shaderText;
   std::vector<std::string> _shaderFiles;
   std::vector<std::string> _shaderLog;
-  std::vector<GLint> _shaderIDs;
 
   std::string _linkLog;
 
@@ -489,16 +860,87 @@ class shaderMgr {
   bsgPtr<textureMgr> _texture;
   bool _textureLoaded;
 
-  std::string _getShaderInfoLog(GLuint obj);
-  std::string _getProgramInfoLog(GLuint obj);
+  static std::string _getShaderInfoLog(GLuint obj);
+  static std::string _getProgramInfoLog(GLuint obj);
+
+  /// Programs are shared by every shaderMgr with the same source
+  /// text, so each is only compiled once.  They are found by the hash
+  /// of the text, and deleted when nobody is using them any more.
+  ///
+  /// A program that is still being compiled is pending, and keeps its
+  /// shaders, and the names of their files for the error messages,
+  /// until it is finished.
+  struct cachedProgram {
+    GLuint programID;
+    int users;
+    bool pending;
+    GLuint shaderIDs[3];
+    std::string shaderFiles[3];
+  };
+  static std::map<uint64_t, cachedProgram> _programCache;
+
+  /// A shader can be compiled several ways, with different numbers of
+  /// lights, with or without a texture, and with whatever other
+  /// #defines are set.  Each of these variants is compiled the first
+  /// time it is needed, and kept, under a key made of the #defines.
+  struct variant {
+    uint64_t hash;
+    GLuint programID;
+  };
+  std::map<std::string, variant> _variants;
+  std::string _variantInUse;
+
+  /// The #defines set with setDefine(), by name.
+  std::map<std::string, std::string> _defines;
+
+  /// Goes up when the defines, texture, or light list change.  The
+  /// variant is only looked for again when this, or the version of
+  /// the lights, differs from the last time.
+  int _version;
+  int _selectedVersion;
+  int _selectedLightsVersion;
+
+  std::string _readSource(const std::string &fileName,
+                          std::set<std::string> &included,
+                          const int &depth);
+  std::map<std::string, std::string> _variantDefines();
+  std::string _variantKey(const std::map<std::string, std::string> &defines);
+  std::string _preprocess(const GLSHADERTYPE &type,
+                          const std::map<std::string, std::string> &defines);
+  void _selectVariant();
+  GLuint _acquireProgram(const uint64_t &hash);
+
+  /// The active uniforms and attributes of each linked program, by
+  /// program ID, so they can be looked up without asking the driver.
+  struct programInfo {
+    shaderVariableTable uniforms;
+    shaderVariableTable attribs;
+  };
+  static std::unordered_map<GLuint, programInfo> _programInfo;
+  static void _reflect(const GLuint &programID);
+  static GLint _find(const GLuint &programID, const std::string &name,
+                     const bool &uniform);
+
+  /// The directory for compiled program binaries, empty if there is
+  /// none.
+  static std::string _binaryCacheDir;
+  static bool _binaryCacheDirSet;
+
+  void _startBuild(cachedProgram &entry);
+  static void _finishBuild(const uint64_t &hash, cachedProgram &entry);
+  cachedProgram *_programInUse();
+  bool _loadBinary(const uint64_t &hash, GLuint &programID);
+  static void _saveBinary(const uint64_t &hash, const GLuint &programID);
+  static std::string _binaryFileName(const uint64_t &hash);
+  static uint64_t _driverHash();
 
  public:
   shaderMgr() {
     // Easiest way to initialize a non-static three-element
     // std::vector.  Dumb, but simple and it works.
-    _shaderIDs.push_back(-1);
-    _shaderIDs.push_back(-1);
-    _shaderIDs.push_back(-1);
+    _shaderSource.push_back("");
+    _shaderSource.push_back("");
+    _shaderSource.push_back("");
     _shaderText.push_back("");
     _shaderText.push_back("");
     _shaderText.push_back("");
@@ -511,20 +953,45 @@ class shaderMgr {
     _lightList = new lightList();
     _compiled = false;
     _textureLoaded = false;
+    _version = 0;
+    _selectedVersion = -1;
+    _selectedLightsVersion = -1;
+  };
+  ~shaderMgr();
+
+  /// \brief A 64-bit FNV-1a hash of a string.
+  ///
+  /// Pass the result of one call as the seed of the next to hash
+  /// several strings together.
+  static uint64_t hashString(const std::string &text,
+                             const uint64_t &seed = 14695981039346656037ULL);
+
+  /// \brief Where to keep compiled programs between runs.
+  ///
+  /// If the driver can hand back a compiled program as a binary
+  /// (OpenGL 4.1, or GL_ARB_get_program_binary), it is saved in this
+  /// directory, and the next run loads it instead of compiling the
+  /// source again.  The files are named by the hash of the source, and
+  /// record the driver they came from, so a driver update just means
+  /// one more compile.  The directory must exist.  If this is never
+  /// called, the BSG_SHADER_CACHE environment variable is used, and
+  /// if that isn't set either, nothing is saved.  An empty string
+  /// turns the disk cache off.
+  static void setBinaryCacheDir(const std::string &dir) {
+    _binaryCacheDir = dir;
+    _binaryCacheDirSet = true;
   };
-  ~shaderMgr() {
-    if (_compiled) glDeleteProgram(_programID);
-  }
 
 
   /// \brief Add lights to the shader.
   ///
-  /// This should be done before adding the shader code itself, unless
-  /// the shader does not depend on the number of lights.  The shader
-  /// manager class will edit any 'XX' string in the shader and
-  /// replace it with the number of lights in this list.  If your
-  /// shader ignores lighting, as many do, this will not do anything
-  /// besides issue a polite warning that the shader doesn't care.
+  /// The number of lights in the list is given to the shader as
+  /// NUM_LIGHTS, a #define.  The lights can be added before or after
+  /// the shader code, and even after the shader is compiled: if the
+  /// number of lights changes, a version of the program with the new
+  /// number is used from the next load() on, compiled then if it
+  /// hasn't been already.  If your shader ignores lighting, as many
+  /// do, the define does no harm.
   void addLights(const bsgPtr<lightList> lightList);
 
   /// \brief Add a texture to the shader.
@@ -532,29 +999,123 @@ class shaderMgr {
   /// This will make a single 2D texture available as an option to the
   /// fragment shader.  If you want something more elaborate, you
   /// probably don't want to be using this package.
+  ///
+  /// A shader with a texture is compiled with BSG_TEXTURE defined.
   void addTexture(const bsgPtr<textureMgr> texture) {
     _texture = texture;
     _textureLoaded = true;
+    _version++;
   };
 
   /// \brief Add a shader to the program.
   ///
   /// You must specify at least a vertex and fragment shader.  The
-  /// geometry shader is optional.
+  /// geometry shader is optional.  A line like
+  ///
+  ///     #include "lighting.glsl"
+  ///
+  /// in the shader is replaced with the contents of that file, found
+  /// relative to the file it appears in.  A file is only included
+  /// once, however many times it's asked for.
+  ///
+  /// When the shader is compiled, these are defined, just after the
+  /// #version line:
+  ///
+  ///  - NUM_LIGHTS, the number of lights (see addLights()),
+  ///  - BSG_TEXTURE, if there is a texture (see addTexture()),
+  ///  - anything set with setDefine().
+  ///
+  /// Older shaders that use 'XX' for the number of lights still work,
+  /// but NUM_LIGHTS is better.
   void addShader(const GLSHADERTYPE type, const std::string &shaderFile);
 
+  /// \brief Define a preprocessor symbol for the shaders.
+  ///
+  /// This selects a variant of the program, like the number of
+  /// lights does.  Use it for switches like BSG_TWO_SIDED, to
+  /// compile out code a shader doesn't need.  A change takes effect
+  /// at the next load(), and each combination of symbols is compiled
+  /// only once.
+  void setDefine(const std::string &name, const std::string &value = "1") {
+    _defines[name] = value;
+    _version++;
+  };
+
+  /// \brief Remove a symbol set with setDefine().
+  void clearDefine(const std::string &name) {
+    _defines.erase(name);
+    _version++;
+  };
+
+  /// \brief How many variants of the program have been compiled.
+  int getNumVariants() { return _variants.size(); };
+
   /// \brief Compile and link the loaded shaders.
   ///
   /// You need to have specified at least a vertex and fragment
-  /// shader.  The geometry shader is optional.
+  /// shader.  The geometry shader is optional.  This compiles the
+  /// variant for the present lights, texture, and defines.  If some
+  /// other shaderMgr has already compiled the same text, its program
+  /// is used instead of compiling it again.
+  ///
+  /// This only starts the compile.  The driver may do it in the
+  /// background, especially if it has GL_KHR_parallel_shader_compile,
+  /// so call this for all your shaders early, before loading models
+  /// and textures, and the compiling happens while you do that.
+  /// Objects that use a shader that isn't ready yet are skipped when
+  /// drawing, and are prepared once it is.
   void compileShaders();
 
-  /// Get the ID number for an attribute name that appears in a shader.
+  /// \brief Has the program finished compiling?
+  ///
+  /// With GL_KHR_parallel_shader_compile, this asks the driver
+  /// without waiting for it.  Without it, there is no way to ask, so
+  /// this finishes the compile, and always says yes.  The compile and
+  /// link errors, if any, are printed here.
+  bool isReady();
+
+  /// \brief Wait until the program has finished compiling.
+  void waitUntilReady();
+
+  /// \brief Get the ID number for an attribute name that appears in a shader.
+  ///
+  /// The active attributes and uniforms are listed once, when the
+  /// program is linked, so this is a table lookup, and doesn't need
+  /// the program to be in use.  The answer is -1 for a name that
+  /// isn't there, or that the compiler optimized away, and also while
+  /// the shader is still compiling, so look the IDs up again once
+  /// isReady() says yes.
   GLuint getAttribID(const std::string &attribName);
 
-  /// Get the ID number for a uniform name that appears in a shader.
+  /// \brief Get the ID number for a uniform name that appears in a shader.
+  ///
+  /// Same as getAttribID().  For an array, either "name" or "name[0]"
+  /// will do.
   GLuint getUniformID(const std::string &unifName);
 
+  /// \brief The active uniforms of the program, with their types and sizes.
+  ///
+  /// This one, and getAttribs(), wait for a program that is still
+  /// compiling.
+  const shaderVariableTable &getUniforms();
+
+  /// \brief The active attributes of the program, with their types and sizes.
+  const shaderVariableTable &getAttribs();
+
+  /// \brief Look up a uniform of any program compiled by a shaderMgr.
+  ///
+  /// For code that only has the program ID, like drawableObj and
+  /// lightList.  A program that didn't come from a shaderMgr is asked
+  /// about in the usual way.
+  static GLint findUniform(const GLuint &programID, const std::string &name) {
+    return _find(programID, name, true);
+  };
+
+  /// \brief Look up an attribute of any program compiled by a shaderMgr.
+  static GLint findAttrib(const GLuint &programID, const std::string &name) {
+    return _find(programID, name, false);
+  };
+
   /// \brief Returns the program ID of the compiled shader.
   GLuint getProgram() { return _programID; };
 
@@ -564,7 +1125,10 @@ class shaderMgr {
   /// on this shader program, like enabling a buffer or loading an
   /// attribute's data.  OpenGL uses "state", and this call puts the
   /// GPU in a state of being ready to use this shader.
-  void useProgram() { glUseProgram(_programID); };
+  void useProgram() {
+    drawStats::counts.programChanges++;
+    glUseProgram(_programID);
+  };
 
   /// \brief Sanity check could go here.
   ///
@@ -576,6 +1140,9 @@ class shaderMgr {
   /// \brief Prepare shader data to be used in a draw.
   ///
   /// Gets things like the light list ready to be used in a shader.
+  /// If the number of lights, the texture, or the defines have
+  /// changed, this is where the program changes to match, so check
+  /// getProgram() afterward.
   void load();
 
   /// \brief Use shader data in a render.
@@ -610,6 +1177,11 @@ class drawableObj {
   drawableObjData<glm::vec4> _normals;
   drawableObjData<glm::vec2> _uvs;
 
+  // An optional index array.  If this is empty, the vertices are
+  // drawn in order with glDrawArrays().  If not, they are drawn with
+  // glDrawElements(), and the count refers to the number of indices.
+  drawableObjData<GLuint> _indices;
+
   std::vector<glm::vec4> _fakeColors;
   std::vector<glm::vec4> _realColors;
 
@@ -618,6 +1190,17 @@ class drawableObj {
 
   bool _loadedIntoBuffer;
 
+  // For objects whose data changes after they are loaded.  The dirty
+  // range is the vertices changed since the last load, which are the
+  // only ones sent to the GPU again.
+  bool _dynamic;
+  size_t _dirtyBegin, _dirtyEnd;
+  bool _indicesChanged;
+  size_t _indexBufferSize;
+  GLenum _usage() { return _dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW; };
+  void _markDirty(const size_t &first, const size_t &n);
+  void _updateSeparate();
+
   /// Some data for selectability and managing of bounding boxes.
   bool _selectable;
   bool _haveBoundingBox;
@@ -637,12 +1220,20 @@ class drawableObj {
   void _prepareInterleaved(GLuint programID);
   void _loadSeparate();
   void _loadInterleaved();
+  void _interleave();
+  void _loadIndices();
   void _drawSeparate();
   void _drawInterleaved();
+  void _drawArrays();
 
  public:
  drawableObj() :
   _loadedIntoBuffer(false),
+    _dynamic(false),
+    _dirtyBegin(0),
+    _dirtyEnd(0),
+    _indicesChanged(false),
+    _indexBufferSize(0),
     _interleaved(false),
     _selectable(true),
     _boundingBoxMin(0.1),
@@ -651,6 +1242,14 @@ class drawableObj {
   /// \brief Set up the buffers to be interleaved,
   void setInterleaved(bool interleaved) { _interleaved = interleaved; };
 
+  /// \brief Say that this object's data will change often.
+  ///
+  /// The buffers are then allocated as GL_DYNAMIC_DRAW, and changes
+  /// made with updateData() are sent to the GPU with
+  /// glBufferSubData(), only for the vertices that changed, instead
+  /// of reallocating the whole buffer.
+  void setDynamic(const bool &dynamic) { _dynamic = dynamic; };
+
   /// \brief Specify the draw type of the shape.
   ///
   /// This refers to the OpenGL primitive draw types.  You can read
@@ -660,18 +1259,53 @@ class drawableObj {
   /// http://www.falloutsoftware.com/tutorials/gl/gl3.htm
   void setDrawType(const GLenum drawType) {
     _drawType = drawType;
-    _count = _vertices.size();
+    _count = _indices.empty() ? _vertices.size() : _indices.size();
   };
 
   /// \brief Specify the draw type and the vertex count.
   ///
   /// The count refers here to the number of vertices, *not* the
-  /// number of triangles, line segments, quads, whatever.
+  /// number of triangles, line segments, quads, whatever.  For an
+  /// indexed object, it's the number of indices.
   void setDrawType(const GLenum drawType, const GLsizei count) {
     _drawType = drawType;
     _count = count;
   };
 
+  /// \brief Returns the draw type of the shape.
+  GLenum getDrawType() { return _drawType; };
+
+  /// \brief Returns the number of vertices (or indices) to be drawn.
+  GLsizei getCount() { return _count; };
+
+  /// \brief Draw the vertices in the order given by an index array.
+  ///
+  /// With an index array, a vertex shared by several triangles need
+  /// only appear once in the data arrays, and the GPU can reuse its
+  /// transformed value instead of processing it again.  This resets
+  /// the count to the number of indices.  Use an empty array to go
+  /// back to drawing the vertices in order.  Changing the indices of
+  /// a loaded object only sends the new indices, not the vertices.
+  void setIndices(const std::vector<GLuint> &indices);
+
+  /// \brief Like setIndices(), but takes the contents of the array
+  /// instead of copying it.  The array you pass comes back with
+  /// whatever was in the object before.
+  void swapIndices(std::vector<GLuint> &indices);
+
+  /// \brief Returns the index array, empty if there isn't one.
+  std::vector<GLuint> getIndices() { return _indices.getData(); };
+
+  /// \brief Is this object drawn with an index array?
+  bool isIndexed() { return !_indices.empty(); };
+
+  /// \brief A copy of this object's data.
+  ///
+  /// The copy has no GL buffers yet, even if this object has been
+  /// prepared, so it gets its own when it is prepared.  (A plain
+  /// copy would share this object's buffers.)
+  bsgPtr<drawableObj> copy();
+
   /// \brief Set bounding box minimum dimension.
   ///
   /// This is for less-than-3D objects, like rectangles, points, or
@@ -699,6 +1333,34 @@ class drawableObj {
                const std::string &name,
                const std::vector<glm::vec2> &data);
 
+  /// \brief Add some vec4 data without copying it.
+  ///
+  /// This is like addData(), but the object takes the contents of the
+  /// array, and the array you pass comes back with whatever the
+  /// object held before.  For big arrays, this saves a copy.
+  void swapData(const GLDATATYPE type,
+                const std::string &name,
+                std::vector<glm::vec4> &data);
+
+  /// \brief Add some vec2 texture coordinates without copying them.
+  void swapData(const GLDATATYPE type,
+                const std::string &name,
+                std::vector<glm::vec2> &data);
+
+  /// \brief Overwrite part of an object's vec4 data.
+  ///
+  /// The data replaces the values starting at vertex number first.
+  /// The arrays can't grow this way; use setData() for that.  Only
+  /// the changed range is sent to the GPU on the next load().
+  void updateData(const GLDATATYPE type,
+                  const size_t &first,
+                  const std::vector<glm::vec4> &data);
+
+  /// \brief Overwrite part of an object's texture coordinates.
+  void updateData(const GLDATATYPE type,
+                  const size_t &first,
+                  const std::vector<glm::vec2> &data);
+
   /// \brief Change the underlying data of an object.
   ///
   /// Use this to reset the vec4 data inside an object.
@@ -709,6 +1371,15 @@ class drawableObj {
   /// Use this to reset the vec2 data inside an object.
   void setData(const GLDATATYPE type, const std::vector<glm::vec2>& data);
 
+  /// \brief Retrieve the underlying vec4 data of an object.
+  ///
+  /// Returns the vertices, colors, or normals.  The texture
+  /// coordinates are vec2, so use getTexCoords() for those.
+  std::vector<glm::vec4> getData(const GLDATATYPE type);
+
+  /// \brief Retrieve the texture coordinates of an object.
+  std::vector<glm::vec2> getTexCoords() { return _uvs.getData(); };
+
   /// \brief Set whether the object is selectable.
   ///
   /// Often used for things like axes that you probably don't want to
@@ -760,6 +1431,8 @@ class drawableObj {
   ///
   /// Call this function after all the data is in place and we know
   /// whether we have colors or textures or normals to worry about.
+  /// Calling it again, with another program, keeps the buffers and
+  /// only finds the attribute IDs again.
   void prepare(GLuint programID);
 
   /// \brief Loads the shape about to be drawn.
@@ -1078,10 +1751,39 @@ class drawableCompound : public drawableMulti {
   std::string _projMatrixName;
   GLuint _projMatrixID;
 
+  /// Two-sided objects are drawn with face culling turned off, and
+  /// the shader is told (via the uniform named here) to flip the
+  /// normals of the back faces, using gl_FrontFacing.  This saves us
+  /// from making a second, reversed copy of every triangle.
+  bool _twoSided;
+  std::string _twoSidedName;
+  GLuint _twoSidedID;
+
+  /// The program the uniform and attribute IDs came from.  If the
+  /// shader switches to another variant, they have to be found again.
+  GLuint _preparedProgram;
+
   friend std::ostream &operator<<(std::ostream &os,
                                   const drawableCompound &comp) {
     return os << comp.printObj("");  }
 
+  /// Get the IDs of the uniforms we use from the shader.
+  void _prepareUniforms();
+
+  /// Is the shader compiled, and are we prepared for it?  If not,
+  /// skip the draw.  The next load() prepares for it, which for a
+  /// compound that was already drawing just finds the IDs again.
+  bool _ready() {
+    return _pShader->isReady() && _pShader->getProgram() == _preparedProgram;
+  };
+
+  /// Send the matrices and the two-sided flag to the shader.
+  void _drawUniforms(const glm::mat4 &viewMatrix,
+                     const glm::mat4 &projMatrix);
+
+  /// Draw a list of objects, with the uniforms already in place.
+  void _drawObjects(DrawableObjList &objects);
+
  public:
  drawableCompound(bsgPtr<shaderMgr> pShader) :
   drawableMulti(),
@@ -1090,7 +1792,10 @@ class drawableCompound : public drawableMulti {
     _modelMatrixName("modelMatrix"),
     _normalMatrixName("normalMatrix"),
     _viewMatrixName("viewMatrix"),
-    _projMatrixName("projMatrix") {
+    _projMatrixName("projMatrix"),
+    _twoSided(false),
+    _twoSidedName("twoSided"),
+    _preparedProgram(0) {
     _name = randomName("obj");
   };
  drawableCompound(const std::string name, bsgPtr<shaderMgr> pShader) :
@@ -1100,7 +1805,10 @@ class drawableCompound : public drawableMulti {
     _modelMatrixName("modelMatrix"),
     _normalMatrixName("normalMatrix"),
     _viewMatrixName("viewMatrix"),
-    _projMatrixName("projMatrix") {
+    _projMatrixName("projMatrix"),
+    _twoSided(false),
+    _twoSidedName("twoSided"),
+    _preparedProgram(0) {
   };
 
   // The equipment to allow us to define an iterator over this class.
@@ -1136,6 +1844,22 @@ class drawableCompound : public drawableMulti {
     }
   };
 
+  /// \brief Draw both sides of the component objects.
+  ///
+  /// A two-sided object is drawn with GL_CULL_FACE disabled, so the
+  /// back faces of its triangles are visible.  The shader is sent a
+  /// boolean uniform (called "twoSided" unless you change it with
+  /// setTwoSidedName()) so it can use gl_FrontFacing to flip the
+  /// normal of a back-facing fragment.  Shaders that don't use
+  /// normals can ignore the uniform.
+  void setTwoSided(const bool &twoSided) { _twoSided = twoSided; };
+
+  /// \brief Is this object drawn two-sided?
+  bool getTwoSided() { return _twoSided; };
+
+  /// \brief Set the name of the two-sided uniform used in the shader.
+  void setTwoSidedName(const std::string &name) { _twoSidedName = name; };
+
   /// \brief Adds an object to the compound object.
   ///
   /// We set the shader to each object to be the same shader for the
@@ -1220,6 +1944,10 @@ class drawableCollection : public drawableMulti {
   typedef std::map<std::string, bsgPtr<drawableMulti> > CollectionMap;
   CollectionMap _collection;
 
+  /// The GL calls made by this collection and everything under it,
+  /// in the last load() and the draws since.
+  drawStats _stats;
+
   friend std::ostream &operator<<(std::ostream &os,
                                   const drawableCollection &coll) {
     return os << coll.printObj("  ");
@@ -1304,6 +2032,17 @@ class drawableCollection : public drawableMulti {
   /// \brief Returns a printable display of the collection.
   std::string printObj(const std::string &prefix) const;
 
+  /// \brief The GL calls made by this collection this frame.
+  ///
+  /// Includes everything in the collection, and in the collections
+  /// in it.  Starts over with each load(), so if there's more than
+  /// one draw() in a frame, as for stereo, they are all counted.
+  drawStats getStats() const { return _stats; };
+
+  /// \brief Returns a printable display of the stats of this
+  /// collection and the collections in it.
+  std::string printStats(const std::string &prefix) const;
+
   /// \brief Gets ready for the drawing sequence.
   ///
   void prepare();
@@ -1324,6 +2063,98 @@ class drawableCollection : public drawableMulti {
 
 };
 
+/// \brief A node that draws one of several versions of an object.
+///
+/// Far away objects don't need all their triangles.  This node holds
+/// a list of "levels," from the most detailed to the least, each
+/// labeled with its error: the distance (in the node's model space)
+/// by which its surface may be off from the original.  On each draw,
+/// that error is projected onto the screen using the current view
+/// and projection matrices and the height of the viewport, and the
+/// node draws the simplest level whose error covers fewer pixels
+/// than the threshold (one pixel, unless you change it).
+///
+/// To avoid popping back and forth when an object sits right at the
+/// switching distance, there is some hysteresis: a coarser level is
+/// only taken once its error is comfortably under the threshold, and
+/// a finer one only once the current error is comfortably over it.
+///
+/// The levels are usually drawableCompound objects sharing a shader,
+/// and positioned identically.  The node has its own model matrix,
+/// like any other drawableMulti, and the levels are its children.
+/// See drawableObjModel::getLOD() for a way to generate the levels
+/// automatically.
+class drawableLOD : public drawableMulti {
+ private:
+  std::vector<bsgPtr<drawableMulti> > _levels;
+  std::vector<float> _errors;
+
+  // The level drawn most recently.
+  int _current;
+
+  float _pixelThreshold;
+  float _hysteresis;
+
+  // The error is projected from this point, in model space.
+  glm::vec3 _center;
+
+ public:
+  drawableLOD() : drawableMulti(), _current(0), _pixelThreshold(1.0f),
+    _hysteresis(0.25f), _center(glm::vec3(0.0f)) {
+    _name = randomName("lod");
+  };
+  drawableLOD(const std::string name) : drawableMulti(name), _current(0),
+    _pixelThreshold(1.0f), _hysteresis(0.25f), _center(glm::vec3(0.0f)) {};
+
+  /// \brief Add a level.
+  ///
+  /// Add the levels in order, from the most detailed (whose error is
+  /// usually zero) to the least.
+  void addLevel(const bsgPtr<drawableMulti> &level, const float &error);
+
+  /// \brief How many levels are there?
+  int getNumLevels() { return _levels.size(); };
+
+  /// \brief Which level was drawn last?
+  int getCurrentLevel() { return _current; };
+
+  /// \brief Get one of the levels.
+  bsgPtr<drawableMulti> getLevel(const int &i) { return _levels[i]; };
+
+  /// \brief Set the largest error, in pixels, we'll put up with.
+  void setPixelThreshold(const float &pixels) { _pixelThreshold = pixels; };
+
+  /// \brief Set the hysteresis, as a fraction of the threshold.
+  void setHysteresis(const float &hysteresis) { _hysteresis = hysteresis; };
+
+  /// \brief Set the point from which distances are measured.
+  ///
+  /// This is in model space, and should be somewhere around the
+  /// middle of the object.  The default is the origin.
+  void setCenter(const glm::vec3 &center) { _center = center; };
+
+  /// \brief Returns the bounding box hits of the most detailed level.
+  bsgNameList insideBoundingBox(const glm::vec4 &testPoint);
+
+  /// \brief Returns the names of the most detailed level.
+  bsgNameList getNames();
+
+  /// \brief A printable representation of the object.
+  std::string printObj(const std::string &prefix) const;
+
+  /// \brief Gets all the levels ready for the drawing sequence.
+  void prepare();
+
+  /// \brief Loads all the levels.
+  ///
+  /// They are all loaded, so switching levels costs nothing.
+  void load();
+
+  /// \brief Picks a level and draws it.
+  void draw(const glm::mat4 &viewMatrix,
+            const glm::mat4 &projMatrix);
+};
+
 /// \brief A collection of drawable objects that make up a scene.
 ///
 /// A scene is a collection of objects to render, and is also where
@@ -1384,6 +2215,10 @@ class scene {
 
   drawableCollection _sceneRoot;
 
+  /// The GL calls made this frame, including the textures sent to
+  /// the GPU in load(), which don't belong to any collection.
+  drawStats _stats;
+
   glm::mat4 _viewMatrix;
   glm::mat4 _projMatrix;
 
@@ -1536,6 +2371,27 @@ class scene {
   /// \brief Retrieve an object name identified by a selected point.
   bsgNameList insideBoundingBox(const glm::vec4 &testPoint);
 
+  /// \brief The GL calls made this frame.
+  ///
+  /// Counts the draws, the changes of program, buffer and texture,
+  /// the uniforms and the data uploads made since the start of the
+  /// last load(), through the draws after it.  Check it after
+  /// drawing.  To see where they came from, see getObjectStats().
+  drawStats getStats() const { return _stats; };
+
+  /// \brief The GL calls made this frame by one collection.
+  ///
+  /// Includes everything under it.  Returns empty stats if the name
+  /// is not a collection.
+  drawStats getObjectStats(bsgName &name);
+
+  /// \brief Print the stats for the frame.
+  ///
+  /// With subtrees set, the stats of each collection in the scene
+  /// are printed after the totals, indented like the tree.  Call it
+  /// after drawing, every frame if you like.
+  void printStats(std::ostream &os = std::cout, const bool &subtrees = true);
+
   /// \brief Loads all the compound elements.
   void load();
 
@@ -0,0 +1,233 @@
+#include "bsgClusteredLights.h"
+
+namespace bsg {
+
+const int clusteredLightList::_indexTextureWidth;
+
+clusteredLightList::clusteredLightList(const int &nx, const int &ny,
+                                       const int &nz) :
+  lightList(),
+  _defaultRadius(10.0f),
+  _nx(nx), _ny(ny), _nz(nz),
+  _near(0.1f), _sliceScale(1.0f),
+  _lightTexture(0), _clusterTexture(0), _indexTexture(0),
+  _lightTextureWidth(0), _indexTextureRows(0),
+  _firstTextureUnit(GL_TEXTURE1) {
+
+  _viewport[0] = _viewport[1] = 0;
+  _viewport[2] = _viewport[3] = 1;
+}
+
+clusteredLightList::~clusteredLightList() {
+
+  if (_lightTexture) glDeleteTextures(1, &_lightTexture);
+  if (_clusterTexture) glDeleteTextures(1, &_clusterTexture);
+  if (_indexTexture) glDeleteTextures(1, &_indexTexture);
+}
+
+int clusteredLightList::addLight(const glm::vec4 &position,
+                                 const glm::vec4 &color,
+                                 const float &radius) {
+
+  int n = lightList::addLight(position, color);
+  setRadius(n - 1, radius);
+  return n;
+}
+
+void clusteredLightList::addDefines(std::map<std::string,
+                                    std::string> &defines) {
+
+  // NUM_LIGHTS is only there for shaders written for the plain list.
+  defines["NUM_LIGHTS"] = "1";
+  defines["BSG_CLUSTERED_LIGHTS"] = "1";
+}
+
+// The slices are spaced evenly in log(depth), so the clusters are
+// roughly as deep as they are wide all the way out.
+int clusteredLightList::_slice(const float &depth) {
+
+  int slice = (int)floor(log(std::max(depth, _near) / _near) * _sliceScale);
+  return std::min(std::max(slice, 0), _nz - 1);
+}
+
+void clusteredLightList::cluster(const glm::mat4 &viewMatrix,
+                                 const glm::mat4 &projMatrix) {
+
+  // The near and far planes, from the perspective projection.
+  _near = projMatrix[3][2] / (projMatrix[2][2] - 1.0f);
+  float far = projMatrix[3][2] / (projMatrix[2][2] + 1.0f);
+  _sliceScale = _nz / log(far / _near);
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  for (int i = 0; i < 4; i++) _viewport[i] = viewport[i];
+
+  int nLights = getNumLights();
+  _radii.resize(nLights, _defaultRadius);
+  _ranges.resize(nLights);
+  _lightTexels.resize(2 * std::max(nLights, 1));
+
+  int nClusters = _nx * _ny * _nz;
+  _counts.assign(nClusters, 0);
+
+  // First find the clusters each light reaches, and count the lights
+  // in each cluster.  A light only touches the clusters in a box
+  // around it, so this is about the number of lights, not the number
+  // of lights times the number of clusters.
+  for (int i = 0; i < nLights; i++) {
+    glm::vec4 p = viewMatrix * _lightPositions[i];
+    float r = _radii[i];
+
+    _lightTexels[i] = glm::vec4(glm::vec3(p), r);
+    _lightTexels[std::max(nLights, 1) + i] = _lightColors[i];
+
+    clusterRange &range = _ranges[i];
+    range.x0 = range.y0 = range.z0 = 0;
+    range.x1 = range.y1 = range.z1 = -1;
+
+    // Behind us, or past the far plane?
+    float depth = -p.z;
+    if (depth + r < _near || depth - r > far) continue;
+
+    range.z0 = _slice(depth - r);
+    range.z1 = _slice(depth + r);
+
+    // Project the corners of the box around the light's sphere.  The
+    // ones in front of the near plane are pulled back to it, which
+    // only makes the box on the screen bigger, so it's still safe.
+    glm::vec2 lower(1.0e30f), upper(-1.0e30f);
+    for (int c = 0; c < 8; c++) {
+      glm::vec4 corner(p.x + ((c & 1) ? r : -r),
+                       p.y + ((c & 2) ? r : -r),
+                       std::min(p.z + ((c & 4) ? r : -r), -_near),
+                       1.0f);
+      glm::vec4 clip = projMatrix * corner;
+      glm::vec2 ndc = glm::vec2(clip) / clip.w;
+      lower = glm::min(lower, ndc);
+      upper = glm::max(upper, ndc);
+    }
+    if (upper.x < -1.0f || lower.x > 1.0f || upper.y < -1.0f || lower.y > 1.0f)
+      continue;
+
+    range.x0 = std::max(0, (int)floor((lower.x * 0.5f + 0.5f) * _nx));
+    range.x1 = std::min(_nx - 1, (int)floor((upper.x * 0.5f + 0.5f) * _nx));
+    range.y0 = std::max(0, (int)floor((lower.y * 0.5f + 0.5f) * _ny));
+    range.y1 = std::min(_ny - 1, (int)floor((upper.y * 0.5f + 0.5f) * _ny));
+
+    for (int z = range.z0; z <= range.z1; z++)
+      for (int y = range.y0; y <= range.y1; y++)
+        for (int x = range.x0; x <= range.x1; x++)
+          _counts[(z * _ny + y) * _nx + x]++;
+  }
+
+  // Then work out where each cluster's lights start in the index
+  // list, and fill it in.
+  _offsets.resize(nClusters);
+  GLuint total = 0;
+  for (int c = 0; c < nClusters; c++) {
+    _offsets[c] = total;
+    total += _counts[c];
+  }
+
+  _indices.resize(std::max(total, (GLuint)1));
+  std::vector<GLuint> next = _offsets;
+  for (int i = 0; i < nLights; i++) {
+    const clusterRange &range = _ranges[i];
+    for (int z = range.z0; z <= range.z1; z++)
+      for (int y = range.y0; y <= range.y1; y++)
+        for (int x = range.x0; x <= range.x1; x++)
+          _indices[next[(z * _ny + y) * _nx + x]++] = i;
+  }
+  _indices.resize(total);
+
+  _clusterTexels.resize(nClusters);
+  for (int c = 0; c < nClusters; c++)
+    _clusterTexels[c] = glm::vec4(_offsets[c], _counts[c], 0.0f, 0.0f);
+
+  // Now send it all to the GPU.
+  if (!GLEW_ARB_texture_float)
+    throw std::runtime_error("clusteredLightList needs GL_ARB_texture_float.");
+
+  int lightWidth = std::max(nLights, 1);
+  _upload(_lightTexture, GL_RGBA32F_ARB, GL_RGBA, lightWidth, 2,
+          _lightTextureWidth, 2, &_lightTexels[0]);
+  _lightTextureWidth = lightWidth;
+
+  _upload(_clusterTexture, GL_RGBA32F_ARB, GL_RGBA, _nx * _ny, _nz,
+          _nx * _ny, _nz, &_clusterTexels[0]);
+
+  // The index list is folded into rows, since a texture can only be
+  // so wide.
+  int rows = std::max(1, (int)(total + _indexTextureWidth - 1) / _indexTextureWidth);
+  _indices.resize(rows * _indexTextureWidth, 0.0f);
+  _upload(_indexTexture, GL_LUMINANCE32F_ARB, GL_LUMINANCE,
+          _indexTextureWidth, rows, _indexTextureWidth, _indexTextureRows,
+          &_indices[0]);
+  _indexTextureRows = rows;
+  _indices.resize(total);
+}
+
+// Sends data to a texture, making it over only if it has changed size.
+void clusteredLightList::_upload(GLuint &texture, const GLenum &internalFormat,
+                                 const GLenum &format,
+                                 const int &width, const int &height,
+                                 const int &oldWidth, const int &oldHeight,
+                                 const void *data) {
+
+  bool made = (texture != 0);
+  if (!made) glGenTextures(1, &texture);
+
+  glActiveTexture(_firstTextureUnit);
+  drawStats::counts.textureBinds++;
+  glBindTexture(GL_TEXTURE_2D, texture);
+
+  // One float per texel, or four.
+  drawStats::counts.textureUpload((size_t)width * height * sizeof(float) *
+                                  ((format == GL_RGBA) ? 4 : 1));
+
+  if (made && width == oldWidth && height == oldHeight) {
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height,
+                    format, GL_FLOAT, data);
+  } else {
+    // These are tables, not pictures, so no filtering.
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0,
+                 format, GL_FLOAT, data);
+  }
+
+  glActiveTexture(GL_TEXTURE0);
+}
+
+void clusteredLightList::draw(const GLint programID) {
+
+  GLuint textures[3] = { _lightTexture, _clusterTexture, _indexTexture };
+  const char *names[3] = { "clusterLights", "clusterGrid", "clusterIndices" };
+
+  for (int i = 0; i < 3; i++) {
+    glActiveTexture(_firstTextureUnit + i);
+    drawStats::counts.textureBinds++;
+    drawStats::counts.uniformUploads++;
+    glBindTexture(GL_TEXTURE_2D, textures[i]);
+    glUniform1i(shaderMgr::findUniform(programID, names[i]),
+                _firstTextureUnit + i - GL_TEXTURE0);
+  }
+  glActiveTexture(GL_TEXTURE0);
+
+  drawStats::counts.uniformUploads += 5;
+  glUniform3f(shaderMgr::findUniform(programID, "clusterDims"),
+              (float)_nx, (float)_ny, (float)_nz);
+  glUniform2f(shaderMgr::findUniform(programID, "clusterDepth"),
+              _near, _sliceScale);
+  glUniform2f(shaderMgr::findUniform(programID, "clusterLightSize"),
+              (float)std::max(_lightTextureWidth, 1), 2.0f);
+  glUniform2f(shaderMgr::findUniform(programID, "clusterIndexSize"),
+              (float)_indexTextureWidth, (float)std::max(_indexTextureRows, 1));
+  glUniform4f(shaderMgr::findUniform(programID, "clusterViewport"),
+              (float)_viewport[0], (float)_viewport[1],
+              (float)_viewport[2], (float)_viewport[3]);
+}
+
+}
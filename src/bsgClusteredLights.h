@@ -0,0 +1,126 @@
+#ifndef BSGCLUSTEREDLIGHTS
+#define BSGCLUSTEREDLIGHTS
+
+#include "bsg.h"
+
+namespace bsg {
+
+/// \class clusteredLightList
+/// \brief A light list for scenes with hundreds of lights.
+///
+/// The plain lightList hands every light to the shader in a uniform
+/// array, and every fragment adds up every light.  That costs the
+/// number of lights times the number of fragments, and the arrays can
+/// only be so big.  This list gives each light a radius, beyond which
+/// it has no effect, and every frame sorts the lights into clusters:
+/// the view frustum is cut into a grid of tiles across the screen,
+/// and into slices in depth, spaced farther apart the farther away
+/// they are.  Each fragment finds its cluster and adds up only the
+/// lights that reach it.
+///
+/// The lights and clusters go to the shader in three float textures,
+/// which needs GL_ARB_texture_float.  Use it with
+/// shaders/clusteredShader.vp and shaders/clusteredShader.fp, which
+/// are compiled with BSG_CLUSTERED_LIGHTS defined.  The number of
+/// lights isn't compiled into the shader, so lights can come and go
+/// without a new variant.
+///
+/// The clusters depend on the view, so call cluster() once a frame,
+/// with the view and projection matrices, before drawing.
+class clusteredLightList : public lightList {
+ private:
+
+  /// The radius of each light, in world units.
+  std::vector<float> _radii;
+  float _defaultRadius;
+
+  /// The number of clusters across, up, and deep.
+  int _nx, _ny, _nz;
+
+  /// The near plane, the slices per unit of log(depth), and the
+  /// viewport the clusters cover.
+  float _near;
+  float _sliceScale;
+  int _viewport[4];
+
+  /// The first cluster and last cluster in each direction that each
+  /// light reaches.
+  struct clusterRange {
+    int x0, x1, y0, y1, z0, z1;
+  };
+  std::vector<clusterRange> _ranges;
+
+  /// For each cluster, where its lights start in the index list, and
+  /// how many there are.  Then the index list itself.
+  std::vector<GLuint> _offsets;
+  std::vector<GLuint> _counts;
+  std::vector<float> _indices;
+
+  /// The data for the textures: the lights in view space (position
+  /// and radius, then color), the clusters, and the index list.
+  std::vector<glm::vec4> _lightTexels;
+  std::vector<glm::vec4> _clusterTexels;
+
+  GLuint _lightTexture, _clusterTexture, _indexTexture;
+  int _lightTextureWidth, _indexTextureRows;
+  static const int _indexTextureWidth = 1024;
+
+  /// The textures go in this texture unit and the next two.  Unit 0
+  /// is for the textureMgr.
+  GLenum _firstTextureUnit;
+
+  int _slice(const float &depth);
+  void _upload(GLuint &texture, const GLenum &internalFormat,
+               const GLenum &format, const int &width, const int &height,
+               const int &oldWidth, const int &oldHeight, const void *data);
+
+ public:
+  /// \brief Make an empty list, with the given number of clusters.
+  ///
+  /// The default is 16 by 9 tiles, for a wide screen, and 24 slices.
+  clusteredLightList(const int &nx = 16, const int &ny = 9, const int &nz = 24);
+  ~clusteredLightList();
+
+  /// \brief Add a light that reaches as far as the given radius.
+  ///
+  /// Returns the number of lights.  Lights added with the two
+  /// lightList versions of addLight() get the default radius.
+  int addLight(const glm::vec4 &position, const glm::vec4 &color,
+               const float &radius);
+  using lightList::addLight;
+
+  /// \brief Change how far a light reaches.
+  void setRadius(const int &i, const float &radius) {
+    if ((int)_radii.size() <= i) _radii.resize(i + 1, _defaultRadius);
+    _radii[i] = radius;
+  };
+  float getRadius(const int &i) {
+    return (i < (int)_radii.size()) ? _radii[i] : _defaultRadius;
+  };
+
+  /// \brief The radius of lights that weren't given one.
+  void setDefaultRadius(const float &radius) { _defaultRadius = radius; };
+
+  /// \brief Sort the lights into clusters for this view.
+  ///
+  /// Call this once a frame, after the lights and the camera have
+  /// moved, and before the scene is drawn.  The projection has to be
+  /// a perspective one.  This needs the GL context, since it sends
+  /// the clusters to the GPU.
+  void cluster(const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix);
+
+  /// \brief The average number of lights per cluster, for tuning.
+  float getAverageLightsPerCluster() {
+    return _counts.empty() ? 0.0f : (float)_indices.size() / _counts.size();
+  };
+
+  // The uniforms are looked up in draw(), since the program's
+  // reflection table makes that cheap, so there's nothing to load.
+  void load(const GLint) {}
+  void draw(const GLint programID);
+  void addDefines(std::map<std::string, std::string> &defines);
+};
+
+}
+
+#endif
@@ -0,0 +1,294 @@
+#include "bsgGenerators.h"
+#include <algorithm>
+#include <thread>
+
+namespace bsg {
+
+// A unit shape, to be copied for each instance.
+struct _template {
+  std::vector<glm::vec4> positions;
+  std::vector<glm::vec4> normals;
+  std::vector<glm::vec2> uvs;
+  std::vector<GLuint> indices;
+};
+
+// Run f(begin, end) over the range [0, n), split into about equal
+// pieces, one per thread.
+template <class F>
+static void _parallelFor(const size_t &n, int nThreads, F f) {
+
+  if (nThreads <= 0) nThreads = std::thread::hardware_concurrency();
+  if (nThreads <= 0) nThreads = 1;
+
+  // There's no point in starting a thread for a handful of shapes.
+  nThreads = (int)std::min((size_t)nThreads, (n + 255) / 256);
+  if (nThreads <= 1) {
+    f((size_t)0, n);
+    return;
+  }
+
+  std::vector<std::thread> threads;
+  size_t chunk = (n + nThreads - 1) / nThreads;
+  for (int t = 0; t < nThreads; t++) {
+    size_t begin = t * chunk;
+    size_t end = std::min(n, begin + chunk);
+    if (begin >= end) break;
+    threads.push_back(std::thread(f, begin, end));
+  }
+  for (size_t t = 0; t < threads.size(); t++) threads[t].join();
+}
+
+// Put the results into the output object.  The arrays are big, so
+// they are swapped in rather than copied.
+static void _store(bsgPtr<drawableObj> out,
+                   std::vector<glm::vec4> &positions,
+                   std::vector<glm::vec4> &colors,
+                   std::vector<glm::vec4> &normals,
+                   std::vector<glm::vec2> &uvs,
+                   std::vector<GLuint> &indices) {
+
+  out->swapData(GLDATA_VERTICES, "position", positions);
+  out->swapData(GLDATA_COLORS, "color", colors);
+  out->swapData(GLDATA_NORMALS, "normal", normals);
+  out->swapData(GLDATA_TEXCOORDS, "texture", uvs);
+  out->swapIndices(indices);
+  out->setDrawType(GL_TRIANGLES);
+}
+
+void primitiveGenerator::circleTable(const int &n,
+                                     std::vector<float> &cosines,
+                                     std::vector<float> &sines) {
+
+  cosines.resize(n + 1);
+  sines.resize(n + 1);
+
+  float step = 2.0f * M_PI / n;
+  for (int i = 0; i < n; i++) {
+    cosines[i] = cos(step * i);
+    sines[i] = sin(step * i);
+  }
+
+  // Close the circle exactly.
+  cosines[n] = cosines[0];
+  sines[n] = sines[0];
+}
+
+// A unit sphere, with the same layout of vertices and texture
+// coordinates as drawableSphere, but indexed.
+static void _unitSphere(const int &phi, const int &theta, _template &t) {
+
+  std::vector<float> cosTheta, sinTheta;
+  primitiveGenerator::circleTable(theta, cosTheta, sinTheta);
+
+  t.positions.reserve((phi + 1) * (theta + 1));
+  t.normals.reserve((phi + 1) * (theta + 1));
+  t.uvs.reserve((phi + 1) * (theta + 1));
+
+  for (int j = 0; j <= phi; j++) {
+    float sinPhi = sin(M_PI * j / phi);
+    float cosPhi = cos(M_PI * j / phi);
+
+    for (int i = 0; i <= theta; i++) {
+      // The sphere goes around clockwise, seen from above.
+      glm::vec4 n = glm::vec4(sinPhi * cosTheta[i], cosPhi,
+                              -sinPhi * sinTheta[i], 0.0f);
+      t.normals.push_back(n);
+      t.positions.push_back(glm::vec4(glm::vec3(n), 1.0f));
+      t.uvs.push_back(glm::vec2((float)i / theta, 1.0f - (float)j / phi));
+    }
+  }
+
+  // Two triangles per quad, except at the poles, where one of them
+  // has no area.
+  t.indices.reserve(6 * theta * (phi - 1));
+  for (int j = 0; j < phi; j++) {
+    for (int i = 0; i < theta; i++) {
+      GLuint a = j * (theta + 1) + i;
+      GLuint b = a + theta + 1;
+      if (j > 0) {
+        t.indices.push_back(a);
+        t.indices.push_back(b);
+        t.indices.push_back(a + 1);
+      }
+      if (j < phi - 1) {
+        t.indices.push_back(b);
+        t.indices.push_back(b + 1);
+        t.indices.push_back(a + 1);
+      }
+    }
+  }
+}
+
+void primitiveGenerator::spheres(bsgPtr<drawableObj> out,
+                                 const std::vector<glm::vec4> &spheres,
+                                 const std::vector<glm::vec4> &colors,
+                                 const int &phiTesselation,
+                                 const int &thetaTesselation,
+                                 const int &nThreads) {
+
+  if (colors.size() != 1 && colors.size() != spheres.size())
+    throw std::runtime_error("Need one color for all the spheres, or one for each.");
+
+  _template unit;
+  _unitSphere(phiTesselation, thetaTesselation, unit);
+
+  size_t n = spheres.size();
+  size_t nv = unit.positions.size();
+  size_t ni = unit.indices.size();
+
+  std::vector<glm::vec4> positions(n * nv);
+  std::vector<glm::vec4> outColors(n * nv);
+  std::vector<glm::vec4> normals(n * nv);
+  std::vector<glm::vec2> uvs(n * nv);
+  std::vector<GLuint> indices(n * ni);
+
+  _parallelFor(n, nThreads, [&](size_t begin, size_t end) {
+      for (size_t s = begin; s < end; s++) {
+        glm::vec4 center = glm::vec4(glm::vec3(spheres[s]), 0.0f);
+        float r = spheres[s].w;
+        glm::vec4 color = colors[colors.size() > 1 ? s : 0];
+
+        glm::vec4 *p = &positions[s * nv];
+        for (size_t v = 0; v < nv; v++) {
+          p[v] = center + r * unit.normals[v];
+          p[v].w = 1.0f;
+        }
+
+        std::fill(&outColors[s * nv], &outColors[s * nv] + nv, color);
+        std::copy(unit.normals.begin(), unit.normals.end(), &normals[s * nv]);
+        std::copy(unit.uvs.begin(), unit.uvs.end(), &uvs[s * nv]);
+
+        GLuint base = s * nv;
+        GLuint *idx = &indices[s * ni];
+        for (size_t i = 0; i < ni; i++) idx[i] = unit.indices[i] + base;
+      }
+    });
+
+  _store(out, positions, outColors, normals, uvs, indices);
+}
+
+void primitiveGenerator::cylinders(bsgPtr<drawableObj> out,
+                                   const std::vector<glm::vec3> &starts,
+                                   const std::vector<glm::vec3> &ends,
+                                   const std::vector<float> &radii,
+                                   const std::vector<glm::vec4> &colors,
+                                   const int &thetaTesselation,
+                                   const int &nThreads) {
+
+  if (colors.size() != 1 && colors.size() != starts.size())
+    throw std::runtime_error("Need one color for all the cylinders, or one for each.");
+  if (ends.size() != starts.size() || radii.size() != starts.size())
+    throw std::runtime_error("Need the same number of starts, ends, and radii.");
+
+  std::vector<float> cosTheta, sinTheta;
+  circleTable(thetaTesselation, cosTheta, sinTheta);
+
+  size_t n = starts.size();
+  size_t nv = 2 * (thetaTesselation + 1);
+  size_t ni = 6 * thetaTesselation;
+
+  std::vector<glm::vec4> positions(n * nv);
+  std::vector<glm::vec4> outColors(n * nv);
+  std::vector<glm::vec4> normals(n * nv);
+  std::vector<glm::vec2> uvs(n * nv);
+  std::vector<GLuint> indices(n * ni);
+
+  _parallelFor(n, nThreads, [&](size_t begin, size_t end) {
+      for (size_t c = begin; c < end; c++) {
+        glm::vec3 axis = ends[c] - starts[c];
+
+        // Find two unit vectors perpendicular to the axis and to each
+        // other.  Start from whichever coordinate axis is least
+        // parallel to it.
+        glm::vec3 w = glm::normalize(axis);
+        glm::vec3 helper = (fabs(w.x) < 0.9f) ?
+          glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        glm::vec3 u = glm::normalize(glm::cross(helper, w));
+        glm::vec3 v = glm::cross(w, u);
+
+        glm::vec4 color = colors[colors.size() > 1 ? c : 0];
+        float r = radii[c];
+
+        size_t base = c * nv;
+        for (int i = 0; i <= thetaTesselation; i++) {
+          glm::vec3 nrm = cosTheta[i] * u + sinTheta[i] * v;
+          glm::vec3 bottom = starts[c] + r * nrm;
+
+          positions[base + 2 * i] = glm::vec4(bottom, 1.0f);
+          positions[base + 2 * i + 1] = glm::vec4(bottom + axis, 1.0f);
+          normals[base + 2 * i] = glm::vec4(nrm, 0.0f);
+          normals[base + 2 * i + 1] = glm::vec4(nrm, 0.0f);
+          uvs[base + 2 * i] = glm::vec2((float)i / thetaTesselation, 0.0f);
+          uvs[base + 2 * i + 1] = glm::vec2((float)i / thetaTesselation, 1.0f);
+        }
+        std::fill(&outColors[base], &outColors[base] + nv, color);
+
+        GLuint *idx = &indices[c * ni];
+        for (int i = 0; i < thetaTesselation; i++) {
+          GLuint a = base + 2 * i;
+          idx[6 * i] = a;
+          idx[6 * i + 1] = a + 2;
+          idx[6 * i + 2] = a + 1;
+          idx[6 * i + 3] = a + 1;
+          idx[6 * i + 4] = a + 2;
+          idx[6 * i + 5] = a + 3;
+        }
+      }
+    });
+
+  _store(out, positions, outColors, normals, uvs, indices);
+}
+
+void primitiveGenerator::quads(bsgPtr<drawableObj> out,
+                               const std::vector<glm::vec3> &corners,
+                               const std::vector<glm::vec2> &sizes,
+                               const std::vector<glm::vec4> &texRects,
+                               const std::vector<glm::vec4> &colors,
+                               const int &nThreads) {
+
+  if (colors.size() != 1 && colors.size() != corners.size())
+    throw std::runtime_error("Need one color for all the quads, or one for each.");
+  if (sizes.size() != corners.size() || texRects.size() != corners.size())
+    throw std::runtime_error("Need the same number of corners, sizes, and texture rectangles.");
+
+  size_t n = corners.size();
+
+  std::vector<glm::vec4> positions(n * 4);
+  std::vector<glm::vec4> outColors(n * 4);
+  std::vector<glm::vec4> normals(n * 4, glm::vec4(0.0f, 0.0f, 1.0f, 0.0f));
+  std::vector<glm::vec2> uvs(n * 4);
+  std::vector<GLuint> indices(n * 6);
+
+  _parallelFor(n, nThreads, [&](size_t begin, size_t end) {
+      for (size_t q = begin; q < end; q++) {
+        glm::vec3 p = corners[q];
+        glm::vec2 s = sizes[q];
+        glm::vec4 t = texRects[q];
+        glm::vec4 color = colors[colors.size() > 1 ? q : 0];
+
+        positions[4 * q] = glm::vec4(p.x, p.y, p.z, 1.0f);
+        positions[4 * q + 1] = glm::vec4(p.x + s.x, p.y, p.z, 1.0f);
+        positions[4 * q + 2] = glm::vec4(p.x + s.x, p.y + s.y, p.z, 1.0f);
+        positions[4 * q + 3] = glm::vec4(p.x, p.y + s.y, p.z, 1.0f);
+
+        uvs[4 * q] = glm::vec2(t.x, t.y);
+        uvs[4 * q + 1] = glm::vec2(t.z, t.y);
+        uvs[4 * q + 2] = glm::vec2(t.z, t.w);
+        uvs[4 * q + 3] = glm::vec2(t.x, t.w);
+
+        for (int k = 0; k < 4; k++) outColors[4 * q + k] = color;
+
+        GLuint a = 4 * q;
+        indices[6 * q] = a;
+        indices[6 * q + 1] = a + 1;
+        indices[6 * q + 2] = a + 2;
+        indices[6 * q + 3] = a;
+        indices[6 * q + 4] = a + 2;
+        indices[6 * q + 5] = a + 3;
+      }
+    });
+
+  _store(out, positions, outColors, normals, uvs, indices);
+}
+
+}
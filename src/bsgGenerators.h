@@ -0,0 +1,84 @@
+#ifndef BSGGENERATORS
+#define BSGGENERATORS
+
+#include "bsg.h"
+
+namespace bsg {
+
+/// \class primitiveGenerator
+/// \brief Makes large numbers of simple shapes at once.
+///
+/// The shapes in the menagerie are one object apiece, which is fine
+/// for a handful of them.  If you want a hundred thousand spheres for
+/// the atoms of a molecule, or a field of glyphs, that's a hundred
+/// thousand draw calls and a lot of time spent building them.  These
+/// functions take arrays of parameters (one entry per shape) and
+/// produce a single indexed GL_TRIANGLES drawableObj containing all
+/// the shapes, so they share one set of buffers and draw in one call.
+///
+/// Each shape is a scaled and moved copy of a unit shape that is
+/// computed once, from tables of sines and cosines, so the per-vertex
+/// work is a multiply and an add.  The output arrays are sized in
+/// advance, and the shapes are divided among several threads, each
+/// writing its own part of the arrays.  The inner loops are simple
+/// enough for the compiler to vectorize.
+///
+/// The color arrays may have either one entry per shape, or a single
+/// entry to use for all of them; any other number throws an
+/// exception.  The data names are the same as for the menagerie
+/// shapes: "position", "color", "normal", and "texture".  Pass zero
+/// threads to use one per processor.
+class primitiveGenerator {
+ public:
+
+  /// \brief Fill in tables of cos and sin for n equal steps around
+  /// a circle.
+  ///
+  /// There are n + 1 entries, so the last is the same as the first.
+  static void circleTable(const int &n,
+                          std::vector<float> &cosines,
+                          std::vector<float> &sines);
+
+  /// \brief Make a lot of spheres.
+  ///
+  /// Each sphere is a vec4 with the center in x, y, z and the radius
+  /// in w.  The tesselation parameters mean the same as for
+  /// drawableSphere.
+  static void spheres(bsgPtr<drawableObj> out,
+                      const std::vector<glm::vec4> &spheres,
+                      const std::vector<glm::vec4> &colors,
+                      const int &phiTesselation,
+                      const int &thetaTesselation,
+                      const int &nThreads = 0);
+
+  /// \brief Make a lot of open cylinders.
+  ///
+  /// Each cylinder runs from a start point to an end point with the
+  /// given radius.  There are no caps, which suits the bonds between
+  /// atoms and other things that run into something at either end.
+  static void cylinders(bsgPtr<drawableObj> out,
+                        const std::vector<glm::vec3> &starts,
+                        const std::vector<glm::vec3> &ends,
+                        const std::vector<float> &radii,
+                        const std::vector<glm::vec4> &colors,
+                        const int &thetaTesselation,
+                        const int &nThreads = 0);
+
+  /// \brief Make a lot of textured rectangles.
+  ///
+  /// These lie in the x-y plane, facing +z, with the lower left corner
+  /// at the given position and the given width and height.  The
+  /// texture coordinates of each are given as (u0, v0, u1, v1), for
+  /// the lower left and upper right corners.  This is what you want
+  /// for a field of glyphs from a texture atlas.
+  static void quads(bsgPtr<drawableObj> out,
+                    const std::vector<glm::vec3> &corners,
+                    const std::vector<glm::vec2> &sizes,
+                    const std::vector<glm::vec4> &texRects,
+                    const std::vector<glm::vec4> &colors,
+                    const int &nThreads = 0);
+};
+
+}
+
+#endif
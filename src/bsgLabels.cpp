@@ -0,0 +1,315 @@
+#include "bsgLabels.h"
+#include "../external/freetype-gl/freetype-gl.h"
+
+namespace bsg {
+
+drawableLabels::drawableLabels(bsgPtr<shaderMgr> pShader,
+                               const std::string &fontFilePath,
+                               const float &pixelHeight,
+                               bsgPtr<fontTextureMgr> texture) :
+  drawableCompound(pShader),
+  _texture(texture),
+  _fontFilePath(fontFilePath),
+  _pixelHeight(pixelHeight),
+  _generation(-1),
+  _needLayout(true),
+  _changed(true),
+  _maxDistance(0.0f),
+  _declutter(true),
+  _nVisible(0),
+  _viewportSizeID(-1) {
+
+  _name = randomName("labels");
+
+  if (!_texture) {
+    _texture = new bsg::fontTextureMgr();
+    _pShader->addTexture(_texture);
+  }
+
+  if (!_texture->getFont(_fontFilePath)) {
+    _texture->readFile(bsg::textureTTF, _fontFilePath);
+  }
+
+  for (int i = 0; i < 4; i++) _lastViewport[i] = 0;
+
+  // All the labels go in here.  The vertex data only changes when
+  // labels are added, but the indices change whenever the view does.
+  _quads = new drawableObj();
+  _quads->setDynamic(true);
+  _quads->setSelectable(false);
+  addObject(_quads);
+}
+
+size_t drawableLabels::addLabel(const glm::vec3 &position,
+                                const std::string &text,
+                                const glm::vec4 &color,
+                                const float &priority) {
+
+  label l;
+  l.position = glm::vec4(position, 1.0f);
+  l.text = text;
+  l.color = color;
+  l.priority = priority;
+  l.firstVertex = 0;
+  l.nVertices = 0;
+  l.halfSize = glm::vec2(0.0f);
+
+  _labels.push_back(l);
+  _needLayout = true;
+
+  return _labels.size() - 1;
+}
+
+void drawableLabels::clearLabels() {
+
+  _labels.clear();
+  _needLayout = true;
+}
+
+// Sorts label numbers by decreasing priority.
+struct _byPriority {
+  const std::vector<float> &priorities;
+  _byPriority(const std::vector<float> &p) : priorities(p) {};
+  bool operator()(const size_t &a, const size_t &b) const {
+    return priorities[a] > priorities[b];
+  };
+};
+
+void drawableLabels::_layout() {
+
+  texture_font_t *font = _texture->getFont(_fontFilePath);
+  float fontSize = _texture->getFontSize();
+
+  // The font is measured in its own pixels, and we want our own.
+  float scale = _pixelHeight / font->height;
+
+  std::vector<glm::vec4> positions, colors, offsets;
+  std::vector<glm::vec2> uvs;
+
+  // As with drawableText, if the atlas starts over partway through,
+  // the glyphs we already have are no good, so go around again.
+  for (int attempt = 0; attempt < 2; attempt++) {
+    _generation = _texture->getGeneration();
+
+    positions.clear();
+    colors.clear();
+    offsets.clear();
+    uvs.clear();
+
+    for (size_t l = 0; l < _labels.size(); l++) {
+      label &lab = _labels[l];
+      lab.firstVertex = offsets.size();
+
+      float penX = 0.0f;
+      float maxHeight = 0.0f;
+      const char *text = lab.text.c_str();
+      const char *previous = NULL;
+
+      for (size_t i = 0; text[i]; i += bsgUtils::utf8Length(&text[i])) {
+        texture_glyph_t *glyph =
+          _texture->getGlyph(_fontFilePath, fontSize, &text[i]);
+        if (!glyph) continue;
+
+        if (previous) penX += _texture->getKerning(glyph, previous);
+        previous = &text[i];
+
+        float x0 = penX + glyph->offset_x;
+        float y0 = (int)glyph->offset_y;
+        float x1 = x0 + glyph->width;
+        float y1 = (int)(y0 - glyph->height);
+
+        if (glyph->width > 0 && glyph->height > 0) {
+          offsets.push_back(glm::vec4(x0, y1, 0.0f, 0.0f));
+          offsets.push_back(glm::vec4(x1, y1, 0.0f, 0.0f));
+          offsets.push_back(glm::vec4(x1, y0, 0.0f, 0.0f));
+          offsets.push_back(glm::vec4(x0, y0, 0.0f, 0.0f));
+
+          uvs.push_back(glm::vec2(glyph->s0, glyph->t1));
+          uvs.push_back(glm::vec2(glyph->s1, glyph->t1));
+          uvs.push_back(glm::vec2(glyph->s1, glyph->t0));
+          uvs.push_back(glm::vec2(glyph->s0, glyph->t0));
+        }
+
+        penX += glyph->advance_x;
+        if (maxHeight < glyph->height) maxHeight = glyph->height;
+      }
+
+      lab.nVertices = offsets.size() - lab.firstVertex;
+      lab.halfSize = 0.5f * scale * glm::vec2(penX, maxHeight);
+
+      // Center the label on its point, in screen pixels.
+      glm::vec4 center = glm::vec4(penX / 2, maxHeight / 2, 0.0f, 0.0f);
+      for (size_t v = lab.firstVertex; v < offsets.size(); v++)
+        offsets[v] = scale * (offsets[v] - center);
+
+      positions.resize(offsets.size(), lab.position);
+      colors.resize(offsets.size(), lab.color);
+    }
+
+    if (_generation == _texture->getGeneration()) break;
+  }
+
+  // The offsets ride along in the normal attribute.
+  _quads->swapData(GLDATA_VERTICES, "position", positions);
+  _quads->swapData(GLDATA_COLORS, "color", colors);
+  _quads->swapData(GLDATA_NORMALS, "normal", offsets);
+  _quads->swapData(GLDATA_TEXCOORDS, "texture", uvs);
+  _quads->setDrawType(GL_TRIANGLES);
+  _quads->findBoundingBox();
+
+  std::vector<float> priorities(_labels.size());
+  _order.resize(_labels.size());
+  for (size_t l = 0; l < _labels.size(); l++) {
+    priorities[l] = _labels[l].priority;
+    _order[l] = l;
+  }
+  std::stable_sort(_order.begin(), _order.end(), _byPriority(priorities));
+
+  // Nothing is known to be visible until the next cull.
+  _indices.clear();
+  _quads->setIndices(_indices);
+  _nVisible = 0;
+
+  _needLayout = false;
+  _changed = true;
+}
+
+void drawableLabels::_cull(const glm::mat4 &viewMatrix,
+                           const glm::mat4 &projMatrix) {
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  float width = viewport[2];
+  float height = viewport[3];
+
+  glm::mat4 modelView = viewMatrix * _totalModelMatrix;
+  glm::mat4 matrix = projMatrix * modelView;
+
+  // If nothing has moved, the answer is the same as last time.
+  if (!_changed && matrix == _lastMatrix &&
+      viewport[2] == _lastViewport[2] && viewport[3] == _lastViewport[3])
+    return;
+
+  _changed = false;
+  _lastMatrix = matrix;
+  for (int i = 0; i < 4; i++) _lastViewport[i] = viewport[i];
+
+  // The grid cells are a few label heights on a side, so a label
+  // only lands in a handful of them.
+  float cellSize = std::max(4.0f * _pixelHeight, 16.0f);
+  int nx = (int)ceil(width / cellSize);
+  int ny = (int)ceil(height / cellSize);
+  if (_declutter) {
+    _grid.resize(nx * ny);
+    for (size_t c = 0; c < _grid.size(); c++) _grid[c].clear();
+  }
+  _placed.clear();
+  _newIndices.clear();
+
+  for (size_t o = 0; o < _order.size(); o++) {
+    const label &lab = _labels[_order[o]];
+    if (lab.nVertices == 0) continue;
+
+    glm::vec4 eye = modelView * lab.position;
+    if (_maxDistance > 0.0f && glm::length(glm::vec3(eye)) > _maxDistance)
+      continue;
+
+    // Behind the viewer, or past the far plane?
+    glm::vec4 clip = projMatrix * eye;
+    if (clip.w <= 0.0f || clip.z > clip.w) continue;
+
+    // Where on the screen, in pixels, and is any of it showing?
+    float sx = (0.5f * clip.x / clip.w + 0.5f) * width;
+    float sy = (0.5f * clip.y / clip.w + 0.5f) * height;
+    glm::vec4 rect = glm::vec4(sx - lab.halfSize.x, sy - lab.halfSize.y,
+                               sx + lab.halfSize.x, sy + lab.halfSize.y);
+    if (rect.z < 0.0f || rect.x > width || rect.w < 0.0f || rect.y > height)
+      continue;
+
+    if (_declutter) {
+      int cx0 = std::max(0, (int)(rect.x / cellSize));
+      int cy0 = std::max(0, (int)(rect.y / cellSize));
+      int cx1 = std::min(nx - 1, (int)(rect.z / cellSize));
+      int cy1 = std::min(ny - 1, (int)(rect.w / cellSize));
+
+      // Does it overlap anything placed already?
+      bool overlap = false;
+      for (int cy = cy0; cy <= cy1 && !overlap; cy++) {
+        for (int cx = cx0; cx <= cx1 && !overlap; cx++) {
+          const std::vector<size_t> &cell = _grid[cy * nx + cx];
+          for (size_t k = 0; k < cell.size(); k++) {
+            const glm::vec4 &p = _placed[cell[k]];
+            if (rect.x < p.z && p.x < rect.z && rect.y < p.w && p.y < rect.w) {
+              overlap = true;
+              break;
+            }
+          }
+        }
+      }
+      if (overlap) continue;
+
+      for (int cy = cy0; cy <= cy1; cy++)
+        for (int cx = cx0; cx <= cx1; cx++)
+          _grid[cy * nx + cx].push_back(_placed.size());
+    }
+    _placed.push_back(rect);
+
+    // Two triangles for each of the label's quads.
+    for (GLuint q = lab.firstVertex; q < lab.firstVertex + lab.nVertices; q += 4) {
+      _newIndices.push_back(q);
+      _newIndices.push_back(q + 1);
+      _newIndices.push_back(q + 2);
+      _newIndices.push_back(q);
+      _newIndices.push_back(q + 2);
+      _newIndices.push_back(q + 3);
+    }
+  }
+
+  _nVisible = _placed.size();
+
+  // Only bother the GPU if something appeared or disappeared.
+  if (_newIndices != _indices) {
+    _indices.swap(_newIndices);
+    _quads->setIndices(_indices);
+  }
+}
+
+void drawableLabels::prepare() {
+
+  if (_needLayout || _generation != _texture->getGeneration()) _layout();
+  drawableCompound::prepare();
+
+  // This is also called again for each new variant of the shader.
+  _viewportSizeID = _pShader->getUniformID("viewportSize");
+}
+
+void drawableLabels::load() {
+
+  // New labels, or a font atlas that has started over.
+  if (_needLayout || _generation != _texture->getGeneration()) _layout();
+
+  drawableCompound::load();
+}
+
+void drawableLabels::draw(const glm::mat4 &viewMatrix,
+                          const glm::mat4 &projMatrix) {
+
+  if (!_ready()) return;
+
+  _drawUniforms(viewMatrix, projMatrix);
+
+  _cull(viewMatrix, projMatrix);
+  if (_nVisible == 0) return;
+
+  // The culling can only happen once we know the view, so the new
+  // indices, if any, go to the GPU here instead of in load().
+  _quads->load();
+
+  drawStats::counts.uniformUploads++;
+  glUniform2f(_viewportSizeID,
+              (float)_lastViewport[2], (float)_lastViewport[3]);
+
+  _drawObjects(_objects);
+}
+
+}
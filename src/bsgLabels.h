@@ -0,0 +1,130 @@
+#ifndef BSGLABELS
+#define BSGLABELS
+
+#include "bsg.h"
+
+namespace bsg {
+
+/// \class drawableLabels
+/// \brief A large number of text labels, attached to points in space.
+///
+/// A drawableText is a whole compound object, with its own matrices
+/// and uniforms and a draw call of its own, which is fine for a title
+/// or a button but not for labeling every atom of a molecule.  This
+/// object holds any number of labels in one set of buffers, drawn in
+/// one call.
+///
+/// The labels are billboards: each is a line of text that always
+/// faces the viewer and is the same size on the screen however far
+/// away its point is.  That's done in the vertex shader, so use
+/// shaders/labelShader.vp and shaders/labelShader.fp with these.
+///
+/// Every frame, before drawing, the labels are culled.  A label is
+/// hidden if its point is behind the viewer, if it is off the
+/// screen, or if it is farther away than the maximum distance (if
+/// there is one).  Then, if decluttering is on, the survivors are
+/// placed on the screen in order of priority, and any label that
+/// would overlap one already placed is hidden, too.  A grid over the
+/// screen keeps that from comparing every label with every other.
+/// Only the indices of the visible labels are sent to the GPU, and
+/// only when the set of them changes.
+class drawableLabels : public drawableCompound {
+ private:
+
+  struct label {
+    glm::vec4 position;
+    std::string text;
+    glm::vec4 color;
+    float priority;
+
+    // The label's quads are these vertices of the buffer, and this
+    // is half its size on the screen, in pixels.
+    GLuint firstVertex;
+    GLuint nVertices;
+    glm::vec2 halfSize;
+  };
+  std::vector<label> _labels;
+
+  // The label numbers, in order of decreasing priority.
+  std::vector<size_t> _order;
+
+  bsgPtr<fontTextureMgr> _texture;
+  std::string _fontFilePath;
+  float _pixelHeight;
+  int _generation;
+
+  bsgPtr<drawableObj> _quads;
+
+  // The labels have to be laid out again, or just culled again.
+  bool _needLayout;
+  bool _changed;
+
+  float _maxDistance;
+  bool _declutter;
+
+  // What was visible last time, and the scratch space for working
+  // it out again.
+  std::vector<GLuint> _indices;
+  std::vector<GLuint> _newIndices;
+  size_t _nVisible;
+  std::vector<std::vector<size_t> > _grid;
+  std::vector<glm::vec4> _placed;
+  glm::mat4 _lastMatrix;
+  GLint _lastViewport[4];
+
+  // The shader's viewportSize uniform, found in prepare().
+  GLint _viewportSizeID;
+
+  void _layout();
+  void _cull(const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix);
+
+ public:
+  /// \brief Make an empty set of labels.
+  ///
+  /// The labels will be the given height, in pixels.  As with
+  /// drawableText, if you pass in no font texture, one is made, and
+  /// you can get it from getFontTexture() to share with others.
+  drawableLabels(bsgPtr<shaderMgr> pShader,
+                 const std::string &fontFilePath,
+                 const float &pixelHeight = 16.0f,
+                 bsgPtr<fontTextureMgr> texture = NULL);
+
+  /// \brief Add a label at a point.
+  ///
+  /// The text is UTF-8.  Where labels overlap, the one with the
+  /// higher priority is shown.  Returns the number of the label.
+  size_t addLabel(const glm::vec3 &position,
+                  const std::string &text,
+                  const glm::vec4 &color = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f),
+                  const float &priority = 0.0f);
+
+  /// \brief Remove all the labels.
+  void clearLabels();
+
+  /// \brief How many labels there are.
+  size_t getNumLabels() { return _labels.size(); };
+
+  /// \brief How many labels were visible at the last draw.
+  size_t getNumVisible() { return _nVisible; };
+
+  /// \brief Hide labels farther than this from the viewer.
+  ///
+  /// The distance is in world units.  Zero, the default, means
+  /// there is no limit.
+  void setMaxDistance(const float &maxDistance) {
+    _maxDistance = maxDistance; _changed = true; };
+
+  /// \brief Turn the hiding of overlapping labels on or off.
+  void setDeclutter(const bool &declutter) {
+    _declutter = declutter; _changed = true; };
+
+  bsgPtr<fontTextureMgr> getFontTexture() { return _texture; };
+
+  void prepare();
+  void load();
+  void draw(const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix);
+};
+
+}
+
+#endif
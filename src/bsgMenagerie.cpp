@@ -1,4 +1,5 @@
 #include "bsgMenagerie.h"
+#include "bsgGenerators.h"
 #include "../external/freetype-gl/freetype-gl.h"
 
 namespace bsg {
@@ -10,6 +11,10 @@ namespace bsg {
 
     _name = randomName("rect");
 
+    // The back of the rectangle is drawn by the same triangles as the
+    // front, see drawableCompound::setTwoSided().
+    setTwoSided(true);
+
     float w = _width/2.0f;
     float h = _height/2.0f;
     float wdiv = _width / nDivs;
@@ -20,15 +25,10 @@ namespace bsg {
     std::vector<glm::vec4> frontFaceColors = std::vector<glm::vec4>(nEntries);
     std::vector<glm::vec4> frontFaceNormals = std::vector<glm::vec4>(nEntries);
     std::vector<glm::vec2> frontFaceUVs = std::vector<glm::vec2>(nEntries);
-    std::vector<glm::vec4> backFaceVertices = std::vector<glm::vec4>(nEntries);
-    std::vector<glm::vec4> backFaceColors = std::vector<glm::vec4>(nEntries);
-    std::vector<glm::vec4> backFaceNormals = std::vector<glm::vec4>(nEntries);
-    std::vector<glm::vec2> backFaceUVs = std::vector<glm::vec2>(nEntries);
 
     for (int j = 0; j < nDivs; j++) {
 
       _frontFace = new drawableObj();
-      _backFace = new drawableObj();
 
       for (int i = 0; i <= nDivs; i++) {
 
@@ -45,20 +45,6 @@ namespace bsg {
                                     0.0 + (i * 1.0/nDivs));
         frontFaceUVs[k + 1] = glm::vec2(((j + 1) * 1.0/nDivs),
                                         0.0 + (i * 1.0/nDivs));
-
-        backFaceVertices[k] = glm::vec4(-w + ((j + 1) * wdiv),
-                                        -h + (i * hdiv), 0.0f, 1.0f);
-        backFaceVertices[k + 1] = glm::vec4(-w + (j * wdiv),
-                                            -h + (i * hdiv), 0.0f, 1.0f);
-        backFaceColors[k] = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
-        backFaceColors[k + 1] = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
-        backFaceNormals[k] = glm::vec4(0.0f, 0.0f,-1.0f, 0.0f);
-        backFaceNormals[k + 1] = glm::vec4(0.0f, 0.0f,-1.0f, 0.0f);
-        backFaceUVs[k] = glm::vec2(((j + 1) * 1.0/nDivs),
-                                   0.0 + (i * 1.0/nDivs));
-        backFaceUVs[k + 1] = glm::vec2(0.0 + (j * 1.0/nDivs),
-                                       0.0 + (i * 1.0/nDivs));
-
       }
 
       _frontFace->addData(bsg::GLDATA_VERTICES, "position", frontFaceVertices);
@@ -67,14 +53,7 @@ namespace bsg {
       _frontFace->addData(bsg::GLDATA_TEXCOORDS, "texture", frontFaceUVs);
       _frontFace->setDrawType(GL_TRIANGLE_STRIP, frontFaceVertices.size());
 
-      _backFace->addData(bsg::GLDATA_VERTICES, "position", backFaceVertices);
-      _backFace->addData(bsg::GLDATA_COLORS, "color", backFaceColors);
-      _backFace->addData(bsg::GLDATA_NORMALS, "normal", backFaceNormals);
-      _backFace->addData(bsg::GLDATA_TEXCOORDS, "texture", backFaceUVs);
-      _backFace->setDrawType(GL_TRIANGLE_STRIP, backFaceVertices.size());
-
       addObject(_frontFace);
-      addObject(_backFace);
     }
   }
 
@@ -85,7 +64,9 @@ namespace bsg {
 
     _name = randomName("rect");
     _frontFace = new drawableObj();
-    _backFace = new drawableObj();
+
+    // One set of triangles does for both sides.
+    setTwoSided(true);
 
     std::vector<glm::vec4> frontFaceVertices;
 
@@ -143,56 +124,7 @@ namespace bsg {
     // The vertices above are arranged into a set of triangles.
     _frontFace->setDrawType(GL_TRIANGLE_STRIP);
 
-    // Same thing for the other rectangle.
-    std::vector<glm::vec4> backFaceVertices;
-
-    backFaceVertices.push_back(glm::vec4( -w, -h, 0.0f, 1.0f));
-    backFaceVertices.push_back(glm::vec4( -w,  h, 0.0f, 1.0f));
-    backFaceVertices.push_back(glm::vec4(  w, -h, 0.0f, 1.0f));
-    backFaceVertices.push_back(glm::vec4(  w,  h, 0.0f, 1.0f));
-
-    _backFace->addData(bsg::GLDATA_VERTICES, "position", backFaceVertices);
-
-    // And the corresponding colors for the above vertices.
-    std::vector<glm::vec4> backFaceColors;
-
-    if (color == glm::vec4(0, 0, 0, 0)) {
-      backFaceColors.push_back(glm::vec4( 1.0f, 1.0f, 1.0f, 1.0f));
-      backFaceColors.push_back(glm::vec4( 0.0f, 1.0f, 0.0f, 1.0f));
-      backFaceColors.push_back(glm::vec4( 1.0f, 0.0f, 0.0f, 1.0f));
-      backFaceColors.push_back(glm::vec4( 0.0f, 0.0f, 1.0f, 1.0f));
-    } else {
-      backFaceColors.push_back(color);
-      backFaceColors.push_back(color);
-      backFaceColors.push_back(color);
-      backFaceColors.push_back(color);
-    }
-
-    _backFace->addData(bsg::GLDATA_COLORS, "color", backFaceColors);
-
-    std::vector<glm::vec4> backFaceNormals;
-
-    backFaceNormals.push_back(glm::vec4( 0.0f, 0.0f,-1.0f, 0.0f));
-    backFaceNormals.push_back(glm::vec4( 0.0f, 0.0f,-1.0f, 0.0f));
-    backFaceNormals.push_back(glm::vec4( 0.0f, 0.0f,-1.0f, 0.0f));
-    backFaceNormals.push_back(glm::vec4( 0.0f, 0.0f,-1.0f, 0.0f));
-
-    _backFace->addData(bsg::GLDATA_NORMALS, "normal", backFaceNormals);
-
-    std::vector<glm::vec2> backFaceUVs;
-
-    backFaceUVs.push_back(glm::vec2( 0.0f, 0.0f));
-    backFaceUVs.push_back(glm::vec2( 0.0f, 1.0f));
-    backFaceUVs.push_back(glm::vec2( 1.0f, 0.0f));
-    backFaceUVs.push_back(glm::vec2( 1.0f, 1.0f));
-
-    _backFace->addData(bsg::GLDATA_TEXCOORDS, "texture", backFaceUVs);
-
-    // The vertices above are arranged into a set of triangles.
-    _backFace->setDrawType(GL_TRIANGLE_STRIP);
-
     addObject(_frontFace);
-    addObject(_backFace);
   }
 
   drawableRectangleOutline::drawableRectangleOutline(bsgPtr<shaderMgr> pShader,
@@ -204,7 +136,9 @@ namespace bsg {
 
     _name = randomName("rect");
     _frontFace = new drawableObj();
-    _backFace = new drawableObj();
+
+    // Visible from behind, too, without a second copy.
+    setTwoSided(true);
 
     float w = _width/2.0f;
     float h = _height/2.0f;
@@ -245,144 +179,203 @@ namespace bsg {
     // The vertices above are arranged into a set of triangles.
     _frontFace->setDrawType(GL_TRIANGLE_STRIP);
 
-    std::vector<glm::vec4> backFaceVertices;
+    addObject(_frontFace);
+  }
 
-    backFaceVertices.push_back(glm::vec4(w+s,-h-s, 0.0f, 1.0f));
-    backFaceVertices.push_back(glm::vec4(w,    -h, 0.0f, 1.0f));
-    backFaceVertices.push_back(glm::vec4(w+s, h+s, 0.0f, 1.0f));
-    backFaceVertices.push_back(glm::vec4(w,     h, 0.0f, 1.0f));
-    backFaceVertices.push_back(glm::vec4(-w-s,  h+s, 0.0f, 1.0f));
-    backFaceVertices.push_back(glm::vec4(-w,      h, 0.0f, 1.0f));
-    backFaceVertices.push_back(glm::vec4(-w-s, -h-s, 0.0f, 1.0f));
-    backFaceVertices.push_back(glm::vec4(-w,     -h, 0.0f, 1.0f));
-    backFaceVertices.push_back(glm::vec4(w+s,-h-s, 0.0f, 1.0f));
-    backFaceVertices.push_back(glm::vec4(w,    -h, 0.0f, 1.0f));
 
-    _backFace->addData(bsg::GLDATA_VERTICES, "position", backFaceVertices);
+  drawableTessellated::drawableTessellated(bsgPtr<shaderMgr> pShader,
+                                           const glm::vec4 &color) :
+    drawableCompound(pShader), _color(color), _radius(0.5f),
+    _tolerance(0.5f), _current(0) {}
 
-    // Here are the corresponding colors for the above vertices.
-    _backFace->addData(bsg::GLDATA_COLORS, "color", frontFaceColors);
+  void drawableTessellated::_initLevels(const int &segments, const float &radius) {
 
-    std::vector<glm::vec4> backFaceNormals;
+    _radius = radius;
 
-    for (int i=0; i<10; i++) {
-      backFaceNormals.push_back(glm::vec4( 0.0f, 0.0f, -1.0f, 0.0f));
+    // Two coarser levels and two finer ones, each step doubling the
+    // number of segments.  Very small numbers aren't useful.
+    for (int i = -2; i <= 2; i++) {
+      int n = (i < 0) ? segments >> -i : segments << i;
+      if (n < 3 && i != 0) continue;
+      if (i == 0) _current = _levelSegments.size();
+      _levelSegments.push_back(n);
     }
+    _levels.resize(_levelSegments.size());
 
-    _backFace->addData(bsg::GLDATA_NORMALS, "normal", backFaceNormals);
+    // The level asked for is built now, and is the one that gets
+    // prepared and loaded with the rest of the scene.
+    _makeLevel(segments, _levels[_current]);
+    _objects = _levels[_current];
+  }
 
-    // The vertices above are arranged into a set of triangles.
-    _backFace->setDrawType(GL_TRIANGLE_STRIP);
+  void drawableTessellated::prepare() {
 
-    addObject(_frontFace);
-    addObject(_backFace);
+    if (!_pShader->isReady()) return;
+
+    _prepareUniforms();
+
+    for (size_t i = 0; i < _levels.size(); i++) {
+      for (DrawableObjList::iterator it = _levels[i].begin();
+           it != _levels[i].end(); it++) {
+        (*it)->prepare(_pShader->getProgram());
+      }
+    }
   }
 
+  void drawableTessellated::draw(const glm::mat4 &viewMatrix,
+                                 const glm::mat4 &projMatrix) {
+
+    if (!_ready()) return;
+
+    // A circle of radius r drawn with n segments is off by about
+    // r * (pi/n)^2 / 2 at the middle of each segment.  Work out the
+    // number of segments that keeps this under the tolerance.
+    float pixels = _radius *
+      bsgUtils::pixelsPerUnit(_totalModelMatrix, glm::vec3(0.0f),
+                              viewMatrix, projMatrix);
+    float needed = (float)(M_PI * sqrt(pixels / (2.0f * _tolerance)));
+
+    size_t choice = _levelSegments.size() - 1;
+    for (size_t i = 0; i < _levelSegments.size(); i++) {
+      if ((float)_levelSegments[i] >= needed) {
+        choice = i;
+        break;
+      }
+    }
+
+    if (_levels[choice].empty()) {
+      _makeLevel(_levelSegments[choice], _levels[choice]);
+
+      for (DrawableObjList::iterator it = _levels[choice].begin();
+           it != _levels[choice].end(); it++) {
+        (*it)->prepare(_pShader->getProgram());
+        (*it)->load();
+      }
+    }
+    _current = choice;
+
+    _drawUniforms(viewMatrix, projMatrix);
+    _drawObjects(_levels[_current]);
+  }
 
   drawableSphere::drawableSphere(bsgPtr<shaderMgr> pShader,
                                        const int &phiTesselation, const int &thetaTesselation, const glm::vec4 &color) :
-    drawableCompound(pShader), _phi(phiTesselation), _theta(thetaTesselation) {
+    drawableTessellated(pShader, color), _phi(phiTesselation), _theta(thetaTesselation) {
 
     _name = randomName("sphere");
 
+    _initLevels(thetaTesselation, 0.5f);
+  }
+
+  void drawableSphere::_makeLevel(const int &segments, DrawableObjList &objects) {
+
+    // Keep the proportion of latitude to longitude divisions.
+    int phi = std::max(2, (int)(_phi * segments / _theta + 0.5f));
+
+    bsgPtr<drawableObj> sphere = new drawableObj();
+    getSphere(sphere, phi, segments, _color);
+    objects.push_back(sphere);
+  }
+
+  void drawableSphere::getSphere(bsgPtr<drawableObj> sphere, const int &phiTesselation, const int &thetaTesselation, const glm::vec4 &color) {
+
     float pi = 3.14159265358979323;
     float r = 0.5;
-    float thetaStep = 2 * pi/_theta;
-    float phiStep = pi/_phi;
+    float phiStep = pi/phiTesselation;
+
+    // The sines and cosines are looked up, not recalculated for every
+    // vertex.  The sphere goes around clockwise, seen from above, so
+    // we use -sin for sin(-angle).
+    std::vector<float> cosTheta, sinTheta;
+    primitiveGenerator::circleTable(thetaTesselation, cosTheta, sinTheta);
+
+    std::vector<float> cosPhi(phiTesselation + 1), sinPhi(phiTesselation + 1);
+    for (int j = 0; j <= phiTesselation; j++) {
+      cosPhi[j] = std::cos(phiStep * j);
+      sinPhi[j] = std::sin(phiStep * j);
+    }
 
-    std::vector<glm::vec4> verts(0);
-    std::vector<glm::vec2> uvs(0);
-    std::vector<glm::vec4> normals(0);
-    std::vector<glm::vec4> colors(0);
+    int nVerts = 2 * phiTesselation * (thetaTesselation + 1);
+    std::vector<glm::vec4> verts;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec4> normals;
+    std::vector<glm::vec4> colors(nVerts, color);
+    verts.reserve(nVerts);
+    uvs.reserve(nVerts);
+    normals.reserve(nVerts);
 
     // Uses a triangle strip to draw the sphere, so two vertices are defined at a time and are automatically turned into
     // a strip of triangles. (the / in |/|/|.../| are automatically filled in.)
-    for (int j = 0; j < _phi; j++) {
-        for (int i = 0; i < (_theta + 1); i++) {
-            // Top vertex position
-            verts.push_back(glm::vec4(r * std::sin(phiStep * j) * std::cos(-thetaStep * i), r * std::cos(phiStep * j),
-              r * std::sin(phiStep * j) * std::sin(-thetaStep * i), 1.0f));
-
-            // Top vertex normal
-            glm::vec4 normal = glm::vec4(r * std::sin(phiStep * j) * std::cos(-thetaStep * i),
-                                         r * std::cos(phiStep * j),
-                                         r * std::sin(phiStep * j) * std::sin(-thetaStep * i), 0.0f);
-
-            normal = glm::normalize(normal);
+    for (int j = 0; j < phiTesselation; j++) {
+        for (int i = 0; i < (thetaTesselation + 1); i++) {
+            // The normal of a point on a sphere is the unit vector
+            // pointing at it, so there is nothing to normalize.
+            glm::vec4 normal = glm::vec4(sinPhi[j] * cosTheta[i], cosPhi[j],
+                                         -sinPhi[j] * sinTheta[i], 0.0f);
+
+            // Top vertex position and normal
+            verts.push_back(glm::vec4(r * glm::vec3(normal), 1.0f));
             normals.push_back(normal);
 
             // Top UV
             uvs.push_back(glm::vec2(static_cast<float>(i)/thetaTesselation, 1.0f - static_cast<float>(j)/phiTesselation));
 
-            // Bottom vertex position
-            verts.push_back(glm::vec4(r * std::sin(phiStep * (j + 1)) * std::cos(-thetaStep * i), r * std::cos(phiStep * (j + 1)),
-              r * std::sin(phiStep * (j + 1)) * std::sin(-thetaStep * i), 1.0f));
-
-            // Bottom vertex normal
-            normal = glm::vec4(r * std::sin(phiStep * (j + 1)) * std::cos(-thetaStep * i),
-                                r * std::cos(phiStep * (j + 1)),
-                                r * std::sin(phiStep * (j + 1)) * std::sin(-thetaStep * i), 0.0f);
-            normal = normalize(normal);
+            // Bottom vertex position and normal
+            normal = glm::vec4(sinPhi[j + 1] * cosTheta[i], cosPhi[j + 1],
+                               -sinPhi[j + 1] * sinTheta[i], 0.0f);
+            verts.push_back(glm::vec4(r * glm::vec3(normal), 1.0f));
             normals.push_back(normal);
 
-
             // Bottom UV
             uvs.push_back(glm::vec2(static_cast<float>(i)/thetaTesselation, 1.0f - static_cast<float>(j + 1)/phiTesselation));
-
-            // float c1 = ((double) rand() / (RAND_MAX));
-            // float c2 = ((double) rand() / (RAND_MAX));
-            // float c3 = ((double) rand() / (RAND_MAX));
-            // float c4 = ((double) rand() / (RAND_MAX));
-            // float c5 = ((double) rand() / (RAND_MAX));
-            // float c6 = ((double) rand() / (RAND_MAX));
-            // glm::vec4 randColor = glm::vec4(c1, c2, c3, 1.0f);
-            // glm::vec4 randColor2 = glm::vec4(c4, c5, c6, 1.0f);
-
-            // Color
-            colors.push_back(color);
-            colors.push_back(color);
         }
     }
 
+    sphere->addData(bsg::GLDATA_VERTICES, "position", verts);
 
+    sphere->addData(bsg::GLDATA_COLORS, "color", colors);
 
-    _sphere = new drawableObj();
-
-    _sphere->addData(bsg::GLDATA_VERTICES, "position", verts);
-
-    _sphere->addData(bsg::GLDATA_COLORS, "color", colors);
+    sphere->addData(bsg::GLDATA_NORMALS, "normal", normals);
 
-    _sphere->addData(bsg::GLDATA_NORMALS, "normal", normals);
-
-    _sphere->addData(bsg::GLDATA_TEXCOORDS, "texture", uvs);
+    sphere->addData(bsg::GLDATA_TEXCOORDS, "texture", uvs);
 
     // The vertices above are arranged into a set of triangles.
-    _sphere->setDrawType(GL_TRIANGLE_STRIP, verts.size());
-
-    addObject(_sphere);
+    sphere->setDrawType(GL_TRIANGLE_STRIP, verts.size());
   }
 
   drawableCircle::drawableCircle(bsgPtr<shaderMgr> pShader, const int &thetaTesselation, const float &normalDirection, const float &yPos) :
-    drawableCompound(pShader), _theta(thetaTesselation) {
+    drawableTessellated(pShader, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f)),
+    _theta(thetaTesselation), _normalDirection(normalDirection), _yPos(yPos) {
       _name = randomName("circle");
-      glm::vec4 color = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
-      _circle = new drawableObj();
-      getCircle(_circle, _theta, normalDirection, yPos, color);
-      addObject(_circle);
+      _initLevels(thetaTesselation, sqrt(0.25f + yPos * yPos));
     }
 
+  void drawableCircle::_makeLevel(const int &segments, DrawableObjList &objects) {
+
+    bsgPtr<drawableObj> circle = new drawableObj();
+    getCircle(circle, segments, _normalDirection, _yPos, _color);
+    objects.push_back(circle);
+  }
+
   // Useful function for creating the caps for the cylinder and the bottom of the cone.
   void drawableCircle::getCircle(bsgPtr<drawableObj> circle, const int &thetaTesselation, const float &normalDirection, const float &yPos, const glm::vec4 &color) {
 
 
-      std::vector<glm::vec4> verts(0);
-      std::vector<glm::vec2> uvs(0);
-      std::vector<glm::vec4> normals(0);
-      std::vector<glm::vec4> colors(0);
-
-      float pi = 3.14159265358979323;
       float r = 0.5f;
-      float thetaStep = 2 * pi/thetaTesselation;
+
+      // The normal direction is +1 or -1, which decides which way
+      // around we go, so that cos(-dir * angle) is cos(angle) and
+      // sin(-dir * angle) is -dir * sin(angle).
+      std::vector<float> cosTheta, sinTheta;
+      primitiveGenerator::circleTable(thetaTesselation, cosTheta, sinTheta);
+
+      int nVerts = thetaTesselation + 2;
+      std::vector<glm::vec4> verts;
+      std::vector<glm::vec2> uvs;
+      std::vector<glm::vec4> normals(nVerts, glm::vec4(0.0f, normalDirection, 0.0f, 0.0f));
+      std::vector<glm::vec4> colors(nVerts, color);
+      verts.reserve(nVerts);
+      uvs.reserve(nVerts);
 
       // Uses a triangle fan to draw the circle, so the central point is defined, followed by points
       // around the perimiter of the circle. This could have been done with a strip, but that would mean
@@ -391,29 +384,15 @@ namespace bsg {
       // Top vertex position
       verts.push_back(glm::vec4(0.0f, yPos, 0.0f, 1.0f));
 
-      // Top vertex normal
-      glm::vec4 normal = glm::vec4(0.0f, normalDirection, 0.0f, 0.0f);
-      normalize(normal);
-      normals.push_back(normal);
-
       // Top UV
       uvs.push_back(glm::vec2(0.5f, 0.5f));
 
-      colors.push_back(color);
-
       for (int j = 0; j < (thetaTesselation + 1); j++) {
 
-          verts.push_back(glm::vec4(r * glm::cos(-normalDirection * thetaStep*j), yPos,
-            r * glm::sin(-normalDirection * thetaStep*j), 1.0f));
-
-          normal = glm::vec4(0.0f, normalDirection, 0.0f, 0.0f);
-          normalize(normal);
-          normals.push_back(normal);
+          verts.push_back(glm::vec4(r * cosTheta[j], yPos,
+            -normalDirection * r * sinTheta[j], 1.0f));
 
-          uvs.push_back(glm::vec2(r * glm::cos(thetaStep*j) + 0.5f, r * glm::sin(thetaStep*j) + 0.5f));
-
-          // Color
-          colors.push_back(color);
+          uvs.push_back(glm::vec2(r * cosTheta[j] + 0.5f, r * sinTheta[j] + 0.5f));
       }
       circle->addData(bsg::GLDATA_VERTICES, "position", verts);
 
@@ -440,17 +419,20 @@ namespace bsg {
   void drawableSquare::getRect(bsgPtr<drawableObj> rect, const int &tesselation, const glm::vec3 &topLeft, const glm::vec3 &topRight, const glm::vec3 &bottomLeft, const glm::vec4 &color) {
 
 
-      std::vector<glm::vec4> verts(0);
-      std::vector<glm::vec2> uvs(0);
-      std::vector<glm::vec4> normals(0);
-      std::vector<glm::vec4> colors(0);
-
       glm::vec3 horizontal = (topRight - topLeft) * (1.0f / tesselation);
       glm::vec3 vertical = (bottomLeft - topLeft) * (1.0f / tesselation);
 
-      glm::vec3 n = glm::cross(horizontal, vertical);
-      glm::vec4 normal = glm::vec4(n, 0.0f);
-      glm::normalize(normal);
+      // The normal is the same everywhere, so it only needs to be
+      // normalized once.
+      glm::vec4 normal = glm::vec4(glm::normalize(glm::cross(horizontal, vertical)), 0.0f);
+
+      int nVerts = 2 * tesselation * (tesselation + 1);
+      std::vector<glm::vec4> verts;
+      std::vector<glm::vec2> uvs;
+      std::vector<glm::vec4> normals(nVerts, normal);
+      std::vector<glm::vec4> colors(nVerts, color);
+      verts.reserve(nVerts);
+      uvs.reserve(nVerts);
 
       for (int i = 0; i < tesselation; ++i) {
         for (int j = 0; j <= tesselation; ++j) {
@@ -461,14 +443,8 @@ namespace bsg {
           verts.push_back(glm::vec4(currPos, 1.0f));
           verts.push_back(glm::vec4(v, 1.0f));
 
-          normals.push_back(normal);
-          normals.push_back(normal);
-
           uvs.push_back(glm::vec2(static_cast<float>(j)/tesselation, 1.0f - static_cast<float>(i)/tesselation));
           uvs.push_back(glm::vec2(static_cast<float>(j)/tesselation, 1.0f - static_cast<float>(i + 1)/tesselation));
-
-          colors.push_back(color);
-          colors.push_back(color);
         }
       }
 
@@ -515,146 +491,165 @@ namespace bsg {
 
   drawableCone::drawableCone(bsgPtr<shaderMgr> pShader,
                                        const int &heightTesselation, const int &thetaTesselation, const glm::vec4 &color) :
-    drawableCompound(pShader), _height(heightTesselation), _theta(thetaTesselation) {
+    drawableTessellated(pShader, color), _height(heightTesselation), _theta(thetaTesselation) {
 
     _name = randomName("cone");
 
-    _cap = new drawableObj();
-    _base = new drawableObj();
+    // The apex is the farthest point from the origin.
+    _initLevels(thetaTesselation, 0.75f);
+  }
+
+  void drawableCone::_makeLevel(const int &segments, DrawableObjList &objects) {
+
+    bsgPtr<drawableObj> cap = new drawableObj();
+    bsgPtr<drawableObj> base = new drawableObj();
+
+    getCone(cap, _height, segments, _color);
+    drawableCircle::getCircle(base, segments, -1, -0.25f, _color);
+
+    objects.push_back(cap);
+    objects.push_back(base);
+  }
+
+  void drawableCone::getCone(bsgPtr<drawableObj> cone, const int &heightTesselation, const int &thetaTesselation, const glm::vec4 &color) {
 
     float radius = 0.5;
     float height = 0.5;
 
-
-    float pi = 3.14159265358979323;
-    float thetaStep = 2 * pi/thetaTesselation;
     float heightStep = 2 * height/heightTesselation;
 
-    std::vector<glm::vec4> verts(0);
-    std::vector<glm::vec2> uvs(0);
-    std::vector<glm::vec4> normals(0);
-    std::vector<glm::vec4> colors(0);
+    std::vector<float> cosTheta, sinTheta;
+    primitiveGenerator::circleTable(thetaTesselation, cosTheta, sinTheta);
 
+    // The side of the cone slopes at 2:1, so the normal is
+    // (2 cos, 1, 2 sin)/sqrt(5) all the way up.
+    float a = 2.0f / std::sqrt(5.0f);
+    float b = 1.0f / std::sqrt(5.0f);
 
+    int nVerts = 2 * heightTesselation * (thetaTesselation + 1);
+    std::vector<glm::vec4> verts;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec4> normals;
+    std::vector<glm::vec4> colors(nVerts, color);
+    verts.reserve(nVerts);
+    uvs.reserve(nVerts);
+    normals.reserve(nVerts);
 
     for (int i = 0; i < heightTesselation; i++) {
+        int linearScale = heightTesselation - i;
+        float topRadius = radius * heightStep * (linearScale - 1);
+        float bottomRadius = radius * heightStep * linearScale;
+
         for (int j = 0; j < (thetaTesselation + 1); j++) {
-            int linearScale = heightTesselation - i;
             // Top vertex position
-            verts.push_back(glm::vec4(radius*heightStep*(linearScale - 1) * std::cos(-thetaStep*j), heightStep * (i + 1) - height/2,
-              radius*heightStep*(linearScale - 1) * std::sin(-thetaStep*j), 1.0f));
+            verts.push_back(glm::vec4(topRadius * cosTheta[j], heightStep * (i + 1) - height/2,
+              -topRadius * sinTheta[j], 1.0f));
 
             // Top vertex normal
-            glm::vec4 normal = glm::vec4(2/(std::sqrt(5)) * std::cos(-thetaStep*j),
-                                         1/(std::sqrt(5)),
-                                         2/(std::sqrt(5)) * std::sin(-thetaStep*j), 0.0f);
-            normal = normalize(normal);
+            glm::vec4 normal = glm::vec4(a * cosTheta[j], b, -a * sinTheta[j], 0.0f);
             normals.push_back(normal);
 
             // Top UV
             uvs.push_back(glm::vec2(static_cast<float>(j)/thetaTesselation, static_cast<float>(i + 1)/heightTesselation));
 
             // Bottom vertex position
-            verts.push_back(glm::vec4(radius*heightStep*linearScale * std::cos(-thetaStep*j), heightStep * i - height/2,
-              radius*heightStep*linearScale * std::sin(-thetaStep*j), 1.0f));
+            verts.push_back(glm::vec4(bottomRadius * cosTheta[j], heightStep * i - height/2,
+              -bottomRadius * sinTheta[j], 1.0f));
 
             // Bottom vertex normal
             normals.push_back(normal);
 
-            // Top UV
+            // Bottom UV
             uvs.push_back(glm::vec2(static_cast<float>(j)/thetaTesselation, static_cast<float>(i)/heightTesselation));
-
-            // Color
-            colors.push_back(color);
-            colors.push_back(color);
         }
 
     }
 
-    _cap->addData(bsg::GLDATA_VERTICES, "position", verts);
+    cone->addData(bsg::GLDATA_VERTICES, "position", verts);
 
-    _cap->addData(bsg::GLDATA_COLORS, "color", colors);
+    cone->addData(bsg::GLDATA_COLORS, "color", colors);
 
-    _cap->addData(bsg::GLDATA_NORMALS, "normal", normals);
+    cone->addData(bsg::GLDATA_NORMALS, "normal", normals);
 
-    _cap->addData(bsg::GLDATA_TEXCOORDS, "texture", uvs);
+    cone->addData(bsg::GLDATA_TEXCOORDS, "texture", uvs);
 
     // The vertices above are arranged into a set of triangles.
-    _cap->setDrawType(GL_TRIANGLE_STRIP, verts.size());
+    cone->setDrawType(GL_TRIANGLE_STRIP, verts.size());
+  }
 
-    drawableCircle::getCircle(_base, _theta, -1, -radius/2.0f, color);
+  drawableCylinder::drawableCylinder(bsgPtr<shaderMgr> pShader, const int &heightTesselation, const int &thetaTesselation, const glm::vec4 &color) :
+    drawableTessellated(pShader, color), _height(heightTesselation), _theta(thetaTesselation) {
 
-    addObject(_cap);
-    addObject(_base);
+    _initLevels(thetaTesselation, sqrt(0.5f));
   }
 
+  void drawableCylinder::_makeLevel(const int &segments, DrawableObjList &objects) {
 
-  void drawableCone::makeCone(bsgPtr<drawableObj> cone, int heightTesselation, int thetaTesselation, float radius, float height, glm::vec4 color) {
+    bsgPtr<drawableObj> base = new drawableObj();
+    bsgPtr<drawableObj> body = new drawableObj();
+    bsgPtr<drawableObj> top = new drawableObj();
 
-}
+    getCylinder(body, _height, segments, _color);
+    drawableCircle::getCircle(top, segments, 1, 0.5f, _color);
+    drawableCircle::getCircle(base, segments, -1, -0.5f, _color);
 
-  drawableCylinder::drawableCylinder(bsgPtr<shaderMgr> pShader, const int &heightTesselation, const int &thetaTesselation, const glm::vec4 &color) :
-    drawableCompound(pShader), _height(heightTesselation), _theta(thetaTesselation) {
+    objects.push_back(base);
+    objects.push_back(body);
+    objects.push_back(top);
+  }
+
+  void drawableCylinder::getCylinder(bsgPtr<drawableObj> body, const int &heightTesselation, const int &thetaTesselation, const glm::vec4 &color) {
 
-    float pi = 3.14159265358979323;
     float r = 0.5;
-    float thetaStep = 2 * pi/thetaTesselation;
     float heightStep = 1.f/heightTesselation;
 
-    std::vector<glm::vec4> verts(0);
-    std::vector<glm::vec2> uvs(0);
-    std::vector<glm::vec4> normals(0);
-    std::vector<glm::vec4> colors(0);
+    std::vector<float> cosTheta, sinTheta;
+    primitiveGenerator::circleTable(thetaTesselation, cosTheta, sinTheta);
+
+    int nVerts = 2 * heightTesselation * (thetaTesselation + 1);
+    std::vector<glm::vec4> verts;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec4> normals;
+    std::vector<glm::vec4> colors(nVerts, color);
+    verts.reserve(nVerts);
+    uvs.reserve(nVerts);
+    normals.reserve(nVerts);
 
     for (int i = 0; i < heightTesselation; i++) {
         for (int j = 0; j < (thetaTesselation + 1); j++) {
 
+            // The normal points straight out, and is already unit length.
+            glm::vec4 normal = glm::vec4(cosTheta[j], 0, -sinTheta[j], 0.0f);
+
             // Top vertex position
-            verts.push_back(glm::vec4(r * std::cos(-thetaStep * j), heightStep * (i + 1) - r, r * std::sin(-thetaStep * j), 1.0f));
+            verts.push_back(glm::vec4(r * normal.x, heightStep * (i + 1) - r, r * normal.z, 1.0f));
 
             // Top vertex normal
-            glm::vec4 normal = glm::vec4(r * std::cos(-thetaStep * j), 0, r * std::sin(-thetaStep * j), 0.0f);
-            normal = normalize(normal);
             normals.push_back(normal);
 
             // Top UV
             uvs.push_back(glm::vec2(static_cast<float>(j)/thetaTesselation, static_cast<float>(i + 1)/heightTesselation));
 
             // Bottom vertex position
-            verts.push_back(glm::vec4(r * std::cos(-thetaStep * j), heightStep * i - r, r * std::sin(-thetaStep * j), 1.0f));
+            verts.push_back(glm::vec4(r * normal.x, heightStep * i - r, r * normal.z, 1.0f));
 
             // Bottom vertex normal
             normals.push_back(normal);
 
             // Bottom UV
             uvs.push_back(glm::vec2(static_cast<float>(j)/thetaTesselation, static_cast<float>(i)/heightTesselation));
-
-            // Colors
-            colors.push_back(color);
-            colors.push_back(color);
         }
     }
 
-    _base = new drawableObj();
-    _body = new drawableObj();
-    _top = new drawableObj();
-
-    _body->addData(bsg::GLDATA_VERTICES, "position", verts);
+    body->addData(bsg::GLDATA_VERTICES, "position", verts);
 
-    _body->addData(bsg::GLDATA_COLORS, "color", colors);
+    body->addData(bsg::GLDATA_COLORS, "color", colors);
 
-    _body->addData(bsg::GLDATA_NORMALS, "normal", normals);
+    body->addData(bsg::GLDATA_NORMALS, "normal", normals);
 
-    _body->addData(bsg::GLDATA_TEXCOORDS, "texture", uvs);
+    body->addData(bsg::GLDATA_TEXCOORDS, "texture", uvs);
 
-    _body->setDrawType(GL_TRIANGLE_STRIP, verts.size());
-
-    drawableCircle::getCircle(_top, _theta, 1, r, color);
-    drawableCircle::getCircle(_base, _theta, -1, -r, color);
-
-    addObject(_base);
-    addObject(_body);
-    addObject(_top);
+    body->setDrawType(GL_TRIANGLE_STRIP, verts.size());
   }
 
   drawableAxes::drawableAxes(bsgPtr<shaderMgr> pShader, const float &length) :
@@ -829,17 +824,22 @@ drawableText::drawableText(bsgPtr<shaderMgr> pShader, const char *text,
                            const float height, const char *fontFilePath,
                            const glm::vec4 color, bsgPtr<fontTextureMgr> texture) :
     drawableCompound(pShader),
-    _texture(texture),
     _text(text),
     _height(height),
     _fontFilePath(fontFilePath),
-    _color(color) {
+    _color(color),
+    _texture(texture),
+    _capacity(0),
+    _generation(-1) {
 
   _name = randomName("text");
 
+  // Text is readable (well, mirror-readable) from behind.
+  setTwoSided(true);
+
   if (!_texture) {
     _texture = new bsg::fontTextureMgr();
-    _pShader->addTexture(bsgPtr<textureMgr>((textureMgr *) (_texture.ptr())));
+    _pShader->addTexture(_texture);
   }
 
   // If the font requested isn't already in this texture's fontMap, we need to
@@ -851,14 +851,21 @@ drawableText::drawableText(bsgPtr<shaderMgr> pShader, const char *text,
     std::cout << "we have that font already" << std::endl;
   }
 
+  // All the glyphs go into one object, whose buffers are updated in
+  // place when the text changes.
+  _glyphs = new drawableObj();
+  _glyphs->setDynamic(true);
+  addObject(_glyphs);
+
+  _allocate(std::max(_text.size(), (size_t)16));
   _write();
 }
 
-void drawableText::_write() {
+bool drawableText::_layout(std::vector<glm::vec4> &positions,
+                           std::vector<glm::vec2> &uvs) {
 
   texture_font_t *font = _texture->getFont(_fontFilePath);
-
-  // vertex_buffer_t *buffer = vertex_buffer_new("vertex:3f,tex_coord:2f,color:4f");
+  float fontSize = _texture->getFontSize();
 
   // _height is the height we want the text to be, in world units. But
   // freetypegl measures font size in pixels, so if we don't scale the
@@ -867,139 +874,169 @@ void drawableText::_write() {
   // wanted) by font's height attribute. See:
   // https://github.com/rougier/freetype-gl/blob/master/texture-font.h
   float scaling_factor = _height / font->height;
-  int i = 0;
-  vec2 pen = {{0.0f, 0.0f}};
 
-  while(_text[i]) {
-    texture_glyph_t *glyph = texture_font_get_glyph(font, &_text[i]);
+  // If a glyph we ask for doesn't fit in the atlas, the atlas starts
+  // over and the glyphs we already have are no good, so go around
+  // again.  It won't happen twice unless the string doesn't fit in
+  // the atlas at all.
+  for (int attempt = 0; attempt < 2; attempt++) {
+    _generation = _texture->getGeneration();
+
+    vec2 pen = {{0.0f, 0.0f}};
+    float maxHeight = 0.0f;
+
+    positions.clear();
+    uvs.clear();
+
+    // Lay out the glyphs starting from the origin, then move them all
+    // so the string is centered once we know how big it is.  Each
+    // glyph is a quad whose corners go counterclockwise from the lower
+    // left, the same as primitiveGenerator::quads().  The text is
+    // UTF-8, so a character can be more than one byte.
+    const char *text = _text.c_str();
+    const char *previous = NULL;
+    for (size_t i = 0; text[i]; i += bsgUtils::utf8Length(&text[i])) {
+      texture_glyph_t *glyph =
+        _texture->getGlyph(_fontFilePath, fontSize, &text[i]);
+      if (!glyph) continue;
+
+      float kerning = 0.0f;
+      if (previous) {
+        kerning = _texture->getKerning(glyph, previous);
+      }
+      previous = &text[i];
+
+      pen.x += kerning;
+
+      float x0  = (pen.x + glyph->offset_x);
+      float y0  = (int)(pen.y + glyph->offset_y);
+      float x1  = (x0 + glyph->width);
+      float y1  = (int)(y0 - glyph->height);
+
+      // Spaces and such have nothing to draw.
+      if (glyph->width > 0 && glyph->height > 0) {
+        positions.push_back(glm::vec4(x0, y1, 0.0f, 1.0f));
+        positions.push_back(glm::vec4(x1, y1, 0.0f, 1.0f));
+        positions.push_back(glm::vec4(x1, y0, 0.0f, 1.0f));
+        positions.push_back(glm::vec4(x0, y0, 0.0f, 1.0f));
+
+        // The atlas has its rows upside down, so the lower left corner
+        // of the quad gets (s0, t1).
+        uvs.push_back(glm::vec2(glyph->s0, glyph->t1));
+        uvs.push_back(glm::vec2(glyph->s1, glyph->t1));
+        uvs.push_back(glm::vec2(glyph->s1, glyph->t0));
+        uvs.push_back(glm::vec2(glyph->s0, glyph->t0));
+      }
 
-    float kerning = 0.0f;
-    if (i > 0) {
-      kerning = texture_glyph_get_kerning(glyph, _text + i - 1);
+      pen.x += glyph->advance_x;
+      if (maxHeight < glyph->height) maxHeight = glyph->height;
     }
 
-    pen.x += kerning;
-    pen.x += glyph->advance_x;
+    if (_generation != _texture->getGeneration()) continue;
 
-    if (pen.y < glyph->height) {
-      pen.y = glyph->height;
+    glm::vec4 center = glm::vec4(pen.x / 2, maxHeight / 2, 0.0f, 0.0f);
+    for (size_t i = 0; i < positions.size(); i++) {
+      positions[i] = scaling_factor * (positions[i] - center);
+      positions[i].w = 1.0f;
     }
-    i++;
+    return true;
   }
 
-  float w = scaling_factor * pen.x;
-  float h = scaling_factor * pen.y;
-
-  i = 0;
-  pen.x = 0.0f;
-  pen.y = 0.0f;
-
-  while (_text[i]) {
-    bsgPtr<drawableObj> _frontFace = new drawableObj();
-    bsgPtr<drawableObj> _backFace = new drawableObj();
-    texture_glyph_t *glyph = texture_font_get_glyph(font, &_text[i]);
-
-    float kerning = 0.0f;
-    if (i > 0) {
-      kerning = texture_glyph_get_kerning(glyph, _text + i - 1);
-    }
-
-    pen.x += kerning;
-
-    float x0  = (pen.x + glyph->offset_x);
-    float y0  = (int)(pen.y + glyph->offset_y);
-    float x1  = (x0 + glyph->width);
-    float y1  = (int)(y0 - glyph->height);
-
-    std::vector<glm::vec4> frontFaceVertices;
-
-    frontFaceVertices.push_back(glm::vec4(scaling_factor*x0-w/2, scaling_factor*y1-h/2, 0.0f, 1.0f));
-    frontFaceVertices.push_back(glm::vec4(scaling_factor*x1-w/2, scaling_factor*y1-h/2, 0.0f, 1.0f));
-    frontFaceVertices.push_back(glm::vec4(scaling_factor*x0-w/2, scaling_factor*y0-h/2, 0.0f, 1.0f));
-    frontFaceVertices.push_back(glm::vec4(scaling_factor*x1-w/2, scaling_factor*y0-h/2, 0.0f, 1.0f));
-
-    _frontFace->addData(bsg::GLDATA_VERTICES, "position", frontFaceVertices);
-
-    std::vector<glm::vec4> frontFaceNormals;
-
-    frontFaceNormals.push_back(glm::vec4(0.0f, 0.0f, 1.0f, 0.0f));
-    frontFaceNormals.push_back(glm::vec4(0.0f, 0.0f, 1.0f, 0.0f));
-    frontFaceNormals.push_back(glm::vec4(0.0f, 0.0f, 1.0f, 0.0f));
-    frontFaceNormals.push_back(glm::vec4(0.0f, 0.0f, 1.0f, 0.0f));
-
-    _frontFace->addData(bsg::GLDATA_NORMALS, "normal", frontFaceNormals);
-
-    std::vector<glm::vec2> frontFaceUVs;
-
-    float u0 = glyph->s0;
-    float v0 = glyph->t0;
-    float u1 = glyph->s1;
-    float v1 = glyph->t1;
-
-    frontFaceUVs.push_back(glm::vec2(u0, v1));
-    frontFaceUVs.push_back(glm::vec2(u1, v1));
-    frontFaceUVs.push_back(glm::vec2(u0, v0));
-    frontFaceUVs.push_back(glm::vec2(u1, v0));
+  return false;
+}
 
-    _frontFace->addData(bsg::GLDATA_TEXCOORDS, "texture", frontFaceUVs);
+void drawableText::_allocate(const size_t &capacity) {
 
-    // Here are the corresponding colors for the above vertices.
-    std::vector<glm::vec4> frontFaceColors;
-    frontFaceColors.push_back(_color);
-    frontFaceColors.push_back(_color);
-    frontFaceColors.push_back(_color);
-    frontFaceColors.push_back(_color);
-
-    _frontFace->addData(bsg::GLDATA_COLORS, "color", frontFaceColors);
-    
-    // The vertices above are arranged into a set of triangles.
-    _frontFace->setDrawType(GL_TRIANGLE_STRIP);  
+  // Empty quads, to be filled in by _write().  The color and normal
+  // never change, and neither does the index array, since every
+  // quad uses its four vertices the same way.
+  std::vector<glm::vec3> corners(capacity, glm::vec3(0.0f));
+  std::vector<glm::vec2> sizes(capacity, glm::vec2(0.0f));
+  std::vector<glm::vec4> texRects(capacity, glm::vec4(0.0f));
 
-    // Same thing for the back-facing rectangle.
-    std::vector<glm::vec4> backFaceVertices;
+  primitiveGenerator::quads(_glyphs, corners, sizes, texRects,
+                            std::vector<glm::vec4>(1, _color), 1);
+  _capacity = capacity;
 
-    backFaceVertices.push_back(glm::vec4(scaling_factor*x0-w/2, scaling_factor*y1-h/2, 0.0f, 1.0f));
-    backFaceVertices.push_back(glm::vec4(scaling_factor*x0-w/2, scaling_factor*y0-h/2, 0.0f, 1.0f));
-    backFaceVertices.push_back(glm::vec4(scaling_factor*x1-w/2, scaling_factor*y1-h/2, 0.0f, 1.0f));
-    backFaceVertices.push_back(glm::vec4(scaling_factor*x1-w/2, scaling_factor*y0-h/2, 0.0f, 1.0f));
+  // The new arrays are all zero.
+  _positions.assign(4 * capacity, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+  _uvs.assign(4 * capacity, glm::vec2(0.0f));
+}
 
-    _backFace->addData(bsg::GLDATA_VERTICES, "position", backFaceVertices);
+void drawableText::_write() {
 
-    std::vector<glm::vec4> backFaceNormals;
+  std::vector<glm::vec4> positions;
+  std::vector<glm::vec2> uvs;
+  if (!_layout(positions, uvs)) {
+
+    // Draw nothing, rather than glyphs from an atlas that has since
+    // started over.  Don't try again until the atlas does.
+    std::cerr << "** Caution: the text '" << _text
+              << "' doesn't fit in the font atlas." << std::endl;
+    _generation = _texture->getGeneration();
+    _glyphs->setDrawType(GL_TRIANGLES, 0);
+    return;
+  }
 
-    backFaceNormals.push_back(glm::vec4(0.0f, 0.0f, -1.0f, 0.0f));
-    backFaceNormals.push_back(glm::vec4(0.0f, 0.0f, -1.0f, 0.0f));
-    backFaceNormals.push_back(glm::vec4(0.0f, 0.0f, -1.0f, 0.0f));
-    backFaceNormals.push_back(glm::vec4(0.0f, 0.0f, -1.0f, 0.0f));
+  size_t nQuads = positions.size() / 4;
 
-    _backFace->addData(bsg::GLDATA_NORMALS, "normal", backFaceNormals);
+  // Grow the buffers if we have to, leaving some room, so a string
+  // that gets a little longer now and then doesn't reallocate them
+  // every time.
+  if (nQuads > _capacity) {
+    _allocate(std::max(nQuads, 2 * _capacity));
+  }
 
-    std::vector<glm::vec2> backFaceUVs;
+  // Only the glyphs that differ from what's already in the buffers
+  // need to be sent again.  For a number that changes every frame,
+  // that's usually just the last few digits.
+  size_t first = 0;
+  while (first < positions.size() &&
+         positions[first] == _positions[first] && uvs[first] == _uvs[first])
+    first++;
+
+  // Anything past the end of the new string isn't drawn, so it can
+  // be left alone.
+  size_t last = positions.size();
+  while (last > first &&
+         positions[last - 1] == _positions[last - 1] &&
+         uvs[last - 1] == _uvs[last - 1])
+    last--;
+
+  if (last > first) {
+    std::vector<glm::vec4> changedPositions(positions.begin() + first,
+                                            positions.begin() + last);
+    std::vector<glm::vec2> changedUVs(uvs.begin() + first, uvs.begin() + last);
+
+    _glyphs->updateData(GLDATA_VERTICES, first, changedPositions);
+    _glyphs->updateData(GLDATA_TEXCOORDS, first, changedUVs);
+
+    std::copy(positions.begin() + first, positions.begin() + last,
+              _positions.begin() + first);
+    std::copy(uvs.begin() + first, uvs.begin() + last, _uvs.begin() + first);
+
+    _glyphs->findBoundingBox();
+  }
 
-    backFaceUVs.push_back(glm::vec2(u0, v1));
-    backFaceUVs.push_back(glm::vec2(u0, v0));
-    backFaceUVs.push_back(glm::vec2(u1, v1));
-    backFaceUVs.push_back(glm::vec2(u1, v0));
+  // Six indices per quad.
+  _glyphs->setDrawType(GL_TRIANGLES, 6 * nQuads);
+}
 
-    _backFace->addData(bsg::GLDATA_TEXCOORDS, "texture", backFaceUVs);
+void drawableText::load() {
 
-    std::vector<glm::vec4> backFaceColors;
-    backFaceColors.push_back(_color);
-    backFaceColors.push_back(_color);
-    backFaceColors.push_back(_color);
-    backFaceColors.push_back(_color);
+  // If the font atlas has started over since we were laid out, our
+  // texture coordinates point at the wrong things.
+  if (_generation != _texture->getGeneration()) _write();
 
-    _backFace->addData(bsg::GLDATA_COLORS, "color", backFaceColors);
-    
-    _backFace->setDrawType(GL_TRIANGLE_STRIP);  
+  drawableCompound::load();
+}
 
-    addObject(_frontFace);
-    addObject(_backFace);
+void drawableText::setText(const std::string &text) {
 
-    pen.x += glyph->advance_x;
+  if (text == _text) return;
 
-    i++;
-  }
+  _text = text;
+  _write();
 }
 
 bsgPtr<fontTextureMgr> drawableText::getFontTexture() {
@@ -1022,16 +1059,16 @@ drawableTextRect::drawableTextRect(bsgPtr<shaderMgr> textShader,
                    const float offsetDist) : 
     drawableCollection(),
     _text(text),
-    _fontFilePath(fontFilePath),
-    _texture(texture),
     _textHeight(textHeight),
-    _textColor(textColor),
-    _backgroundColor(backgroundColor),
-    _borderColor(borderColor),
+    _fontFilePath(fontFilePath),
     _boxHeight(boxHeight),
     _boxWidth(boxWidth),
     _borderWidth(borderWidth),
-    _offsetDist(offsetDist) {
+    _offsetDist(offsetDist),
+    _textColor(textColor),
+    _backgroundColor(backgroundColor),
+    _borderColor(borderColor),
+    _texture(texture) {
 
   std::cout << "1" << std::endl;
   // The background rectangle
@@ -1085,18 +1122,18 @@ drawableTextBox::drawableTextBox(bsgPtr<shaderMgr> textShader,
                    const glm::vec4 extrusionColor) : 
     drawableCollection(),
     _text(text),
-    _fontFilePath(fontFilePath),
-    _texture(texture),
-    _extrusion(extrusion),
     _textHeight(textHeight),
-    _textColor(textColor),
-    _backgroundColor(backgroundColor),
-    _borderColor(borderColor),
+    _fontFilePath(fontFilePath),
     _boxHeight(boxHeight),
     _boxWidth(boxWidth),
     _borderWidth(borderWidth),
+    _extrusion(extrusion),
     _offsetDist(offsetDist),
-    _extrusionColor(extrusionColor) {
+    _extrusionColor(extrusionColor),
+    _textColor(textColor),
+    _backgroundColor(backgroundColor),
+    _borderColor(borderColor),
+    _texture(texture) {
 
   _name = randomName("textBox");
 
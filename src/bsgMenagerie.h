@@ -7,7 +7,7 @@ class drawableRectangle : public drawableCompound {
 
   float _width, _height;
 
-  bsgPtr<drawableObj> _frontFace, _backFace;
+  bsgPtr<drawableObj> _frontFace;
 
  public:
   drawableRectangle(bsgPtr<shaderMgr> pShader,
@@ -23,7 +23,7 @@ class drawableRectangleOutline : public drawableCompound {
  private:
 
   float _width, _height, _strokeWidth;
-  bsgPtr<drawableObj> _frontFace, _backFace;
+  bsgPtr<drawableObj> _frontFace;
 
  public:
   drawableRectangleOutline(bsgPtr<shaderMgr> pShader,
@@ -64,39 +64,108 @@ class drawableCube : public drawableCompound {
 };
 
 
-class drawableSphere : public drawableCompound {
+/// \brief A shape whose tessellation depends on its size on screen.
+///
+/// The round shapes (sphere, cone, cylinder, circle) are made of flat
+/// pieces, and the number of pieces that looks smooth depends on how
+/// big the shape is on the screen.  A sphere filling a CAVE wall
+/// needs a lot more than a distant one the size of a few pixels.
+///
+/// So these shapes keep a small set of tessellations: the one asked
+/// for in the constructor, and a couple coarser and finer ones on
+/// either side of it.  On each draw, the shape's bounding radius is
+/// projected onto the screen, and the coarsest tessellation whose
+/// flat pieces deviate from the true curve by less than the
+/// tolerance (half a pixel, unless you change it) is drawn.  The
+/// other tessellations are only built the first time they're
+/// needed, so a shape that stays far away never pays for the fine
+/// ones.
+///
+/// A subclass provides _makeLevel() to build the objects for a given
+/// number of segments around its circumference, and calls
+/// _initLevels() in its constructor.
+class drawableTessellated : public drawableCompound {
+ protected:
+
+  glm::vec4 _color;
+
+  // The radius of a sphere around the origin that contains the
+  // shape, in model space.
+  float _radius;
+
+  // The largest deviation from the true curve we'll allow, in pixels.
+  float _tolerance;
+
+  // The number of segments around the circumference for each level,
+  // from coarsest to finest, and the objects for that level, if it
+  // has been built.
+  std::vector<int> _levelSegments;
+  std::vector<DrawableObjList> _levels;
+  size_t _current;
+
+  /// Sets up the levels, and builds the one with the given number of
+  /// segments as the starting point.
+  void _initLevels(const int &segments, const float &radius);
+
+  /// Build the objects for a given number of segments around.
+  virtual void _makeLevel(const int &segments, DrawableObjList &objects) = 0;
+
+ public:
+  drawableTessellated(bsgPtr<shaderMgr> pShader, const glm::vec4 &color);
+
+  /// \brief Set the largest allowable deviation from the curve, in pixels.
+  void setTolerance(const float &pixels) { _tolerance = pixels; };
+
+  /// \brief The number of segments around the shape in the last draw.
+  int getCurrentSegments() { return _levelSegments[_current]; };
+
+  /// \brief Prepares every tessellation built so far.
+  ///
+  /// This happens again if the shader changes variants, so the ones
+  /// built since the first prepare() need it, too.
+  void prepare();
+
+  /// \brief Picks a tessellation and draws it.
+  ///
+  /// The first time a tessellation is picked, it is built, prepared,
+  /// and loaded here.
+  void draw(const glm::mat4 &viewMatrix,
+            const glm::mat4 &projMatrix);
+};
+
+class drawableSphere : public drawableTessellated {
  private:
 
   float _phi, _theta;
 
-  bsgPtr<drawableObj> _sphere;
+  void _makeLevel(const int &segments, DrawableObjList &objects);
 
  public:
   drawableSphere(bsgPtr<shaderMgr> pShader,
                     const int &phi, const int &theta, const glm::vec4 &color);
+  static void getSphere(bsgPtr<drawableObj> sphere, const int &phiTesselation, const int &thetaTesselation, const glm::vec4 &color);
 
 };
 
-class drawableCone : public drawableCompound {
+class drawableCone : public drawableTessellated {
  private:
 
   float _height, _theta;
 
-  bsgPtr<drawableObj> _cap;
-  bsgPtr<drawableObj> _base;
-
-  void makeCone(bsgPtr<drawableObj> cone, int heightTesselation, int thetaTesselation, float radius, float height, glm::vec4 color);
+  void _makeLevel(const int &segments, DrawableObjList &objects);
 
  public:
    drawableCone(bsgPtr<shaderMgr> pShader, const int &heightTesselation, const int &thetaTesselation, const glm::vec4 &color);
+   static void getCone(bsgPtr<drawableObj> cone, const int &heightTesselation, const int &thetaTesselation, const glm::vec4 &color);
 };
 
-class drawableCircle : public drawableCompound {
+class drawableCircle : public drawableTessellated {
  private:
 
   float _theta;
+  float _normalDirection, _yPos;
 
-  bsgPtr<drawableObj> _circle;
+  void _makeLevel(const int &segments, DrawableObjList &objects);
 
  public:
   drawableCircle(bsgPtr<shaderMgr> pShader, const int &thetaTesselation, const float &normalDirection, const float &yPos);
@@ -104,17 +173,16 @@ class drawableCircle : public drawableCompound {
 
 };
 
-class drawableCylinder : public drawableCompound {
+class drawableCylinder : public drawableTessellated {
  private:
 
   float _height, _theta;
 
-  bsgPtr<drawableObj> _base;
-  bsgPtr<drawableObj> _body;
-  bsgPtr<drawableObj> _top;
+  void _makeLevel(const int &segments, DrawableObjList &objects);
 
  public:
   drawableCylinder(bsgPtr<shaderMgr> pShader, const int &heightTesselation, const int &thetaTesselation, const glm::vec4 &color);
+  static void getCylinder(bsgPtr<drawableObj> body, const int &heightTesselation, const int &thetaTesselation, const glm::vec4 &color);
 };
 
 /// \brief Some axes.
@@ -200,15 +268,44 @@ class drawablePoints : public drawableCompound {
 /// either use that texture with the existing font, or add a new font to the
 /// texture, but it's all stored within the same texture so as to save on
 /// memory usage.
+///
+/// The whole string is laid out as one indexed list of quads, so it
+/// costs one draw call no matter how long it is.  drawableTextRect and
+/// drawableTextBox use this, too.  The text can be changed with
+/// setText().  It is UTF-8, and any character in the font can be used;
+/// the glyphs are added to the font texture as they are needed.
+///
+/// For text that stays crisp at any size, pass in a fontTextureMgr
+/// made in signed distance field mode, and use a shader with
+/// shaders/textShaderSDF.fp.
 
 class drawableText : public drawableCompound {
   private:
-    const char *_text;
+    std::string _text;
     const float _height;
     const char *_fontFilePath;
     const glm::vec4 _color;
     bsgPtr<fontTextureMgr> _texture;
 
+    /// All the glyphs, as one quad apiece, in a single object.
+    bsgPtr<drawableObj> _glyphs;
+
+    /// How many glyphs fit in the buffers of _glyphs.
+    size_t _capacity;
+
+    /// A copy of what's in those buffers, to see what changed.
+    std::vector<glm::vec4> _positions;
+    std::vector<glm::vec2> _uvs;
+
+    /// The font atlas generation the glyphs were laid out with.
+    int _generation;
+
+    /// Lays out the glyphs, or returns false if they don't all fit
+    /// in the font atlas.
+    bool _layout(std::vector<glm::vec4> &positions,
+                 std::vector<glm::vec2> &uvs);
+    void _allocate(const size_t &capacity);
+
   public:
     drawableText(bsgPtr<shaderMgr> shader,
                  const char *text,
@@ -219,6 +316,20 @@ class drawableText : public drawableCompound {
 
     bsgPtr<fontTextureMgr> getFontTexture();
     void _write();
+
+    /// \brief Change the text.
+    ///
+    /// Only the glyphs that changed are sent to the GPU again, and
+    /// the buffers are only reallocated if the new text is too long
+    /// to fit in them, so this is cheap enough to use for things like
+    /// a frame rate readout that changes every frame.
+    void setText(const std::string &text);
+
+    /// \brief Returns the text.
+    std::string getText() { return _text; };
+
+    /// \brief Lays the text out again if the font atlas has changed.
+    void load();
 };
 
 /// \brief A rectangle of text, like a button.
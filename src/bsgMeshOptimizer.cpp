@@ -0,0 +1,748 @@
+#include "bsgMeshOptimizer.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <queue>
+
+namespace bsg {
+
+const int meshOptimizer::orderCacheSize;
+const int meshOptimizer::measureCacheSize;
+
+// A key for finding equal vertices: some floats of one vertex, so
+// they can be compared, and hashed, in one go.  Add zero to each
+// float going in, to turn -0.0 into 0.0, so they match.
+template <int N>
+struct _floatKey {
+  float data[N];
+
+  bool operator==(const _floatKey &other) const {
+    return memcmp(data, other.data, sizeof(data)) == 0;
+  }
+};
+
+// FNV-1a, over the bytes of the key.
+template <int N>
+struct _floatKeyHash {
+  size_t operator()(const _floatKey<N> &key) const {
+    const unsigned char *bytes = (const unsigned char *)key.data;
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < sizeof(key.data); i++) {
+      hash ^= bytes[i];
+      hash *= 1099511628211ULL;
+    }
+    return (size_t)hash;
+  }
+};
+
+// All the data of one vertex, for welding.
+typedef _floatKey<14> _weldKey;
+typedef std::unordered_map<_weldKey, GLuint, _floatKeyHash<14> > _weldMap;
+
+// Just the position.
+typedef _floatKey<3> _positionKey;
+typedef std::unordered_map<_positionKey, int,
+                           _floatKeyHash<3> > _positionMap;
+
+size_t meshOptimizer::weld(bsgPtr<drawableObj> obj) {
+
+  if (obj->getDrawType() != GL_TRIANGLES) return 0;
+
+  std::vector<glm::vec4> vertices = obj->getData(GLDATA_VERTICES);
+  std::vector<glm::vec4> colors = obj->getData(GLDATA_COLORS);
+  std::vector<glm::vec4> normals = obj->getData(GLDATA_NORMALS);
+  std::vector<glm::vec2> uvs = obj->getTexCoords();
+
+  std::vector<GLuint> indices = obj->getIndices();
+  if (indices.empty()) {
+    indices.resize(vertices.size());
+    for (GLuint i = 0; i < vertices.size(); i++) indices[i] = i;
+  }
+
+  // Find the first copy of each distinct vertex.
+  _weldMap firstCopy(vertices.size());
+  std::vector<GLuint> remap(vertices.size());
+  std::vector<GLuint> unique;
+  unique.reserve(vertices.size());
+
+  for (GLuint i = 0; i < vertices.size(); i++) {
+
+    _weldKey key;
+    memset(key.data, 0, sizeof(key.data));
+    for (int j = 0; j < 4; j++) {
+      key.data[j] = vertices[i][j] + 0.0f;
+      if (i < colors.size()) key.data[4 + j] = colors[i][j] + 0.0f;
+      if (i < normals.size()) key.data[8 + j] = normals[i][j] + 0.0f;
+    }
+    if (i < uvs.size()) {
+      key.data[12] = uvs[i].x + 0.0f;
+      key.data[13] = uvs[i].y + 0.0f;
+    }
+
+    _weldMap::iterator it = firstCopy.find(key);
+    if (it == firstCopy.end()) {
+      remap[i] = unique.size();
+      firstCopy[key] = unique.size();
+      unique.push_back(i);
+    } else {
+      remap[i] = it->second;
+    }
+  }
+
+  // Rewrite the index array, dropping the degenerate triangles.
+  std::vector<GLuint> newIndices;
+  newIndices.reserve(indices.size());
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    GLuint a = remap[indices[i]];
+    GLuint b = remap[indices[i + 1]];
+    GLuint c = remap[indices[i + 2]];
+    if (a == b || b == c || c == a) continue;
+    newIndices.push_back(a);
+    newIndices.push_back(b);
+    newIndices.push_back(c);
+  }
+
+  // Compact the data arrays.
+  std::vector<glm::vec4> newVertices(unique.size());
+  std::vector<glm::vec4> newColors(colors.empty() ? 0 : unique.size());
+  std::vector<glm::vec4> newNormals(normals.empty() ? 0 : unique.size());
+  std::vector<glm::vec2> newUVs(uvs.empty() ? 0 : unique.size());
+  for (size_t i = 0; i < unique.size(); i++) {
+    newVertices[i] = vertices[unique[i]];
+    if (!colors.empty()) newColors[i] = colors[unique[i]];
+    if (!normals.empty()) newNormals[i] = normals[unique[i]];
+    if (!uvs.empty()) newUVs[i] = uvs[unique[i]];
+  }
+
+  obj->setData(GLDATA_VERTICES, newVertices);
+  if (!colors.empty()) obj->setData(GLDATA_COLORS, newColors);
+  if (!normals.empty()) obj->setData(GLDATA_NORMALS, newNormals);
+  if (!uvs.empty()) obj->setData(GLDATA_TEXCOORDS, newUVs);
+  obj->setIndices(newIndices);
+
+  return unique.size();
+}
+
+// The vertex scoring function from Forsyth's paper.  The constants
+// are his.
+static float _forsythScore(const int &cachePos, const int &remaining,
+                           const int &cacheSize) {
+
+  // No triangles left that need this vertex.
+  if (remaining == 0) return -1.0f;
+
+  float score = 0.0f;
+  if (cachePos >= 0) {
+    if (cachePos < 3) {
+      // This vertex was used in the last triangle, so it has a fixed
+      // score, whichever of the three it was.
+      score = 0.75f;
+    } else {
+      float scaler = 1.0f / (cacheSize - 3);
+      score = powf(1.0f - (cachePos - 3) * scaler, 1.5f);
+    }
+  }
+
+  // Bonus points for having few triangles left, so lone vertices
+  // get cleared out instead of lingering.
+  score += 2.0f * powf((float)remaining, -0.5f);
+
+  return score;
+}
+
+void meshOptimizer::optimizeVertexCache(std::vector<GLuint> &indices,
+                                        const size_t &nVertices,
+                                        const int &cacheSize) {
+
+  size_t nTriangles = indices.size() / 3;
+  if (nTriangles == 0) return;
+
+  // Build the vertex-to-triangle adjacency, in compressed form:
+  // the triangles using vertex v are in
+  // adjacency[offsets[v] .. offsets[v] + remaining[v]].
+  std::vector<int> remaining(nVertices, 0);
+  for (size_t i = 0; i < nTriangles * 3; i++) remaining[indices[i]]++;
+
+  std::vector<int> offsets(nVertices, 0);
+  for (size_t v = 1; v < nVertices; v++)
+    offsets[v] = offsets[v - 1] + remaining[v - 1];
+
+  std::vector<int> adjacency(nTriangles * 3);
+  std::vector<int> fill(offsets);
+  for (size_t t = 0; t < nTriangles; t++)
+    for (int k = 0; k < 3; k++)
+      adjacency[fill[indices[3 * t + k]]++] = t;
+
+  std::vector<int> cachePos(nVertices, -1);
+  std::vector<float> vertexScore(nVertices);
+  for (size_t v = 0; v < nVertices; v++)
+    vertexScore[v] = _forsythScore(-1, remaining[v], cacheSize);
+
+  std::vector<float> triangleScore(nTriangles);
+  std::vector<bool> emitted(nTriangles, false);
+  for (size_t t = 0; t < nTriangles; t++)
+    triangleScore[t] = vertexScore[indices[3 * t]] +
+      vertexScore[indices[3 * t + 1]] + vertexScore[indices[3 * t + 2]];
+
+  // The simulated cache has a little extra room for the three
+  // vertices of the newest triangle.
+  std::vector<int> cache, newCache;
+  cache.reserve(cacheSize + 3);
+  newCache.reserve(cacheSize + 3);
+
+  std::vector<GLuint> out;
+  out.reserve(nTriangles * 3);
+
+  int best = std::max_element(triangleScore.begin(), triangleScore.end()) -
+    triangleScore.begin();
+  size_t cursor = 0;
+
+  for (size_t n = 0; n < nTriangles; n++) {
+
+    if (best < 0) {
+      // Nothing in the cache is attached to a triangle we haven't
+      // done yet.  Just take the next one in line.
+      while (emitted[cursor]) cursor++;
+      best = cursor;
+    }
+
+    emitted[best] = true;
+    const GLuint *tri = &indices[3 * best];
+
+    newCache.clear();
+    for (int k = 0; k < 3; k++) {
+      GLuint v = tri[k];
+      out.push_back(v);
+      newCache.push_back(v);
+
+      // Take this triangle out of the vertex's adjacency list.
+      int *begin = &adjacency[offsets[v]];
+      int *end = begin + remaining[v];
+      int *found = std::find(begin, end, best);
+      if (found != end) {
+        *found = *(end - 1);
+        remaining[v]--;
+      }
+    }
+
+    // The rest of the old cache slides down behind the new triangle.
+    for (size_t i = 0; i < cache.size(); i++) {
+      int v = cache[i];
+      if (v != (int)tri[0] && v != (int)tri[1] && v != (int)tri[2])
+        newCache.push_back(v);
+    }
+    for (size_t i = cacheSize; i < newCache.size(); i++)
+      cachePos[newCache[i]] = -1;
+
+    // Rescore the vertices that are in the cache, or just fell out of
+    // it, and the triangles they touch.  The best of those is the
+    // next one to go.
+    best = -1;
+    float bestScore = -1.0f;
+    for (size_t i = 0; i < newCache.size(); i++) {
+      int v = newCache[i];
+      if (i < (size_t)cacheSize) cachePos[v] = i;
+      float delta = _forsythScore(cachePos[v], remaining[v], cacheSize) -
+        vertexScore[v];
+      vertexScore[v] += delta;
+
+      for (int j = 0; j < remaining[v]; j++) {
+        int t = adjacency[offsets[v] + j];
+        triangleScore[t] += delta;
+        if (triangleScore[t] > bestScore) {
+          bestScore = triangleScore[t];
+          best = t;
+        }
+      }
+    }
+
+    if (newCache.size() > (size_t)cacheSize) newCache.resize(cacheSize);
+    cache.swap(newCache);
+  }
+
+  indices.swap(out);
+}
+
+float meshOptimizer::ACMR(const std::vector<GLuint> &indices,
+                          const size_t &nVertices,
+                          const int &cacheSize) {
+
+  size_t nTriangles = indices.size() / 3;
+  if (nTriangles == 0) return 0.0f;
+
+  // A FIFO cache, which is what most hardware actually has.  The
+  // timestamp says when each vertex was put into the cache.
+  std::vector<int> timestamp(nVertices, -cacheSize - 1);
+  int time = 0;
+  int misses = 0;
+
+  for (size_t i = 0; i < nTriangles * 3; i++) {
+    GLuint v = indices[i];
+    if (time - timestamp[v] > cacheSize) {
+      timestamp[v] = time++;
+      misses++;
+    }
+  }
+
+  return (float)misses / (float)nTriangles;
+}
+
+void meshOptimizer::optimizeOverdraw(std::vector<GLuint> &indices,
+                                     const std::vector<glm::vec4> &vertices,
+                                     const int &cacheSize) {
+
+  size_t nTriangles = indices.size() / 3;
+  if (nTriangles < 2) return;
+
+  // Find the places where all three vertices of a triangle miss the
+  // cache.  The cache is starting over there, so we can cut the list
+  // into clusters and shuffle them at little cost.
+  std::vector<size_t> clusterStart;
+  std::vector<int> timestamp(vertices.size(), -cacheSize - 1);
+  int time = 0;
+  for (size_t t = 0; t < nTriangles; t++) {
+    int misses = 0;
+    for (int k = 0; k < 3; k++) {
+      GLuint v = indices[3 * t + k];
+      if (time - timestamp[v] > cacheSize) {
+        timestamp[v] = time++;
+        misses++;
+      }
+    }
+    if (misses == 3) clusterStart.push_back(t);
+  }
+  clusterStart.push_back(nTriangles);
+
+  if (clusterStart.size() < 3) return;
+
+  // The center of the whole mesh.
+  glm::vec3 meshCenter = glm::vec3(0.0f);
+  float meshArea = 0.0f;
+
+  // Each cluster gets a center and an average normal, and the sort
+  // key is how far it faces away from the mesh center.
+  std::vector<glm::vec3> clusterCenter(clusterStart.size() - 1);
+  std::vector<glm::vec3> clusterNormal(clusterStart.size() - 1);
+
+  for (size_t c = 0; c < clusterStart.size() - 1; c++) {
+    glm::vec3 center = glm::vec3(0.0f);
+    glm::vec3 normal = glm::vec3(0.0f);
+    float area = 0.0f;
+
+    for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; t++) {
+      glm::vec3 a = glm::vec3(vertices[indices[3 * t]]);
+      glm::vec3 b = glm::vec3(vertices[indices[3 * t + 1]]);
+      glm::vec3 d = glm::vec3(vertices[indices[3 * t + 2]]);
+
+      // The cross product is twice the area, in the direction of the
+      // normal, so this is an area-weighted sum.
+      glm::vec3 n = glm::cross(b - a, d - a);
+      float triArea = glm::length(n);
+
+      center += (a + b + d) * (triArea / 3.0f);
+      normal += n;
+      area += triArea;
+    }
+
+    meshCenter += center;
+    meshArea += area;
+
+    clusterCenter[c] = (area > 0.0f) ? center / area : center;
+    clusterNormal[c] = normal;
+  }
+
+  if (meshArea > 0.0f) meshCenter /= meshArea;
+
+  std::vector<std::pair<float, size_t> > order(clusterStart.size() - 1);
+  for (size_t c = 0; c < order.size(); c++) {
+    float len = glm::length(clusterNormal[c]);
+    glm::vec3 n = (len > 0.0f) ? clusterNormal[c] / len : clusterNormal[c];
+    // Negative, so the sort puts the most outward clusters first.
+    order[c] = std::pair<float, size_t>(-glm::dot(clusterCenter[c] - meshCenter, n), c);
+  }
+  std::stable_sort(order.begin(), order.end());
+
+  std::vector<GLuint> out;
+  out.reserve(indices.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    size_t c = order[i].second;
+    out.insert(out.end(),
+               indices.begin() + 3 * clusterStart[c],
+               indices.begin() + 3 * clusterStart[c + 1]);
+  }
+
+  indices.swap(out);
+}
+
+void meshOptimizer::optimizeVertexFetch(bsgPtr<drawableObj> obj) {
+
+  std::vector<GLuint> indices = obj->getIndices();
+  if (indices.empty()) return;
+
+  std::vector<glm::vec4> vertices = obj->getData(GLDATA_VERTICES);
+  std::vector<glm::vec4> colors = obj->getData(GLDATA_COLORS);
+  std::vector<glm::vec4> normals = obj->getData(GLDATA_NORMALS);
+  std::vector<glm::vec2> uvs = obj->getTexCoords();
+
+  // Number the vertices in the order they are first used.
+  const GLuint unused = ~0u;
+  std::vector<GLuint> remap(vertices.size(), unused);
+  std::vector<GLuint> order;
+  order.reserve(vertices.size());
+
+  for (size_t i = 0; i < indices.size(); i++) {
+    GLuint v = indices[i];
+    if (remap[v] == unused) {
+      remap[v] = order.size();
+      order.push_back(v);
+    }
+    indices[i] = remap[v];
+  }
+
+  std::vector<glm::vec4> newVertices(order.size());
+  std::vector<glm::vec4> newColors(colors.empty() ? 0 : order.size());
+  std::vector<glm::vec4> newNormals(normals.empty() ? 0 : order.size());
+  std::vector<glm::vec2> newUVs(uvs.empty() ? 0 : order.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    newVertices[i] = vertices[order[i]];
+    if (!colors.empty()) newColors[i] = colors[order[i]];
+    if (!normals.empty()) newNormals[i] = normals[order[i]];
+    if (!uvs.empty()) newUVs[i] = uvs[order[i]];
+  }
+
+  obj->setData(GLDATA_VERTICES, newVertices);
+  if (!colors.empty()) obj->setData(GLDATA_COLORS, newColors);
+  if (!normals.empty()) obj->setData(GLDATA_NORMALS, newNormals);
+  if (!uvs.empty()) obj->setData(GLDATA_TEXCOORDS, newUVs);
+  obj->setIndices(indices);
+}
+
+// A symmetric 4x4 matrix, representing the sum of the squared
+// distances from a point to a set of planes.
+struct _quadric {
+  double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+
+  _quadric() : a2(0), ab(0), ac(0), ad(0), b2(0), bc(0), bd(0),
+               c2(0), cd(0), d2(0) {};
+
+  // The plane ax + by + cz + d = 0, with (a,b,c) a unit vector.
+  void addPlane(const glm::vec3 &n, const float &d, const float &weight) {
+    a2 += weight * n.x * n.x; ab += weight * n.x * n.y;
+    ac += weight * n.x * n.z; ad += weight * n.x * d;
+    b2 += weight * n.y * n.y; bc += weight * n.y * n.z;
+    bd += weight * n.y * d;   c2 += weight * n.z * n.z;
+    cd += weight * n.z * d;   d2 += weight * d * d;
+  }
+
+  void add(const _quadric &q) {
+    a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad; b2 += q.b2;
+    bc += q.bc; bd += q.bd; c2 += q.c2; cd += q.cd; d2 += q.d2;
+  }
+
+  double evaluate(const glm::vec3 &p) const {
+    double x = p.x, y = p.y, z = p.z;
+    double out = a2*x*x + 2*ab*x*y + 2*ac*x*z + 2*ad*x
+      + b2*y*y + 2*bc*y*z + 2*bd*y
+      + c2*z*z + 2*cd*z
+      + d2;
+    // Rounding can make this a tiny bit negative.
+    return (out > 0.0) ? out : 0.0;
+  }
+};
+
+// A candidate edge collapse, moving position "from" onto position
+// "to".  The versions tell us whether either end has changed since
+// the cost was computed.
+struct _collapse {
+  double cost;
+  int from, to;
+  unsigned int fromVersion, toVersion;
+
+  bool operator>(const _collapse &other) const { return cost > other.cost; }
+};
+
+bsgPtr<drawableObj> meshOptimizer::simplify(bsgPtr<drawableObj> obj,
+                                            const float &ratio,
+                                            float &error) {
+
+  error = 0.0f;
+
+  // We work on a copy, with no buffers of its own yet, since the
+  // original may already have been prepared.
+  bsgPtr<drawableObj> out = obj->copy();
+  if (out->getDrawType() != GL_TRIANGLES) return out;
+  if (!out->isIndexed()) weld(out);
+
+  std::vector<glm::vec4> vertices = out->getData(GLDATA_VERTICES);
+  std::vector<glm::vec4> normals = out->getData(GLDATA_NORMALS);
+  std::vector<glm::vec2> uvs = out->getTexCoords();
+  std::vector<GLuint> indices = out->getIndices();
+
+  size_t nTriangles = indices.size() / 3;
+  size_t target = (size_t)(nTriangles * ratio);
+  if (target >= nTriangles) return out;
+
+  // Group the vertices by position.  The vertices at one position
+  // are called its "wedges".
+  _positionMap positionMap(vertices.size());
+  std::vector<int> posID(vertices.size());
+  std::vector<glm::vec3> positions;
+  std::vector<std::vector<GLuint> > wedges;
+  for (size_t v = 0; v < vertices.size(); v++) {
+    _positionKey key;
+    for (int j = 0; j < 3; j++) key.data[j] = vertices[v][j] + 0.0f;
+    _positionMap::iterator it = positionMap.find(key);
+    if (it == positionMap.end()) {
+      posID[v] = positions.size();
+      positionMap[key] = positions.size();
+      positions.push_back(glm::vec3(vertices[v]));
+      wedges.push_back(std::vector<GLuint>());
+    } else {
+      posID[v] = it->second;
+    }
+    wedges[posID[v]].push_back(v);
+  }
+  size_t nPositions = positions.size();
+
+  // The triangles around each position, and the quadrics.
+  std::vector<std::vector<int> > around(nPositions);
+  std::vector<_quadric> quadrics(nPositions);
+  std::map<std::pair<int, int>, int> edgeCount;
+  std::vector<glm::vec3> faceNormals(nTriangles);
+
+  for (size_t t = 0; t < nTriangles; t++) {
+    int p[3];
+    for (int k = 0; k < 3; k++) {
+      p[k] = posID[indices[3 * t + k]];
+      around[p[k]].push_back(t);
+    }
+
+    glm::vec3 n = glm::cross(positions[p[1]] - positions[p[0]],
+                             positions[p[2]] - positions[p[0]]);
+    float len = glm::length(n);
+    if (len > 0.0f) {
+      n /= len;
+      for (int k = 0; k < 3; k++)
+        quadrics[p[k]].addPlane(n, -glm::dot(n, positions[p[0]]), 1.0f);
+    }
+    faceNormals[t] = n;
+
+    for (int k = 0; k < 3; k++) {
+      int a = p[k], b = p[(k + 1) % 3];
+      edgeCount[std::pair<int, int>(std::min(a, b), std::max(a, b))]++;
+    }
+  }
+
+  // An edge used by only one triangle is on the boundary.  Add a
+  // plane perpendicular to the triangle along the edge, weighted
+  // heavily, so the boundary stays where it is.
+  std::vector<bool> onBoundary(nPositions, false);
+  for (size_t t = 0; t < nTriangles; t++) {
+    for (int k = 0; k < 3; k++) {
+      int a = posID[indices[3 * t + k]];
+      int b = posID[indices[3 * t + (k + 1) % 3]];
+      if (edgeCount[std::pair<int, int>(std::min(a, b), std::max(a, b))] != 1)
+        continue;
+
+      glm::vec3 n = glm::cross(positions[b] - positions[a], faceNormals[t]);
+      float len = glm::length(n);
+      if (len == 0.0f) continue;
+      n /= len;
+      float d = -glm::dot(n, positions[a]);
+      quadrics[a].addPlane(n, d, 10.0f);
+      quadrics[b].addPlane(n, d, 10.0f);
+      onBoundary[a] = true;
+      onBoundary[b] = true;
+    }
+  }
+
+  std::vector<bool> alive(nPositions, true);
+  std::vector<bool> triangleAlive(nTriangles, true);
+  std::vector<unsigned int> version(nPositions, 0);
+
+  std::priority_queue<_collapse, std::vector<_collapse>,
+                      std::greater<_collapse> > queue;
+
+  for (size_t t = 0; t < nTriangles; t++) {
+    for (int k = 0; k < 3; k++) {
+      int a = posID[indices[3 * t + k]];
+      int b = posID[indices[3 * t + (k + 1) % 3]];
+      if (a == b) continue;
+      for (int dir = 0; dir < 2; dir++) {
+        _collapse c;
+        c.from = dir ? b : a;
+        c.to = dir ? a : b;
+        _quadric q = quadrics[c.from];
+        q.add(quadrics[c.to]);
+        c.cost = q.evaluate(positions[c.to]);
+        c.fromVersion = 0; c.toVersion = 0;
+        queue.push(c);
+      }
+    }
+  }
+
+  size_t nLive = nTriangles;
+  double maxCost = 0.0;
+
+  while (nLive > target && !queue.empty()) {
+
+    _collapse c = queue.top();
+    queue.pop();
+
+    // Ignore stale entries.
+    if (!alive[c.from] || !alive[c.to] ||
+        version[c.from] != c.fromVersion || version[c.to] != c.toVersion)
+      continue;
+
+    // Don't drag a boundary vertex off its boundary into the interior.
+    if (onBoundary[c.from] && !onBoundary[c.to]) continue;
+
+    // Check that no surviving triangle gets flipped over.
+    bool flips = false;
+    for (size_t i = 0; i < around[c.from].size() && !flips; i++) {
+      int t = around[c.from][i];
+      if (!triangleAlive[t]) continue;
+
+      glm::vec3 p[3];
+      bool hasTo = false;
+      for (int k = 0; k < 3; k++) {
+        int pk = posID[indices[3 * t + k]];
+        if (pk == c.to) hasTo = true;
+        p[k] = positions[pk == c.from ? c.to : pk];
+      }
+      if (hasTo) continue;
+
+      glm::vec3 n = glm::cross(p[1] - p[0], p[2] - p[0]);
+      if (glm::dot(faceNormals[t], faceNormals[t]) > 0.0f &&
+          glm::dot(n, faceNormals[t]) <= 0.0f) flips = true;
+    }
+    if (flips) continue;
+
+    // Each wedge at the old position moves to the most similar
+    // wedge at the new position.
+    std::map<GLuint, GLuint> moveTo;
+    for (size_t i = 0; i < wedges[c.from].size(); i++) {
+      GLuint v = wedges[c.from][i];
+      GLuint best = wedges[c.to][0];
+      float bestDist = 1.0e35f;
+      for (size_t j = 0; j < wedges[c.to].size(); j++) {
+        GLuint w = wedges[c.to][j];
+        float dist = 0.0f;
+        if (!normals.empty()) {
+          glm::vec3 dn = glm::vec3(normals[v] - normals[w]);
+          dist += glm::dot(dn, dn);
+        }
+        if (!uvs.empty()) {
+          glm::vec2 duv = uvs[v] - uvs[w];
+          dist += glm::dot(duv, duv);
+        }
+        if (dist < bestDist) {
+          bestDist = dist;
+          best = w;
+        }
+      }
+      moveTo[v] = best;
+    }
+
+    // Collapse.  The triangles that had the edge disappear, and the
+    // rest get their corners moved.
+    for (size_t i = 0; i < around[c.from].size(); i++) {
+      int t = around[c.from][i];
+      if (!triangleAlive[t]) continue;
+
+      bool hasTo = false;
+      for (int k = 0; k < 3; k++)
+        if (posID[indices[3 * t + k]] == c.to) hasTo = true;
+
+      if (hasTo) {
+        triangleAlive[t] = false;
+        nLive--;
+      } else {
+        for (int k = 0; k < 3; k++)
+          if (posID[indices[3 * t + k]] == c.from)
+            indices[3 * t + k] = moveTo[indices[3 * t + k]];
+        faceNormals[t] = glm::cross(
+          positions[posID[indices[3 * t + 1]]] - positions[posID[indices[3 * t]]],
+          positions[posID[indices[3 * t + 2]]] - positions[posID[indices[3 * t]]]);
+        around[c.to].push_back(t);
+      }
+    }
+
+    alive[c.from] = false;
+    around[c.from].clear();
+    quadrics[c.to].add(quadrics[c.from]);
+    version[c.to]++;
+    maxCost = std::max(maxCost, c.cost);
+
+    // Requeue the edges around the new position.
+    for (size_t i = 0; i < around[c.to].size(); i++) {
+      int t = around[c.to][i];
+      if (!triangleAlive[t]) continue;
+      for (int k = 0; k < 3; k++) {
+        int other = posID[indices[3 * t + k]];
+        if (other == c.to) continue;
+        for (int dir = 0; dir < 2; dir++) {
+          _collapse n;
+          n.from = dir ? other : c.to;
+          n.to = dir ? c.to : other;
+          _quadric q = quadrics[n.from];
+          q.add(quadrics[n.to]);
+          n.cost = q.evaluate(positions[n.to]);
+          n.fromVersion = version[n.from];
+          n.toVersion = version[n.to];
+          queue.push(n);
+        }
+      }
+    }
+  }
+
+  std::vector<GLuint> newIndices;
+  newIndices.reserve(nLive * 3);
+  for (size_t t = 0; t < nTriangles; t++) {
+    if (!triangleAlive[t]) continue;
+    newIndices.push_back(indices[3 * t]);
+    newIndices.push_back(indices[3 * t + 1]);
+    newIndices.push_back(indices[3 * t + 2]);
+  }
+
+  optimizeVertexCache(newIndices, vertices.size());
+  out->setIndices(newIndices);
+  optimizeVertexFetch(out);
+  out->findBoundingBox();
+
+  error = sqrt(maxCost);
+  return out;
+}
+
+void meshOptimizer::optimize(bsgPtr<drawableObj> obj,
+                             const bool &overdraw,
+                             const bool &verbose) {
+
+  if (obj->getDrawType() != GL_TRIANGLES) return;
+
+  size_t nBefore = obj->getData(GLDATA_VERTICES).size();
+  float acmrBefore = obj->isIndexed() ?
+    ACMR(obj->getIndices(), nBefore) : 3.0f;
+
+  size_t nVertices = weld(obj);
+  std::vector<GLuint> indices = obj->getIndices();
+  float acmrWelded = ACMR(indices, nVertices);
+
+  optimizeVertexCache(indices, nVertices);
+  if (overdraw)
+    optimizeOverdraw(indices, obj->getData(GLDATA_VERTICES));
+  obj->setIndices(indices);
+
+  optimizeVertexFetch(obj);
+
+  if (verbose) {
+    std::cout << "    vertices: " << nBefore << " -> " << nVertices
+              << ", triangles: " << indices.size() / 3 << std::endl;
+    std::cout << "    ACMR: " << acmrBefore << " (original), "
+              << acmrWelded << " (welded), "
+              << ACMR(obj->getIndices(), nVertices) << " (optimized)"
+              << std::endl;
+  }
+}
+
+}
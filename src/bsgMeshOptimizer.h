@@ -0,0 +1,114 @@
+#ifndef BSGMESHOPTIMIZER
+#define BSGMESHOPTIMIZER
+
+#include "bsg.h"
+
+namespace bsg {
+
+/// \class meshOptimizer
+/// \brief Reorganizes triangle meshes for faster drawing.
+///
+/// A mesh fresh out of a file is usually a list of independent
+/// triangles, with every shared vertex repeated once for each
+/// triangle that uses it.  The GPU then transforms each of those
+/// copies separately.  These functions turn such a mesh into an
+/// indexed one with a single copy of each distinct vertex, then put
+/// the triangles into an order that lets the GPU's post-transform
+/// vertex cache catch most of the repeats, and finally put the
+/// vertices into the order in which they are fetched.
+///
+/// The usual measure of the result is the ACMR, the average cache
+/// miss ratio: the number of vertices transformed per triangle.  An
+/// unindexed triangle list has an ACMR of 3.0.  A well-ordered
+/// regular mesh can get down to somewhere around 0.6 or 0.7.
+///
+/// All of this has to happen before the object is prepared, since
+/// that's when its data is set up for the GPU.  Only GL_TRIANGLES
+/// objects are handled; anything else is left alone.
+class meshOptimizer {
+ public:
+
+  /// The size of the LRU cache assumed by the triangle ordering.
+  static const int orderCacheSize = 32;
+
+  /// The size of the FIFO cache used to compute the ACMR.  This is a
+  /// conservative guess at real hardware.
+  static const int measureCacheSize = 16;
+
+  /// \brief Merge identical vertices into one, using an index array.
+  ///
+  /// Two vertices are identical if all of their data (position,
+  /// color, normal, and texture coordinates) match exactly.
+  /// Degenerate triangles, with two corners on the same vertex, are
+  /// dropped.  If the object is already indexed, the existing index
+  /// array is remapped.  Returns the number of distinct vertices.
+  static size_t weld(bsgPtr<drawableObj> obj);
+
+  /// \brief Reorder triangles for the post-transform vertex cache.
+  ///
+  /// This is Tom Forsyth's "Linear-Speed Vertex Cache Optimisation".
+  /// Each vertex gets a score based on its position in a simulated
+  /// LRU cache and on how many triangles still need it, and the
+  /// triangle with the highest total score is emitted next.
+  static void optimizeVertexCache(std::vector<GLuint> &indices,
+                                  const size_t &nVertices,
+                                  const int &cacheSize = orderCacheSize);
+
+  /// \brief Reorder clusters of triangles to reduce overdraw.
+  ///
+  /// The (cache-ordered) triangle list is cut into clusters at the
+  /// points where the cache would be starting over anyway, so this
+  /// doesn't hurt the ACMR much.  The clusters are then sorted so
+  /// that the ones facing out from the center of the mesh are drawn
+  /// first, and are likely to hide the ones drawn later, which can
+  /// then be rejected by the depth test before shading.
+  static void optimizeOverdraw(std::vector<GLuint> &indices,
+                               const std::vector<glm::vec4> &vertices,
+                               const int &cacheSize = measureCacheSize);
+
+  /// \brief Reorder the vertex data in the order it is used.
+  ///
+  /// Makes the vertex fetches run through memory more or less
+  /// sequentially.  Vertices that aren't used are dropped.
+  static void optimizeVertexFetch(bsgPtr<drawableObj> obj);
+
+  /// \brief Compute the average cache miss ratio of a triangle list.
+  static float ACMR(const std::vector<GLuint> &indices,
+                    const size_t &nVertices,
+                    const int &cacheSize = measureCacheSize);
+
+  /// \brief Make a simplified copy of a triangle mesh.
+  ///
+  /// This is the Garland-Heckbert quadric error method.  Each vertex
+  /// accumulates the planes of the triangles around it, and the edge
+  /// whose collapse moves a vertex the least distance from those
+  /// planes is collapsed first, until only the given fraction of
+  /// the triangles is left.  The edges of open meshes get extra
+  /// planes so the outline doesn't shrink away.
+  ///
+  /// The collapses are done on positions, so a model whose normals
+  /// or texture coordinates are split along seams still simplifies.
+  /// The other data of a moved vertex is taken from the most similar
+  /// vertex at its new position.
+  ///
+  /// The input is left alone.  The returned error is roughly the
+  /// largest distance, in model units, between the simplified
+  /// surface and the original one.  The copy comes back already
+  /// ordered for the vertex cache, and must be prepared separately.
+  static bsgPtr<drawableObj> simplify(bsgPtr<drawableObj> obj,
+                                      const float &ratio,
+                                      float &error);
+
+  /// \brief Run all of the above on an object.
+  ///
+  /// Welds, orders for the vertex cache, optionally orders for
+  /// overdraw, and then orders for vertex fetch.  If verbose is
+  /// true, the before and after ACMR is printed.
+  static void optimize(bsgPtr<drawableObj> obj,
+                       const bool &overdraw = true,
+                       const bool &verbose = false);
+};
+
+}
+
+#endif
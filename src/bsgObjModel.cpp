@@ -4,16 +4,48 @@ namespace bsg {
 
 drawableObjModel::drawableObjModel(bsgPtr<shaderMgr> pShader,
                                    const std::string &fileName)
-  : drawableCompound(pShader), _fileName(fileName), _includeBackFace(true) {
+  : drawableCompound(pShader), _fileName(fileName), _includeBackFace(true),
+    _optimize(true), _optimized(false), _lodLevels(0), _lodRatio(0.25f) {
   _processObjFile();
 }
    
 drawableObjModel::drawableObjModel(bsgPtr<shaderMgr> pShader,
                                    const std::string &fileName,
                                    const bool &back)
-  : drawableCompound(pShader), _fileName(fileName), _includeBackFace(back) {
+  : drawableCompound(pShader), _fileName(fileName), _includeBackFace(back),
+    _optimize(true), _optimized(false), _lodLevels(0), _lodRatio(0.25f) {
   _processObjFile();
 }
+
+drawableObjModel::drawableObjModel(bsgPtr<shaderMgr> pShader,
+                                   const std::string &fileName,
+                                   const bool &back,
+                                   const bool &optimize)
+  : drawableCompound(pShader), _fileName(fileName), _includeBackFace(back),
+    _optimize(optimize), _optimized(false), _lodLevels(0), _lodRatio(0.25f) {
+  _processObjFile();
+}
+
+drawableObjModel::drawableObjModel(bsgPtr<shaderMgr> pShader,
+                                   const std::string &fileName,
+                                   const bool &back,
+                                   const bool &optimize,
+                                   const int &lodLevels,
+                                   const float &lodRatio)
+  : drawableCompound(pShader), _fileName(fileName), _includeBackFace(back),
+    _optimize(optimize), _optimized(false), _lodLevels(lodLevels),
+    _lodRatio(lodRatio) {
+  _processObjFile();
+}
+
+void drawableObjModel::optimizeMesh(const bool &overdraw) {
+
+  if (_optimized) return;
+
+  std::cout << "Optimizing: " << _fileName << " ..." << std::endl;
+  meshOptimizer::optimize(_frontFace, overdraw, true);
+  _optimized = true;
+}
    
 void drawableObjModel::_processObjFile() {
 
@@ -185,13 +217,12 @@ void drawableObjModel::_processObjFile() {
   std::vector<glm::vec4> frontFaceColors = std::vector<glm::vec4>(nEntries);
   std::vector<glm::vec4> frontFaceNormals = std::vector<glm::vec4>(nEntries);
   std::vector<glm::vec2> frontFaceUVs = std::vector<glm::vec2>(nEntries);
-  std::vector<glm::vec4> backFaceVertices = std::vector<glm::vec4>(nEntries);
-  std::vector<glm::vec4> backFaceColors = std::vector<glm::vec4>(nEntries);
-  std::vector<glm::vec4> backFaceNormals = std::vector<glm::vec4>(nEntries);
-  std::vector<glm::vec2> backFaceUVs = std::vector<glm::vec2>(nEntries);
 
   _frontFace = new drawableObj();
-  if (_includeBackFace) _backFace = new drawableObj();
+
+  // The interior is shown by drawing the same triangles two-sided,
+  // rather than by a second set of reversed triangles.
+  setTwoSided(_includeBackFace);
   
   glm::vec2 genericUV = glm::vec2(0.0f, 0.0f);
 
@@ -214,11 +245,6 @@ void drawableObjModel::_processObjFile() {
       frontFaceVertices[writePos + 1] = vert_list[face_list[matIndex][j + 3]];
       frontFaceVertices[writePos + 2] = vert_list[face_list[matIndex][j + 6]];
 
-      // Add back-facing triangle by flipping the order of the last two vertices
-      backFaceVertices[writePos] = vert_list[face_list[matIndex][j]];
-      backFaceVertices[writePos + 1] = vert_list[face_list[matIndex][j + 6]];
-      backFaceVertices[writePos + 2] = vert_list[face_list[matIndex][j + 3]];
-
       if (!(face_list[matIndex][j + 1] < 0 || face_list[matIndex][j + 4] < 0 ||
             face_list[matIndex][j + 7] < 0)) {
         // All texture coordinate indices are valid (>= 0)
@@ -226,21 +252,12 @@ void drawableObjModel::_processObjFile() {
         frontFaceUVs[writePos] = uv_list[face_list[matIndex][j + 1]];
         frontFaceUVs[writePos + 1] = uv_list[face_list[matIndex][j + 4]];
         frontFaceUVs[writePos + 2] = uv_list[face_list[matIndex][j + 7]];
-
-        // Add back-facing triangle UVs by flipping the order of the last two
-        // vertices
-        backFaceUVs[writePos] = uv_list[face_list[matIndex][j + 1]];
-        backFaceUVs[writePos + 1] = uv_list[face_list[matIndex][j + 7]];
-        backFaceUVs[writePos + 2] = uv_list[face_list[matIndex][j + 4]];
       } else {
         // At least one texture coordinate index was invalid, store generic
         // texture coordinates
         frontFaceUVs[writePos] = genericUV;
         frontFaceUVs[writePos + 1] = genericUV;
         frontFaceUVs[writePos + 2] = genericUV;
-        backFaceUVs[writePos] = genericUV;
-        backFaceUVs[writePos + 1] = genericUV;
-        backFaceUVs[writePos + 2] = genericUV;
       }
 
       if (!(face_list[matIndex][j + 2] < 0 || face_list[matIndex][j + 5] < 0 ||
@@ -252,13 +269,6 @@ void drawableObjModel::_processObjFile() {
             normal_list[face_list[matIndex][j + 5]];
         frontFaceNormals[writePos + 2] =
             normal_list[face_list[matIndex][j + 8]];
-
-        // Add back-facing triangle normals by negating front facing ones
-        backFaceNormals[writePos] = -normal_list[face_list[matIndex][j + 2]];
-        backFaceNormals[writePos + 1] =
-            -normal_list[face_list[matIndex][j + 5]];
-        backFaceNormals[writePos + 2] =
-            -normal_list[face_list[matIndex][j + 8]];
       } else {
         // At least one normal index was invalid, calculate face normal from
         // vertex data
@@ -272,11 +282,6 @@ void drawableObjModel::_processObjFile() {
         frontFaceNormals[writePos] = faceNormal;
         frontFaceNormals[writePos + 1] = faceNormal;
         frontFaceNormals[writePos + 2] = faceNormal;
-
-        // Add back-facing triangle normals by negating front facing ones
-        backFaceNormals[writePos] = -faceNormal;
-        backFaceNormals[writePos + 1] = -faceNormal;
-        backFaceNormals[writePos + 2] = -faceNormal;
       }
     }
   }
@@ -287,22 +292,49 @@ void drawableObjModel::_processObjFile() {
   _frontFace->addData(bsg::GLDATA_TEXCOORDS, "texture", frontFaceUVs);
   _frontFace->setDrawType(GL_TRIANGLES, frontFaceVertices.size());
 
-  _backFace->addData(bsg::GLDATA_VERTICES, "position", backFaceVertices);
-  _backFace->addData(bsg::GLDATA_COLORS, "color", backFaceColors);
-  _backFace->addData(bsg::GLDATA_NORMALS, "normal", backFaceNormals);
-  _backFace->addData(bsg::GLDATA_TEXCOORDS, "texture", backFaceUVs);
-  _backFace->setDrawType(GL_TRIANGLES, backFaceVertices.size());
 
-  
   _frontFace->setInterleaved(true);
   addObject(_frontFace);
 
-  if (_includeBackFace) {
-    _backFace->setInterleaved(true);
-    addObject(_backFace);
+  std::cout << "... " << _fileName << " done." << std::endl;
+
+  if (_optimize) optimizeMesh();
+  if (_lodLevels > 0) _buildLOD();
+}
+
+void drawableObjModel::_buildLOD() {
+
+  drawableLOD *lod = new drawableLOD(_name + "LOD");
+  _lod = lod;
+
+  glm::vec4 center = 0.5f * (_frontFace->getBoundingBoxLower() +
+                             _frontFace->getBoundingBoxUpper());
+  lod->setCenter(glm::vec3(center));
+
+  bsgPtr<drawableObj> obj = _frontFace;
+  float error = 0.0f;
+  for (int i = 0; i <= _lodLevels; i++) {
+
+    if (i > 0) {
+      // The errors add up, since each level is made from the last.
+      float levelError;
+      obj = meshOptimizer::simplify(obj, _lodRatio, levelError);
+      error += levelError;
+    }
+
+    drawableCompound *level = new drawableCompound(_pShader);
+    level->setTwoSided(_twoSided);
+    level->addObject(obj);
+    lod->addLevel(level, error);
   }
+}
 
-  std::cout << "... " << _fileName << " done." << std::endl;
+bsgPtr<drawableMulti> drawableObjModel::getLOD() {
+
+  if (!_lod)
+    throw std::runtime_error(_fileName + " was read without levels of detail.");
+
+  return _lod;
 }
 
 std::vector<std::string> drawableObjModel::split(const std::string line,
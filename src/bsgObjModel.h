@@ -1,4 +1,5 @@
 #include "bsg.h"
+#include "bsgMeshOptimizer.h"
 #include <algorithm>
 #include <fstream>
 #include <iostream>
@@ -11,12 +12,27 @@ class drawableObjModel : public drawableCompound {
 
 private:
   const std::string &_fileName;
-  bsgPtr<drawableObj> _frontFace, _backFace;
+  bsgPtr<drawableObj> _frontFace;
 
   // Do we *want* to see the interior?  Set this to false to show only
-  // the object exterior, a simple optimization for big models.
+  // the object exterior.  If it's true, the model is drawn two-sided,
+  // which costs the same as drawing one side.
   bool _includeBackFace;
 
+  // Should the mesh be optimized as soon as it is read?  And has it
+  // been optimized yet?
+  bool _optimize;
+  bool _optimized;
+
+  // How many simplified versions of this model to make as it is
+  // read, and how much smaller each is than the one before.  The
+  // chain is kept with the model.
+  int _lodLevels;
+  float _lodRatio;
+  bsgPtr<drawableMulti> _lod;
+
+  void _buildLOD();
+
   std::vector<std::string> split(const std::string line, const char separator);
 
   // So we can have two different constructors.
@@ -27,6 +43,46 @@ public:
   drawableObjModel(bsgPtr<shaderMgr> pShader,
                    const std::string &fileName,
                    const bool &back);
+  /// \brief Read a model, optionally without optimizing it.
+  ///
+  /// By default, the mesh is welded into an indexed one and ordered
+  /// for the vertex cache as it is read.  Set optimize to false to
+  /// keep the triangles exactly as they appear in the file; you can
+  /// still call optimizeMesh() later.
+  drawableObjModel(bsgPtr<shaderMgr> pShader,
+                   const std::string &fileName,
+                   const bool &back,
+                   const bool &optimize);
+
+  /// \brief Optimize the mesh for drawing.
+  ///
+  /// See meshOptimizer for the details.  This must be called before
+  /// the model is prepared, and does nothing if the mesh has already
+  /// been optimized.
+  void optimizeMesh(const bool &overdraw = true);
+
+  /// \brief Read a model, and simplify it into levels of detail.
+  ///
+  /// As well as reading (and optionally optimizing) the mesh, this
+  /// simplifies it into a chain of lodLevels coarser versions, each
+  /// with about lodRatio times the triangles of the one before.  Use
+  /// getLOD() to get them.
+  drawableObjModel(bsgPtr<shaderMgr> pShader,
+                   const std::string &fileName,
+                   const bool &back,
+                   const bool &optimize,
+                   const int &lodLevels,
+                   const float &lodRatio = 0.25f);
+
+  /// \brief Returns a level-of-detail node for this model.
+  ///
+  /// The levels are the ones made when the model was read, all in a
+  /// drawableLOD, with the full model as its first level.  Every call
+  /// returns the same node.  Add the node to the scene *instead* of
+  /// the model itself; you can use bPtr(drawableLOD, ...) to adjust
+  /// its settings.  Throws an exception if the model was read without
+  /// levels of detail.
+  bsgPtr<drawableMulti> getLOD();
 
 };
 
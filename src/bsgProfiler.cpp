@@ -0,0 +1,391 @@
+#include "bsgProfiler.h"
+#include <unordered_map>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <algorithm>
+
+namespace bsg {
+
+bool profiler::_enabled = false;
+
+static int64_t profileNow() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// One scope, in the order they were started.
+struct profileEvent {
+  const char *name;
+  int64_t start, end;
+  int depth;
+};
+
+// A GPU query waiting for its answer, and when it was started on
+// the CPU.
+struct profileQuery {
+  const char *name;
+  GLuint id;
+  int64_t start;
+};
+
+// What a name adds up to, over a frame or over all of them.
+struct profileTotal {
+  int calls;
+  int64_t cpuNs, selfNs, gpuNs;
+  profileTotal() : calls(0), cpuNs(0), selfNs(0), gpuNs(0) {};
+};
+typedef std::unordered_map<const char*, profileTotal> profileTotals;
+
+// A scope kept for the trace.
+struct profileTraceEvent {
+  const char *name;
+  int64_t start, duration;
+  bool gpu;
+};
+
+static struct profileState {
+  // This frame's scopes, and the ones that haven't ended yet.
+  std::vector<profileEvent> events;
+  std::vector<int> open;
+  std::vector<int> parents;
+  int64_t frameStart;
+  int64_t frameNs;
+
+  // The last frame, and the sums of all of them.  The names are
+  // never removed from the maps, just set to zero, so a frame doesn't
+  // allocate anything once the names have all been seen.
+  profileTotals frame, total;
+  int64_t totalFrameNs;
+  int frames;
+
+  // The queries started this frame and the last one.  The last
+  // frame's are read when this one ends, and the ones not ready are
+  // dropped rather than waited for.
+  std::vector<profileQuery> queries[2];
+  std::vector<GLuint> spareQueries;
+  int slot;
+  bool gpuActive;
+  int timerQueries;
+  int dropped;
+  bool warnedNesting;
+
+  std::vector<profileTraceEvent> trace;
+  int traceFrames;
+  int64_t traceStart;
+
+  profileState() : frameStart(0), frameNs(0), totalFrameNs(0), frames(0),
+                   slot(0), gpuActive(false), timerQueries(-1), dropped(0),
+                   warnedNesting(false), traceFrames(0), traceStart(0) {};
+} _profile;
+
+void profiler::setEnabled(const bool &enabled) {
+
+  if (enabled && !_enabled) {
+    _profile.events.clear();
+    _profile.open.clear();
+    _profile.frameStart = profileNow();
+  }
+  _enabled = enabled;
+}
+
+void profiler::begin(const char *name) {
+
+  profileEvent event;
+  event.name = name;
+  event.depth = _profile.open.size();
+  _profile.open.push_back(_profile.events.size());
+  event.start = event.end = profileNow();
+  _profile.events.push_back(event);
+}
+
+void profiler::end() {
+
+  if (_profile.open.empty()) return;
+  _profile.events[_profile.open.back()].end = profileNow();
+  _profile.open.pop_back();
+}
+
+bool profiler::beginGPU(const char *name) {
+
+  // Timer queries can't be nested.
+  if (_profile.gpuActive) return false;
+
+  // 1 for GL 3.3 or ARB_timer_query, 2 for EXT_timer_query, which
+  // is all an old Mac has.
+  if (_profile.timerQueries < 0) {
+    if (GLEW_ARB_timer_query) {
+      _profile.timerQueries = 1;
+    } else if (GLEW_EXT_timer_query) {
+      _profile.timerQueries = 2;
+    } else {
+      _profile.timerQueries = 0;
+      std::cerr << "Caution: There are no GPU timer queries here, "
+                << "so the profiler will only show CPU times." << std::endl;
+    }
+  }
+  if (_profile.timerQueries == 0) return false;
+
+  profileQuery query;
+  query.name = name;
+  if (_profile.spareQueries.empty()) {
+    glGenQueries(1, &query.id);
+  } else {
+    query.id = _profile.spareQueries.back();
+    _profile.spareQueries.pop_back();
+  }
+  query.start = profileNow();
+
+  glBeginQuery(GL_TIME_ELAPSED, query.id);
+  _profile.queries[_profile.slot].push_back(query);
+  _profile.gpuActive = true;
+  return true;
+}
+
+void profiler::endGPU() {
+
+  glEndQuery(GL_TIME_ELAPSED);
+  _profile.gpuActive = false;
+}
+
+void profiler::newFrame() {
+
+  if (!_enabled) return;
+
+  int64_t now = profileNow();
+
+  if (!_profile.open.empty()) {
+    if (!_profile.warnedNesting) {
+      std::cerr << "Caution: A new profiler frame was started inside a "
+                << "profiled scope, so the scopes around it won't be "
+                << "counted." << std::endl;
+      _profile.warnedNesting = true;
+    }
+    _profile.open.clear();
+  }
+
+  for (profileTotals::iterator it = _profile.frame.begin();
+       it != _profile.frame.end(); it++) {
+    it->second = profileTotal();
+  }
+
+  // The scopes are in the order they started, so each one's parent
+  // is the last one before it that is less deep.
+  _profile.parents.clear();
+  for (size_t i = 0; i < _profile.events.size(); i++) {
+    const profileEvent &event = _profile.events[i];
+    while (!_profile.parents.empty() &&
+           _profile.events[_profile.parents.back()].depth >= event.depth)
+      _profile.parents.pop_back();
+
+    int64_t ns = event.end - event.start;
+    profileTotal &t = _profile.frame[event.name];
+    t.calls++;
+    t.cpuNs += ns;
+    t.selfNs += ns;
+    if (!_profile.parents.empty())
+      _profile.frame[_profile.events[_profile.parents.back()].name].selfNs -= ns;
+
+    _profile.parents.push_back(i);
+  }
+
+  bool tracing = _profile.traceFrames > 0;
+  if (tracing) {
+    for (size_t i = 0; i < _profile.events.size(); i++) {
+      const profileEvent &event = _profile.events[i];
+      profileTraceEvent traceEvent = { event.name, event.start,
+                                       event.end - event.start, false };
+      _profile.trace.push_back(traceEvent);
+    }
+    _profile.traceFrames--;
+  }
+
+  // The queries from the frame before this one have had a whole
+  // frame to finish.  The next frame reuses their slot.
+  int last = 1 - _profile.slot;
+  std::vector<profileQuery> &queries = _profile.queries[last];
+  for (size_t i = 0; i < queries.size(); i++) {
+    GLint available = 0;
+    glGetQueryObjectiv(queries[i].id, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available) {
+      GLuint64 ns = 0;
+      if (_profile.timerQueries == 2) {
+        glGetQueryObjectui64vEXT(queries[i].id, GL_QUERY_RESULT, &ns);
+      } else {
+        glGetQueryObjectui64v(queries[i].id, GL_QUERY_RESULT, &ns);
+      }
+      _profile.frame[queries[i].name].gpuNs += ns;
+
+      if (tracing) {
+        profileTraceEvent traceEvent = { queries[i].name, queries[i].start,
+                                         (int64_t)ns, true };
+        _profile.trace.push_back(traceEvent);
+      }
+    } else {
+      _profile.dropped++;
+    }
+    _profile.spareQueries.push_back(queries[i].id);
+  }
+  queries.clear();
+  _profile.slot = last;
+
+  for (profileTotals::iterator it = _profile.frame.begin();
+       it != _profile.frame.end(); it++) {
+    profileTotal &t = _profile.total[it->first];
+    t.calls += it->second.calls;
+    t.cpuNs += it->second.cpuNs;
+    t.selfNs += it->second.selfNs;
+    t.gpuNs += it->second.gpuNs;
+  }
+
+  _profile.frameNs = now - _profile.frameStart;
+  _profile.totalFrameNs += _profile.frameNs;
+  _profile.frames++;
+
+  _profile.events.clear();
+  _profile.frameStart = profileNow();
+}
+
+// Adds up the totals by name, since the same name in different files
+// might be at different addresses.
+static std::map<std::string, profileStat> profileStats(const profileTotals &totals,
+                                                       const int &frames) {
+
+  std::map<std::string, profileStat> out;
+  if (frames == 0) return out;
+
+  for (profileTotals::const_iterator it = totals.begin();
+       it != totals.end(); it++) {
+    if (it->second.calls == 0 && it->second.gpuNs == 0) continue;
+
+    profileStat &stat = out[it->first];
+    stat.calls += (double)it->second.calls / frames;
+    stat.cpuMs += 1.0e-6 * it->second.cpuNs / frames;
+    stat.selfMs += 1.0e-6 * it->second.selfNs / frames;
+    stat.gpuMs += 1.0e-6 * it->second.gpuNs / frames;
+  }
+  return out;
+}
+
+std::map<std::string, profileStat> profiler::getFrameStats() {
+  return profileStats(_profile.frame, 1);
+}
+
+std::map<std::string, profileStat> profiler::getAverageStats() {
+  return profileStats(_profile.total, _profile.frames);
+}
+
+double profiler::getFrameMs() { return 1.0e-6 * _profile.frameNs; }
+
+double profiler::getAverageFrameMs() {
+  if (_profile.frames == 0) return 0.0;
+  return 1.0e-6 * _profile.totalFrameNs / _profile.frames;
+}
+
+int profiler::getNumFrames() { return _profile.frames; }
+
+int profiler::getNumDroppedQueries() { return _profile.dropped; }
+
+// For sorting the stats, slowest first.
+static bool profileSlower(const std::pair<std::string, profileStat> &a,
+                          const std::pair<std::string, profileStat> &b) {
+  return a.second.cpuMs > b.second.cpuMs;
+}
+
+void profiler::printStats(std::ostream &os) {
+
+  std::map<std::string, profileStat> stats = getAverageStats();
+  std::vector<std::pair<std::string, profileStat> >
+    sorted(stats.begin(), stats.end());
+  std::sort(sorted.begin(), sorted.end(), profileSlower);
+
+  os << "Averages over " << _profile.frames << " frames of "
+     << std::fixed << std::setprecision(3) << getAverageFrameMs()
+     << " ms:" << std::endl;
+  os << std::setw(32) << std::left << "scope" << std::right
+     << std::setw(8) << "calls" << std::setw(10) << "cpu ms"
+     << std::setw(10) << "self ms" << std::setw(10) << "gpu ms" << std::endl;
+
+  for (size_t i = 0; i < sorted.size(); i++) {
+    const profileStat &stat = sorted[i].second;
+    os << std::setw(32) << std::left << sorted[i].first << std::right
+       << std::setw(8) << std::setprecision(1) << stat.calls
+       << std::setprecision(3)
+       << std::setw(10) << stat.cpuMs
+       << std::setw(10) << stat.selfMs
+       << std::setw(10) << stat.gpuMs << std::endl;
+  }
+
+  if (_profile.dropped > 0)
+    os << _profile.dropped << " GPU times were not ready in time." << std::endl;
+
+  os.unsetf(std::ios_base::floatfield);
+  os << std::setprecision(6);
+}
+
+void profiler::reset() {
+
+  _profile.total.clear();
+  _profile.totalFrameNs = 0;
+  _profile.frames = 0;
+  _profile.dropped = 0;
+}
+
+void profiler::startTrace(const int &maxFrames) {
+
+  _profile.trace.clear();
+  _profile.traceFrames = maxFrames;
+  _profile.traceStart = profileNow();
+}
+
+void profiler::stopTrace() {
+  _profile.traceFrames = 0;
+}
+
+// Writes a name as a JSON string.
+static void profileWriteName(std::ostream &os, const char *name) {
+
+  os << '"';
+  for (const char *c = name; *c; c++) {
+    if (*c == '"' || *c == '\\') {
+      os << '\\' << *c;
+    } else if ((unsigned char)*c < 0x20) {
+      os << ' ';
+    } else {
+      os << *c;
+    }
+  }
+  os << '"';
+}
+
+void profiler::writeTrace(const std::string &fileName) {
+
+  std::ofstream out(fileName.c_str());
+  if (!out)
+    throw std::runtime_error("Can't write the trace to " + fileName);
+
+  // The CPU scopes go on one line of the trace, and the GPU ones on
+  // another, placed where they were started on the CPU.  The times
+  // are in microseconds.
+  out << "{\"traceEvents\":[" << std::endl;
+  out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,"
+      << "\"args\":{\"name\":\"CPU\"}}," << std::endl;
+  out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,"
+      << "\"args\":{\"name\":\"GPU\"}}";
+
+  out << std::fixed << std::setprecision(3);
+  for (size_t i = 0; i < _profile.trace.size(); i++) {
+    const profileTraceEvent &event = _profile.trace[i];
+    out << "," << std::endl << "{\"name\":";
+    profileWriteName(out, event.name);
+    out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << (event.gpu ? 2 : 1)
+        << ",\"ts\":" << 1.0e-3 * (event.start - _profile.traceStart)
+        << ",\"dur\":" << 1.0e-3 * event.duration << "}";
+  }
+  out << std::endl << "]}" << std::endl;
+
+  if (!out)
+    throw std::runtime_error("Can't write the trace to " + fileName);
+}
+
+}
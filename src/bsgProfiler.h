@@ -0,0 +1,179 @@
+#ifndef BSGPROFILER
+#define BSGPROFILER
+
+#include <GL/glew.h>
+#include <stdint.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+
+namespace bsg {
+
+/// \brief The time spent in one profiled part of a frame.
+///
+/// The cpu time includes the scopes inside this one, the self time
+/// doesn't.  The gpu time is only there for the scopes that asked
+/// for it, and is otherwise zero.  Averaged over frames, the calls
+/// can be fractional.
+struct profileStat {
+  double calls;
+  double cpuMs;
+  double selfMs;
+  double gpuMs;
+
+  profileStat() : calls(0.0), cpuMs(0.0), selfMs(0.0), gpuMs(0.0) {};
+};
+
+/// \class profiler
+/// \brief Where does the frame time go?
+///
+/// The library marks out the parts of a frame that take time, like
+/// scene::load(), the matrices and uniforms, and each compound's
+/// draw, with scopes that note the time they start and end.  Scopes
+/// can be nested, and the time of each part is added up over the
+/// frame, by name.  A scope can also ask the GPU how long the drawing
+/// inside it took, and the draws of each compound object do.  Their
+/// GPU time is under drawableCompound::draw.  The GPU is usually a frame or so behind, so those answers
+/// are read a frame later, and never waited for.  One that isn't
+/// ready by then is dropped.  The GPU times are reported with the
+/// frame they come in.
+///
+/// None of this is compiled unless the library is built with
+/// 'cmake -DBSG_PROFILING=on'.  Otherwise the scopes are empty
+/// macros.  The scope around every drawableObj::draw() costs more
+/// than the rest put together in a scene of many small objects, so
+/// it also needs 'cmake -DBSG_PROFILING_DETAIL=on'.  When the profiler
+/// is compiled in, it does nothing until turned on:
+///
+///     bsg::profiler::setEnabled(true);
+///     ... draw some frames ...
+///     bsg::profiler::printStats();
+///
+/// Each call to scene::load() starts a new frame.  Use
+/// BSG_PROFILE_SCOPE("name") in your own code to time a block, and
+/// BSG_PROFILE_GPU("name") around drawing.  The names have to be
+/// string constants, since only the pointer is kept.  GPU scopes
+/// can't be nested, so an inner one is skipped.  Only use scopes on
+/// the thread that draws.
+///
+/// The frames can also be saved as a trace file for Chrome's
+/// chrome://tracing viewer (or ui.perfetto.dev), with startTrace()
+/// and writeTrace().
+class profiler {
+ private:
+  static bool _enabled;
+
+ public:
+  /// \brief Turn the profiling on or off.
+  static void setEnabled(const bool &enabled);
+  static bool isEnabled() { return _enabled; };
+
+  /// \brief Finish a frame and start another.
+  ///
+  /// The scene calls this from load().  If you draw without a scene,
+  /// call it yourself once a frame.
+  static void newFrame();
+
+  /// \brief Start and end a timed part of the frame.
+  ///
+  /// Use the BSG_PROFILE_SCOPE macro instead of calling these.
+  static void begin(const char *name);
+  static void end();
+
+  /// \brief Start and end a GPU timer query.
+  ///
+  /// The begin returns false if it didn't start one, in which case
+  /// don't call the end.  Use the BSG_PROFILE_GPU macro instead.
+  static bool beginGPU(const char *name);
+  static void endGPU();
+
+  /// \brief The times of the last whole frame, by name.
+  static std::map<std::string, profileStat> getFrameStats();
+
+  /// \brief The times per frame, averaged since the profiler was
+  /// turned on or reset.
+  static std::map<std::string, profileStat> getAverageStats();
+
+  /// \brief How long the last frame took, from one newFrame() to
+  /// the next.
+  static double getFrameMs();
+
+  /// \brief The average frame time since the profiler was turned on
+  /// or reset.
+  static double getAverageFrameMs();
+
+  /// \brief The number of frames counted in the averages.
+  static int getNumFrames();
+
+  /// \brief The number of GPU times that weren't ready in time, and
+  /// were dropped.
+  static int getNumDroppedQueries();
+
+  /// \brief Print the average times, slowest first.
+  static void printStats(std::ostream &os = std::cout);
+
+  /// \brief Start the averages again.
+  static void reset();
+
+  /// \brief Keep every scope of the next maxFrames frames, for a trace.
+  static void startTrace(const int &maxFrames = 300);
+
+  /// \brief Stop keeping frames for the trace.
+  static void stopTrace();
+
+  /// \brief Write the trace in the Chrome trace event format.
+  ///
+  /// Throws an exception if the file can't be written.
+  static void writeTrace(const std::string &fileName);
+};
+
+/// \brief Times the block it's declared in.
+class profileScope {
+ private:
+  bool _on;
+
+ public:
+  profileScope(const char *name) : _on(profiler::isEnabled()) {
+    if (_on) profiler::begin(name);
+  };
+  ~profileScope() { if (_on) profiler::end(); };
+};
+
+/// \brief Times the GPU work of the block it's declared in.
+class profileGPUScope {
+ private:
+  bool _on;
+
+ public:
+  profileGPUScope(const char *name) :
+    _on(profiler::isEnabled() && profiler::beginGPU(name)) {};
+  ~profileGPUScope() { if (_on) profiler::endGPU(); };
+};
+
+}
+
+#define BSG_PROFILE_CONCAT2(a, b) a##b
+#define BSG_PROFILE_CONCAT(a, b) BSG_PROFILE_CONCAT2(a, b)
+
+#ifdef BSG_PROFILING
+#define BSG_PROFILE_SCOPE(name) \
+  bsg::profileScope BSG_PROFILE_CONCAT(_bsgProfileScope, __LINE__)(name)
+#define BSG_PROFILE_GPU(name) \
+  bsg::profileGPUScope BSG_PROFILE_CONCAT(_bsgProfileGPU, __LINE__)(name)
+#define BSG_PROFILE_FRAME() bsg::profiler::newFrame()
+#else
+#define BSG_PROFILE_SCOPE(name)
+#define BSG_PROFILE_GPU(name)
+#define BSG_PROFILE_FRAME()
+#endif
+
+// The scopes in the innermost loops, which only a finer look needs.
+#if defined(BSG_PROFILING) && defined(BSG_PROFILING_DETAIL)
+#define BSG_PROFILE_DETAIL_SCOPE(name) BSG_PROFILE_SCOPE(name)
+#else
+#define BSG_PROFILE_DETAIL_SCOPE(name)
+#endif
+
+#endif
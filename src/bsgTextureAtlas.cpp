@@ -0,0 +1,220 @@
+#include "bsgTextureAtlas.h"
+#include "stb_image.h"
+
+namespace bsg {
+
+textureAtlas::textureAtlas(const int &pageSize, const int &padding,
+                           const textureSampling &sampling) :
+  textureMgr(),
+  _pageSize(pageSize),
+  _padding(padding),
+  _layers(0),
+  _packedBytes(0),
+  _sampling(sampling),
+  _target(GL_TEXTURE_2D) {
+}
+
+textureAtlas::~textureAtlas() {
+
+  for (size_t i = 0; i < _images.size(); i++)
+    if (_images[i].pixels) stbi_image_free(_images[i].pixels);
+
+  if (_textureBufferID) glDeleteTextures(1, &_textureBufferID);
+  _textureBufferID = 0;
+}
+
+int textureAtlas::addImage(const std::string &fileName) {
+
+  if (_layers > 0)
+    throw std::runtime_error("Can't add " + fileName + " to an atlas that's already packed.");
+
+  stbi_set_flip_vertically_on_load(true);
+
+  atlasImage image;
+  int components;
+  image.fileName = fileName;
+  image.pixels = stbi_load(fileName.c_str(), &image.width, &image.height,
+                           &components, STBI_rgb_alpha);
+  if (!image.pixels)
+    throw std::runtime_error("Can't read " + fileName + ": " +
+                             stbi_failure_reason());
+
+  image.layer = 0;
+  image.x = image.y = 0;
+  _images.push_back(image);
+  return _images.size() - 1;
+}
+
+// Sorts image numbers by decreasing height.
+struct _byHeight {
+  const std::vector<int> &heights;
+  _byHeight(const std::vector<int> &h) : heights(h) {};
+  bool operator()(const int &a, const int &b) const {
+    return heights[a] > heights[b];
+  };
+};
+
+void textureAtlas::pack() {
+
+  if (_images.empty()) {
+    std::cerr << "Caution: There's nothing to pack in the atlas." << std::endl;
+    return;
+  }
+
+  GLint maxSize = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+  if (maxSize > 0) _pageSize = std::min(_pageSize, (int)maxSize);
+
+  std::vector<int> order(_images.size()), heights(_images.size());
+  for (size_t i = 0; i < _images.size(); i++) {
+    order[i] = i;
+    heights[i] = _images[i].height;
+  }
+  std::stable_sort(order.begin(), order.end(), _byHeight(heights));
+
+  // Fill rows left to right, and rows bottom to top, and pages one
+  // after another.
+  int layer = 0, x = 0, y = 0, rowHeight = 0, usedHeight = 0;
+  for (size_t o = 0; o < order.size(); o++) {
+    atlasImage &image = _images[order[o]];
+    int w = image.width + 2 * _padding;
+    int h = image.height + 2 * _padding;
+    if (w > _pageSize || h > _pageSize)
+      throw std::runtime_error(image.fileName + " is too big for the atlas.");
+
+    if (x + w > _pageSize) {
+      x = 0;
+      y += rowHeight;
+      rowHeight = 0;
+    }
+    if (y + h > _pageSize) {
+      layer++;
+      x = y = rowHeight = 0;
+    }
+
+    image.layer = layer;
+    image.x = x + _padding;
+    image.y = y + _padding;
+    x += w;
+    rowHeight = std::max(rowHeight, h);
+    usedHeight = std::max(usedHeight, y + rowHeight);
+  }
+  _layers = layer + 1;
+
+  if (_layers > 1 && !GLEW_EXT_texture_array)
+    throw std::runtime_error("The atlas needs more than one page, which needs GL_EXT_texture_array.");
+
+  // One page only needs to be as tall as what's on it.
+  int width = _pageSize;
+  int height = (_layers == 1) ? (usedHeight + 3) & ~3 : _pageSize;
+  _target = (_layers == 1) ? GL_TEXTURE_2D : GL_TEXTURE_2D_ARRAY_EXT;
+
+  // Copy the images in, with their edges copied out into the padding.
+  std::vector<unsigned char> texels((size_t)width * height * _layers * 4, 0);
+  for (size_t i = 0; i < _images.size(); i++) {
+    atlasImage &image = _images[i];
+    unsigned char *page = &texels[(size_t)image.layer * width * height * 4];
+
+    for (int ty = -_padding; ty < image.height + _padding; ty++) {
+      int sy = std::min(std::max(ty, 0), image.height - 1);
+      for (int tx = -_padding; tx < image.width + _padding; tx++) {
+        int sx = std::min(std::max(tx, 0), image.width - 1);
+        memcpy(&page[((size_t)(image.y + ty) * width + image.x + tx) * 4],
+               &image.pixels[((size_t)sy * image.width + sx) * 4], 4);
+      }
+    }
+
+    image.rect = glm::vec4((float)image.x / width, (float)image.y / height,
+                           (float)(image.x + image.width) / width,
+                           (float)(image.y + image.height) / height);
+
+    stbi_image_free(image.pixels);
+    image.pixels = NULL;
+  }
+
+  glGenTextures(1, &_textureBufferID);
+  drawStats::counts.textureBinds++;
+  drawStats::counts.textureUpload(texels.size());
+  glBindTexture(_target, _textureBufferID);
+  if (_target == GL_TEXTURE_2D) {
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, &texels[0]);
+  } else {
+    glTexImage3D(GL_TEXTURE_2D_ARRAY_EXT, 0, GL_RGBA8, width, height, _layers,
+                 0, GL_RGBA, GL_UNSIGNED_BYTE, &texels[0]);
+  }
+  _packedBytes = texels.size();
+
+  GLenum minFilter = _sampling.minFilter;
+  if (_sampling.usesMipmaps()) {
+    if (GLEW_VERSION_3_0 || GLEW_ARB_framebuffer_object) {
+      glGenerateMipmap(_target);
+      _packedBytes += _packedBytes / 3;
+    } else if (GLEW_EXT_framebuffer_object) {
+      glGenerateMipmapEXT(_target);
+      _packedBytes += _packedBytes / 3;
+    } else {
+      std::cerr << "Caution: Can't make mipmaps for the atlas, "
+                << "so it will be sampled without them." << std::endl;
+      minFilter = GL_LINEAR;
+    }
+  }
+
+  glTexParameteri(_target, GL_TEXTURE_MIN_FILTER, minFilter);
+  glTexParameteri(_target, GL_TEXTURE_MAG_FILTER, _sampling.magFilter);
+  glTexParameteri(_target, GL_TEXTURE_WRAP_S, _sampling.wrap);
+  glTexParameteri(_target, GL_TEXTURE_WRAP_T, _sampling.wrap);
+  if (_sampling.anisotropy > 1.0f && GLEW_EXT_texture_filter_anisotropic) {
+    GLfloat maxAnisotropy = 1.0f;
+    glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
+    glTexParameterf(_target, GL_TEXTURE_MAX_ANISOTROPY_EXT,
+                    std::min(_sampling.anisotropy, std::max(maxAnisotropy, 1.0f)));
+  }
+
+  _width = width;
+  _height = height;
+}
+
+glm::vec2 textureAtlas::remap(const glm::vec2 &uv, const int &image) {
+
+  const glm::vec4 &rect = _images[image].rect;
+  glm::vec2 out(rect.x + uv.x * (rect.z - rect.x),
+                rect.y + uv.y * (rect.w - rect.y));
+
+  // The layer goes in the whole-number part of u, where the shader
+  // can find it.
+  if (isArray()) out.x += _images[image].layer;
+  return out;
+}
+
+void textureAtlas::remap(bsgPtr<drawableObj> &obj, const int &image) {
+
+  if (_layers == 0)
+    throw std::runtime_error("Pack the atlas before remapping anything.");
+
+  std::vector<glm::vec2> uvs = obj->getTexCoords();
+  bool outside = false;
+  for (size_t i = 0; i < uvs.size(); i++) {
+    if (uvs[i].x < 0.0f || uvs[i].x > 1.0f || uvs[i].y < 0.0f || uvs[i].y > 1.0f)
+      outside = true;
+    uvs[i] = remap(uvs[i], image);
+  }
+
+  if (outside)
+    std::cerr << "Caution: Texture coordinates outside 0 to 1 will reach "
+              << "past " << _images[image].fileName << " in the atlas."
+              << std::endl;
+
+  obj->setData(GLDATA_TEXCOORDS, uvs);
+}
+
+void textureAtlas::draw() {
+
+  glActiveTexture(GL_TEXTURE0);
+  drawStats::counts.textureBinds++;
+  drawStats::counts.uniformUploads++;
+  glBindTexture(_target, _textureBufferID);
+  glUniform1i(_textureAttribID, 0);
+}
+
+}
@@ -0,0 +1,115 @@
+#ifndef BSGTEXTUREATLAS
+#define BSGTEXTUREATLAS
+
+#include "bsg.h"
+
+namespace bsg {
+
+/// \class textureAtlas
+/// \brief Many small images packed into one texture.
+///
+/// Every textureMgr is its own GL texture, so a scene with a hundred
+/// little textured objects binds a hundred textures, and the objects
+/// can't share a shader, or be drawn together.  This packs the images
+/// into one big texture instead, side by side, and moves each
+/// object's texture coordinates to where its image ended up.  Then
+/// the objects can all share one shader and this one texture.
+///
+/// The images are packed onto pages of pageSize texels square.  If
+/// they all fit on one page, the atlas is a plain 2D texture, and the
+/// usual shaders work as they are.  If they need more pages, and
+/// GL_EXT_texture_array is there, the pages are the layers of a
+/// GL_TEXTURE_2D_ARRAY.  Each object's layer is a constant for that
+/// object, and rides along in the whole-number part of its u
+/// coordinate.  Use shaders/textureArrayShader.fp for those, which
+/// splits it back out.
+///
+/// The usual sequence is:
+///
+///     bsgPtr<textureAtlas> atlas = new textureAtlas();
+///     int ball = atlas->addImage("ball.png");
+///     int box = atlas->addImage("box.png");
+///     atlas->pack();
+///     atlas->remap(ballObj, ball);
+///     atlas->remap(boxObj, box);
+///     shader->addTexture(atlas);
+///
+/// Texture coordinates outside 0 to 1 would wander into the next
+/// image, so images that repeat don't belong in an atlas.  The
+/// padding around each image keeps the filtering from reaching into
+/// its neighbors, at least for the first couple of mipmap levels.
+class textureAtlas : public textureMgr {
+ private:
+
+  /// An image, and where it went.
+  struct atlasImage {
+    std::string fileName;
+    int width, height;
+    unsigned char *pixels;
+    int layer;
+    int x, y;
+    glm::vec4 rect;
+  };
+  std::vector<atlasImage> _images;
+
+  int _pageSize;
+  int _padding;
+  int _layers;
+  size_t _packedBytes;
+  textureSampling _sampling;
+  GLenum _target;
+
+ public:
+  /// \brief An empty atlas.
+  ///
+  /// The padding is the number of texels around each image, copied
+  /// from its edge.
+  textureAtlas(const int &pageSize = 2048, const int &padding = 2,
+               const textureSampling &sampling =
+               textureSampling(GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, 1.0f));
+  ~textureAtlas();
+
+  /// \brief Read an image to go in the atlas.
+  ///
+  /// Anything stb_image reads will do.  Returns the number to use
+  /// for it in the other methods.  All the images have to be added
+  /// before pack().
+  int addImage(const std::string &fileName);
+
+  /// \brief Lay out the images, and send the atlas to the GPU.
+  ///
+  /// The taller images go first, in rows, each row as tall as its
+  /// first image.  The images are freed once they're on the GPU.
+  void pack();
+
+  /// \brief How many pages the images took.
+  int getNumLayers() { return _layers; };
+
+  /// \brief About how much GPU memory the atlas takes, in bytes.
+  size_t getBytes() { return _packedBytes; };
+
+  /// \brief Is this a texture array?
+  bool isArray() { return _target != GL_TEXTURE_2D; };
+
+  /// \brief The page an image is on.
+  int getLayer(const int &image) { return _images[image].layer; };
+
+  /// \brief Where an image is on its page, as (u0, v0, u1, v1).
+  glm::vec4 getRect(const int &image) { return _images[image].rect; };
+
+  /// \brief Where a texture coordinate of an image is in the atlas.
+  ///
+  /// For a texture array, the layer is added to u.
+  glm::vec2 remap(const glm::vec2 &uv, const int &image);
+
+  /// \brief Move an object's texture coordinates into the atlas.
+  ///
+  /// Do this once, after pack().  The object can be prepared already.
+  void remap(bsgPtr<drawableObj> &obj, const int &image);
+
+  void draw();
+};
+
+}
+
+#endif
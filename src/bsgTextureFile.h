@@ -0,0 +1,62 @@
+#ifndef BSGTEXTUREFILE
+#define BSGTEXTUREFILE
+
+#include <stdint.h>
+
+namespace bsg {
+
+/// \brief The header of a .bsgt texture file.
+///
+/// A .bsgt file holds a texture that is ready to go to the GPU as it
+/// is: already flipped bottom row first, the way OpenGL wants it,
+/// with all its mipmap levels, and maybe block-compressed.  Reading
+/// one is just a matter of mapping the file into memory and handing
+/// the levels to OpenGL, so it takes as long as the disk takes.  Make
+/// them from PNG or JPEG files with tools/bsgTexConvert, and read
+/// them with textureMgr::readFile(textureBSG, ...).
+///
+/// The header is followed by a table with one bsgTextureFileLevel for
+/// each mipmap level, biggest first, and then the pixel data.  The
+/// rows of uncompressed levels are packed with no padding.  Everything
+/// is little-endian.
+struct bsgTextureFileHeader {
+  char magic[4];              ///< "BSGT"
+  uint32_t version;           ///< bsgTextureFileVersion
+  uint32_t width, height;     ///< The size of the biggest level.
+  uint32_t levels;            ///< The number of mipmap levels.
+  uint32_t internalFormat;    ///< The GL internal format.
+  uint32_t format;            ///< The GL format, or zero if compressed.
+  uint32_t type;              ///< The GL type, or zero if compressed.
+};
+
+/// \brief Where one mipmap level is in a .bsgt file.
+struct bsgTextureFileLevel {
+  uint64_t offset;            ///< From the start of the file.
+  uint64_t size;              ///< In bytes.
+};
+
+static const uint32_t bsgTextureFileVersion = 1;
+
+/// \brief The header of a .bsgv virtual texture file.
+///
+/// A .bsgv file holds an image too big to be one texture, cut into
+/// square tiles, for a virtualTexture.  Each mipmap level is cut up
+/// separately, down to the level that fits in one tile.  Each tile
+/// is tileSize texels on a side, RGBA, flipped bottom row first, and
+/// includes a border copied from its neighbors, so tiles can be
+/// filtered without seams.  The header is followed by the offset of
+/// every tile in the file, as uint64_t, level by level, row by row,
+/// and then the tiles.  Make them with bsgTexConvert -tiles.
+struct bsgVirtualTextureFileHeader {
+  char magic[4];              ///< "BSGV"
+  uint32_t version;           ///< bsgTextureFileVersion
+  uint32_t width, height;     ///< The size of the whole image.
+  uint32_t levels;            ///< The number of mipmap levels.
+  uint32_t tileSize;          ///< Texels on a side, with the border.
+  uint32_t border;            ///< Border texels on each side.
+  uint32_t numTiles;          ///< In all the levels together.
+};
+
+}
+
+#endif
@@ -0,0 +1,646 @@
+#include "bsgVirtualTexture.h"
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace bsg {
+
+// The feedback shader.  Each pixel works out the mipmap level it
+// would sample, the way the GPU would, from how fast the texture
+// coordinates change across the screen, and writes the tile it needs
+// at that level.  The tile's x and y take eight bits each in red and
+// green, and four more each in blue.  Alpha is the level plus one, so
+// zero means no tile.
+static const char *feedbackVertexShader =
+  "#version 120\n"
+  "uniform mat4 projMatrix;\n"
+  "uniform mat4 viewMatrix;\n"
+  "uniform mat4 modelMatrix;\n"
+  "attribute vec4 position;\n"
+  "attribute vec2 texture;\n"
+  "varying vec2 uvFrag;\n"
+  "void main() {\n"
+  "  uvFrag = texture;\n"
+  "  gl_Position = projMatrix * viewMatrix * modelMatrix * position;\n"
+  "}\n";
+
+static const char *feedbackFragmentShader =
+  "#version 120\n"
+  "uniform vec4 vtImage;\n"
+  "uniform float vtLevels;\n"
+  "uniform float vtFeedbackBias;\n"
+  "varying vec2 uvFrag;\n"
+  "void main() {\n"
+  "  vec2 texel = uvFrag * vtImage.xy;\n"
+  "  vec2 dx = dFdx(texel);\n"
+  "  vec2 dy = dFdy(texel);\n"
+  "  float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1.0e-8));\n"
+  "  float level = clamp(floor(lod - vtFeedbackBias), 0.0, vtLevels - 1.0);\n"
+  "  texel = clamp(texel, vec2(0.0), vtImage.xy - 1.0);\n"
+  "  vec2 tile = floor(texel / (vtImage.z * exp2(level)));\n"
+  "  vec2 high = floor(tile / 256.0);\n"
+  "  gl_FragColor = vec4(tile - 256.0 * high, high.x + 16.0 * high.y,\n"
+  "                      level + 1.0) / 255.0;\n"
+  "}\n";
+
+virtualTexture::virtualTexture(const std::string &fileName,
+                               const int &pagesPerSide,
+                               const int &feedbackScale) :
+  textureMgr(),
+  _fileName(fileName),
+  _content(0),
+  _mapped(NULL), _mappedLength(0),
+  _pagesPerSide(pagesPerSide),
+  _frame(0),
+  _warnedBudget(false),
+  _quit(false),
+  _maxUploadsPerFrame(16),
+  _indirectionTexture(0),
+  _indirectionUnit(GL_TEXTURE4),
+  _feedbackFramebuffer(0), _feedbackTexture(0), _feedbackDepth(0),
+  _feedbackScale(std::max(feedbackScale, 1)),
+  _feedbackWidth(0), _feedbackHeight(0),
+  _savedFramebuffer(0),
+  _inFeedback(false),
+  _programID(0),
+  _positionName("position"),
+  _uvName("texture") {
+
+  _open();
+
+  _requested.assign(_header.numTiles, 0);
+  _wanted.assign(_tilesX[0] * _tilesY[0], 255);
+  _indirection.assign(_tilesX[0] * _tilesY[0] * 4, 0);
+  _width = _header.width;
+  _height = _header.height;
+
+  _worker = std::thread(&virtualTexture::_work, this);
+}
+
+virtualTexture::~virtualTexture() {
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _quit = true;
+  }
+  _wake.notify_all();
+  _worker.join();
+
+  if (_textureBufferID) glDeleteTextures(1, &_textureBufferID);
+  _textureBufferID = 0;
+  if (_indirectionTexture) glDeleteTextures(1, &_indirectionTexture);
+  if (_feedbackTexture) glDeleteTextures(1, &_feedbackTexture);
+  if (_feedbackDepth) glDeleteRenderbuffersEXT(1, &_feedbackDepth);
+  if (_feedbackFramebuffer) glDeleteFramebuffersEXT(1, &_feedbackFramebuffer);
+  for (std::map<GLuint, GLuint>::iterator it = _feedbackPrograms.begin();
+       it != _feedbackPrograms.end(); it++)
+    glDeleteProgram(it->second);
+
+#ifndef WIN32
+  if (_mapped) munmap((void *)_mapped, _mappedLength);
+#endif
+}
+
+// Maps the file and reads the header and the tile table.  The tiles
+// themselves are only read when they're needed.
+void virtualTexture::_open() {
+
+#ifdef WIN32
+  std::ifstream in(_fileName.c_str(), std::ios::in | std::ios::binary);
+  if (!in.is_open())
+    throw std::runtime_error("Cannot open: " + _fileName);
+  in.read((char *)&_header, sizeof(_header));
+  if (!in) throw std::runtime_error(_fileName + " is not a .bsgv file.");
+#else
+  int fd = open(_fileName.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("Cannot open: " + _fileName);
+
+  struct stat status;
+  _mappedLength = (fstat(fd, &status) == 0) ? status.st_size : 0;
+  void *mapped = _mappedLength ?
+    mmap(NULL, _mappedLength, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+  close(fd);
+  if (mapped == MAP_FAILED)
+    throw std::runtime_error("Cannot map: " + _fileName);
+  _mapped = (const unsigned char *)mapped;
+
+  if (_mappedLength < sizeof(_header)) {
+    munmap(mapped, _mappedLength);
+    _mapped = NULL;
+    throw std::runtime_error(_fileName + " is not a .bsgv file.");
+  }
+  memcpy(&_header, _mapped, sizeof(_header));
+#endif
+
+  if (memcmp(_header.magic, "BSGV", 4) != 0 ||
+      _header.version != bsgTextureFileVersion ||
+      _header.levels < 1 || _header.tileSize <= 2 * _header.border) {
+    throw std::runtime_error(_fileName + " is not a .bsgv file we can read.");
+  }
+  _content = _header.tileSize - 2 * _header.border;
+
+  // The tiles in each level, the same way bsgTexConvert counted them.
+  int total = 0;
+  int w = _header.width, h = _header.height;
+  for (uint32_t level = 0; level < _header.levels; level++) {
+    _firstTile.push_back(total);
+    _tilesX.push_back((w + _content - 1) / _content);
+    _tilesY.push_back((h + _content - 1) / _content);
+    total += _tilesX.back() * _tilesY.back();
+    w = std::max(1, w / 2);
+    h = std::max(1, h / 2);
+  }
+  if (total != (int)_header.numTiles)
+    throw std::runtime_error(_fileName + " has the wrong number of tiles.");
+
+  _tileOffsets.resize(total);
+  size_t tableBytes = total * sizeof(uint64_t);
+#ifdef WIN32
+  in.read((char *)&_tileOffsets[0], tableBytes);
+  if (!in) throw std::runtime_error(_fileName + " is cut short.");
+#else
+  if (sizeof(_header) + tableBytes > _mappedLength)
+    throw std::runtime_error(_fileName + " is cut short.");
+  memcpy(&_tileOffsets[0], _mapped + sizeof(_header), tableBytes);
+#endif
+}
+
+void virtualTexture::_readTile(const int &tile,
+                               std::vector<unsigned char> &texels) {
+
+  size_t bytes = _header.tileSize * _header.tileSize * 4;
+  texels.resize(bytes);
+
+  // Copying out of the mapping is where the disk is actually read.
+  if (_mapped) {
+    if (_tileOffsets[tile] + bytes <= _mappedLength) {
+      memcpy(&texels[0], _mapped + _tileOffsets[tile], bytes);
+    } else {
+      texels.clear();
+    }
+  } else {
+    std::ifstream in(_fileName.c_str(), std::ios::in | std::ios::binary);
+    in.seekg(_tileOffsets[tile]);
+    in.read((char *)&texels[0], bytes);
+    if (!in) texels.clear();
+  }
+}
+
+void virtualTexture::_work() {
+
+  while (true) {
+    int tile;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _wake.wait(lock, [this] { return _quit || !_todo.empty(); });
+      if (_quit) return;
+      tile = _todo.front();
+      _todo.pop_front();
+    }
+
+    std::vector<unsigned char> texels;
+    _readTile(tile, texels);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _done.push_back(std::pair<int, std::vector<unsigned char> >(tile, std::vector<unsigned char>()));
+    _done.back().second.swap(texels);
+  }
+}
+
+void virtualTexture::_makeTextures() {
+
+  if (_textureBufferID) return;
+
+  // The atlas has to fit in a texture, of course.
+  GLint maxSize = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+  if (maxSize > 0 && _pagesPerSide * (int)_header.tileSize > maxSize) {
+    _pagesPerSide = maxSize / _header.tileSize;
+    std::cerr << "Caution: The atlas for " << _fileName << " is too big, "
+              << "so it will only have " << _pagesPerSide << " pages a side."
+              << std::endl;
+  }
+  _pagesPerSide = std::min(std::max(_pagesPerSide, 1), 256);
+
+  page empty = { -1, 0 };
+  _pages.assign(_pagesPerSide * _pagesPerSide, empty);
+
+  int atlasSize = _pagesPerSide * _header.tileSize;
+  drawStats::counts.textureBinds += 2;
+  drawStats::counts.textureUpload(_indirection.size());
+
+  glGenTextures(1, &_textureBufferID);
+  glBindTexture(GL_TEXTURE_2D, _textureBufferID);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlasSize, atlasSize, 0,
+               GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+  glGenTextures(1, &_indirectionTexture);
+  glBindTexture(GL_TEXTURE_2D, _indirectionTexture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, _tilesX[0], _tilesY[0], 0,
+               GL_RGBA, GL_UNSIGNED_BYTE, &_indirection[0]);
+}
+
+GLuint virtualTexture::_feedbackProgram() {
+
+  std::map<GLuint, GLuint>::iterator it = _feedbackPrograms.find(_programID);
+  if (it != _feedbackPrograms.end()) return it->second;
+
+  GLuint program = glCreateProgram();
+  const char *sources[2] = { feedbackVertexShader, feedbackFragmentShader };
+  GLenum types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+  GLuint shaders[2];
+  for (int i = 0; i < 2; i++) {
+    shaders[i] = glCreateShader(types[i]);
+    glShaderSource(shaders[i], 1, &sources[i], NULL);
+    glCompileShader(shaders[i]);
+    glAttachShader(program, shaders[i]);
+  }
+
+  // The objects send their vertices to wherever the main program
+  // wants them, so ours have to be in the same places.
+  GLint position = shaderMgr::findAttrib(_programID, _positionName);
+  GLint uv = shaderMgr::findAttrib(_programID, _uvName);
+  if (position >= 0) glBindAttribLocation(program, position, "position");
+  if (uv >= 0) glBindAttribLocation(program, uv, "texture");
+
+  glLinkProgram(program);
+  for (int i = 0; i < 2; i++) {
+    glDetachShader(program, shaders[i]);
+    glDeleteShader(shaders[i]);
+  }
+
+  GLint linked = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if (linked != GL_TRUE) {
+    char log[1024] = "";
+    glGetProgramInfoLog(program, sizeof(log), NULL, log);
+    glDeleteProgram(program);
+    throw std::runtime_error("The virtual texture feedback shader won't link: " +
+                             std::string(log));
+  }
+
+  _feedbackPrograms[_programID] = program;
+  return program;
+}
+
+void virtualTexture::_setUniforms(const GLuint &programID) {
+
+  drawStats::counts.uniformUploads += 5;
+  glUniform4f(shaderMgr::findUniform(programID, "vtImage"),
+              (float)_header.width, (float)_header.height,
+              (float)_content, (float)_header.border);
+  glUniform2f(shaderMgr::findUniform(programID, "vtIndirectionSize"),
+              (float)_tilesX[0], (float)_tilesY[0]);
+  glUniform2f(shaderMgr::findUniform(programID, "vtAtlasSize"),
+              (float)_pagesPerSide, (float)_header.tileSize);
+  glUniform1f(shaderMgr::findUniform(programID, "vtLevels"),
+              (float)_header.levels);
+  glUniform1f(shaderMgr::findUniform(programID, "vtFeedbackBias"),
+              log2((float)_feedbackScale));
+}
+
+void virtualTexture::load(const GLuint programID) {
+
+  _programID = programID;
+  _makeTextures();
+  _textureAttribID = shaderMgr::findUniform(programID, _textureAttribName);
+}
+
+void virtualTexture::draw() {
+
+  drawStats::counts.textureBinds += 2;
+  drawStats::counts.uniformUploads += 2;
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, _textureBufferID);
+  glUniform1i(_textureAttribID, 0);
+
+  glActiveTexture(_indirectionUnit);
+  glBindTexture(GL_TEXTURE_2D, _indirectionTexture);
+  glUniform1i(shaderMgr::findUniform(_programID, "vtIndirection"),
+              _indirectionUnit - GL_TEXTURE0);
+  glActiveTexture(GL_TEXTURE0);
+
+  _setUniforms(_programID);
+}
+
+void virtualTexture::beginFeedback() {
+
+  if (!GLEW_EXT_framebuffer_object)
+    throw std::runtime_error("virtualTexture needs GL_EXT_framebuffer_object.");
+
+  _makeTextures();
+
+  glGetIntegerv(GL_VIEWPORT, _savedViewport);
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING_EXT, &_savedFramebuffer);
+
+  int width = std::max(1, _savedViewport[2] / _feedbackScale);
+  int height = std::max(1, _savedViewport[3] / _feedbackScale);
+
+  // Make the buffer over if the window has changed size.
+  if (width != _feedbackWidth || height != _feedbackHeight) {
+    if (!_feedbackFramebuffer) {
+      glGenFramebuffersEXT(1, &_feedbackFramebuffer);
+      glGenTextures(1, &_feedbackTexture);
+      glGenRenderbuffersEXT(1, &_feedbackDepth);
+    }
+
+    drawStats::counts.textureBinds++;
+    glBindTexture(GL_TEXTURE_2D, _feedbackTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, _feedbackDepth);
+    glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, GL_DEPTH_COMPONENT24,
+                             width, height);
+
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, _feedbackFramebuffer);
+    glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT,
+                              GL_TEXTURE_2D, _feedbackTexture, 0);
+    glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT,
+                                 GL_RENDERBUFFER_EXT, _feedbackDepth);
+
+    if (glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT) !=
+        GL_FRAMEBUFFER_COMPLETE_EXT) {
+      glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, _savedFramebuffer);
+      throw std::runtime_error("Can't make the virtual texture feedback buffer.");
+    }
+
+    _feedbackWidth = width;
+    _feedbackHeight = height;
+    _feedbackPixels.resize(width * height * 4);
+  }
+
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, _feedbackFramebuffer);
+  glViewport(0, 0, _feedbackWidth, _feedbackHeight);
+
+  GLfloat clearColor[4];
+  glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+
+  _inFeedback = true;
+}
+
+void virtualTexture::drawFeedback(bsgPtr<drawableCompound> &object,
+                                  const glm::mat4 &viewMatrix,
+                                  const glm::mat4 &projMatrix) {
+
+  // Until the object's shader has been loaded, we don't know where
+  // its attributes go, and it has nothing to draw anyway.
+  if (!_inFeedback || !_programID) return;
+
+  GLuint program = _feedbackProgram();
+  drawStats::counts.programChanges++;
+  drawStats::counts.uniformUploads += 3;
+  glUseProgram(program);
+
+  glm::mat4 modelMatrix = object->getModelMatrix();
+  glUniformMatrix4fv(shaderMgr::findUniform(program, "modelMatrix"),
+                     1, false, &modelMatrix[0][0]);
+  glUniformMatrix4fv(shaderMgr::findUniform(program, "viewMatrix"),
+                     1, false, &viewMatrix[0][0]);
+  glUniformMatrix4fv(shaderMgr::findUniform(program, "projMatrix"),
+                     1, false, &projMatrix[0][0]);
+  _setUniforms(program);
+
+  for (drawableCompound::iterator it = object->begin();
+       it != object->end(); it++) {
+    (*it)->draw();
+  }
+}
+
+void virtualTexture::endFeedback() {
+
+  if (!_inFeedback) return;
+  _inFeedback = false;
+
+  // The buffer is small, so reading it straight back is cheap.
+  glReadPixels(0, 0, _feedbackWidth, _feedbackHeight, GL_RGBA,
+               GL_UNSIGNED_BYTE, &_feedbackPixels[0]);
+
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, _savedFramebuffer);
+  glViewport(_savedViewport[0], _savedViewport[1],
+             _savedViewport[2], _savedViewport[3]);
+
+  _processFeedback();
+  _uploadTiles();
+  _updateIndirection();
+}
+
+// Notes that a tile is needed this frame.  If it's not on the GPU or
+// on its way, it goes on the missing list.  Returns false if it was
+// already asked for this frame.
+bool virtualTexture::_request(const int &level, const int &x, const int &y,
+                              std::vector<std::pair<int, int> > &missing) {
+
+  int tile = _tileIndex(level, x, y);
+  if (_requested[tile] == _frame) return false;
+  _requested[tile] = _frame;
+
+  std::unordered_map<int, int>::iterator it = _residentTiles.find(tile);
+  if (it != _residentTiles.end()) {
+    _pages[it->second].lastUsed = _frame;
+  } else if (_inFlight.find(tile) == _inFlight.end()) {
+    missing.push_back(std::pair<int, int>(level, tile));
+  }
+  return true;
+}
+
+void virtualTexture::_processFeedback() {
+
+  _frame++;
+  std::fill(_wanted.begin(), _wanted.end(), 255);
+  std::vector<std::pair<int, int> > missing;
+
+  // The coarsest level is always wanted, so there's always something
+  // to show.
+  int top = _header.levels - 1;
+  for (int y = 0; y < _tilesY[top]; y++)
+    for (int x = 0; x < _tilesX[top]; x++)
+      _request(top, x, y, missing);
+
+  for (size_t p = 0; p < _feedbackPixels.size(); p += 4) {
+    const unsigned char *pixel = &_feedbackPixels[p];
+    if (pixel[3] == 0) continue;
+
+    int level = pixel[3] - 1;
+    int x = pixel[0] + 256 * (pixel[2] & 15);
+    int y = pixel[1] + 256 * (pixel[2] >> 4);
+    if (level > top || x >= _tilesX[level] || y >= _tilesY[level]) continue;
+
+    if (!_request(level, x, y, missing)) continue;
+
+    // Mark the full-size tiles under this one as wanting this level.
+    int x1 = std::min((x + 1) << level, _tilesX[0]);
+    int y1 = std::min((y + 1) << level, _tilesY[0]);
+    for (int cy = y << level; cy < y1; cy++) {
+      for (int cx = x << level; cx < x1; cx++) {
+        unsigned char &wanted = _wanted[cy * _tilesX[0] + cx];
+        wanted = std::min(wanted, (unsigned char)level);
+      }
+    }
+
+    // The coarser tiles that cover this one are wanted too, to show
+    // until it arrives.
+    for (int l = level + 1; l <= top; l++) {
+      if (!_request(l, std::min(x >> (l - level), _tilesX[l] - 1),
+                    std::min(y >> (l - level), _tilesY[l] - 1), missing))
+        break;
+    }
+  }
+
+  // Coarse tiles first, since they cover more, and the finer ones
+  // can't be shown without them.
+  std::sort(missing.begin(), missing.end(),
+            std::greater<std::pair<int, int> >());
+
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  // Forget about tiles that were asked for before, but aren't wanted
+  // any more, and haven't been read yet.
+  for (std::list<int>::iterator it = _todo.begin(); it != _todo.end(); ) {
+    if (_requested[*it] != _frame) {
+      _inFlight.erase(*it);
+      it = _todo.erase(it);
+    } else {
+      it++;
+    }
+  }
+
+  // There's no point reading more than will fit in the pages that
+  // aren't needed for this frame.
+  size_t room = 0;
+  for (size_t p = 0; p < _pages.size(); p++)
+    if (_pages[p].tile < 0 || _pages[p].lastUsed != _frame) room++;
+
+  if (missing.size() > room && !_warnedBudget) {
+    std::cerr << "Caution: The view needs more tiles of " << _fileName
+              << " than fit in the atlas." << std::endl;
+    _warnedBudget = true;
+  }
+
+  for (size_t i = 0; i < missing.size() && _todo.size() < room; i++) {
+    _todo.push_back(missing[i].second);
+    _inFlight.insert(missing[i].second);
+  }
+  if (!_todo.empty()) _wake.notify_all();
+}
+
+void virtualTexture::_uploadTiles() {
+
+  std::list<std::pair<int, std::vector<unsigned char> > > arrived;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::list<std::pair<int, std::vector<unsigned char> > >::iterator end =
+      _done.begin();
+    for (int i = 0; i < _maxUploadsPerFrame && end != _done.end(); i++) end++;
+    arrived.splice(arrived.begin(), _done, _done.begin(), end);
+  }
+
+  drawStats::counts.textureBinds++;
+  glBindTexture(GL_TEXTURE_2D, _textureBufferID);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  for (std::list<std::pair<int, std::vector<unsigned char> > >::iterator it =
+         arrived.begin(); it != arrived.end(); it++) {
+    int tile = it->first;
+    _inFlight.erase(tile);
+
+    if (it->second.empty()) {
+      std::cerr << "Caution: Can't read tile " << tile << " of "
+                << _fileName << std::endl;
+      continue;
+    }
+
+    // Not wanted any more?
+    if (_requested[tile] != _frame ||
+        _residentTiles.find(tile) != _residentTiles.end())
+      continue;
+
+    // An empty page, or else the one used longest ago, as long as it
+    // isn't needed for this frame.
+    int victim = -1;
+    for (size_t p = 0; p < _pages.size(); p++) {
+      if (_pages[p].tile < 0) {
+        victim = p;
+        break;
+      }
+      if (_pages[p].lastUsed != _frame &&
+          (victim < 0 || _pages[p].lastUsed < _pages[victim].lastUsed))
+        victim = p;
+    }
+
+    if (victim < 0) continue;
+
+    if (_pages[victim].tile >= 0) _residentTiles.erase(_pages[victim].tile);
+    _pages[victim].tile = tile;
+    _pages[victim].lastUsed = _frame;
+    _residentTiles[tile] = victim;
+
+    drawStats::counts.textureUpload(it->second.size());
+    glTexSubImage2D(GL_TEXTURE_2D, 0,
+                    (victim % _pagesPerSide) * _header.tileSize,
+                    (victim / _pagesPerSide) * _header.tileSize,
+                    _header.tileSize, _header.tileSize,
+                    GL_RGBA, GL_UNSIGNED_BYTE, &it->second[0]);
+  }
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+// For each full-size tile, points at the page with the wanted level
+// of that part of the image, or the closest coarser one there is.
+void virtualTexture::_updateIndirection() {
+
+  std::vector<unsigned char> indirection(_indirection.size(), 0);
+  int top = _header.levels - 1;
+
+  for (int cy = 0; cy < _tilesY[0]; cy++) {
+    for (int cx = 0; cx < _tilesX[0]; cx++) {
+      int cell = cy * _tilesX[0] + cx;
+      int wanted = std::min((int)_wanted[cell], top);
+
+      for (int l = wanted; l <= top; l++) {
+        int tile = _tileIndex(l, std::min(cx >> l, _tilesX[l] - 1),
+                              std::min(cy >> l, _tilesY[l] - 1));
+        std::unordered_map<int, int>::iterator it = _residentTiles.find(tile);
+        if (it == _residentTiles.end()) continue;
+
+        indirection[cell * 4] = it->second % _pagesPerSide;
+        indirection[cell * 4 + 1] = it->second / _pagesPerSide;
+        indirection[cell * 4 + 2] = l;
+        indirection[cell * 4 + 3] = 255;
+        break;
+      }
+    }
+  }
+
+  // Only bother the GPU if something changed.
+  if (indirection == _indirection) return;
+  _indirection.swap(indirection);
+
+  drawStats::counts.textureBinds++;
+  drawStats::counts.textureUpload(_indirection.size());
+  glBindTexture(GL_TEXTURE_2D, _indirectionTexture);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, _tilesX[0], _tilesY[0],
+                  GL_RGBA, GL_UNSIGNED_BYTE, &_indirection[0]);
+}
+
+}
@@ -0,0 +1,181 @@
+#ifndef BSGVIRTUALTEXTURE
+#define BSGVIRTUALTEXTURE
+
+#include "bsg.h"
+#include "bsgTextureFile.h"
+#include <condition_variable>
+
+namespace bsg {
+
+/// \class virtualTexture
+/// \brief A texture for images too big to be a texture.
+///
+/// A gigapixel image won't fit in one GL texture, or in the GPU's
+/// memory, but only a little of it is ever on the screen at once,
+/// and most of that at a lower resolution than the file.  This reads
+/// the image from a .bsgv file, where it is cut into tiles at every
+/// mipmap level (see bsgTextureFile.h), and keeps only the tiles that
+/// are in view on the GPU, in a fixed-size texture of tile-sized
+/// pages, the atlas.  The least recently used tile gives up its page
+/// when a new one is needed.  A second, small texture, the
+/// indirection texture, tells the shader which page holds each part
+/// of the image, and at what level.  Where the right tile hasn't
+/// arrived yet, it points at the same place in a coarser one.
+///
+/// To find out which tiles are in view, the objects using the
+/// texture are drawn again each frame into a small off-screen buffer,
+/// with a shader that writes out which tile, at which level, each
+/// pixel needs.  That's the feedback pass:
+///
+///     vt->beginFeedback();
+///     vt->drawFeedback(object, viewMatrix, projMatrix);  // each object
+///     vt->endFeedback();
+///
+/// Do that before drawing the scene.  The tiles are read from the
+/// file, which is mapped into memory, by a worker thread, and sent
+/// to the GPU a few at a time by endFeedback().
+///
+/// Add it to a shaderMgr with addTexture(), like any texture, and use
+/// shaders/textureShader.vp with shaders/virtualTexture.fp, or copy
+/// its vtSample() function into your own shader.  The feedback pass
+/// needs GL_EXT_framebuffer_object.
+class virtualTexture : public textureMgr {
+ private:
+
+  std::string _fileName;
+  bsgVirtualTextureFileHeader _header;
+  int _content;
+
+  /// The number of tiles across and up each level, and the index of
+  /// each level's first tile.
+  std::vector<int> _tilesX, _tilesY, _firstTile;
+  std::vector<uint64_t> _tileOffsets;
+
+  /// The file, mapped into memory.
+  const unsigned char *_mapped;
+  size_t _mappedLength;
+
+  /// The pages of the atlas, and which tile is in each one, if any,
+  /// with the frame it was last needed.  The map goes the other way,
+  /// from a tile to its page.
+  struct page {
+    int tile;
+    unsigned int lastUsed;
+  };
+  std::vector<page> _pages;
+  std::unordered_map<int, int> _residentTiles;
+  int _pagesPerSide;
+  unsigned int _frame;
+  bool _warnedBudget;
+
+  /// The last frame each tile was asked for.
+  std::vector<unsigned int> _requested;
+
+  /// The tiles being read by the worker.  The worker only sees the
+  /// todo list and the done list, under the mutex.
+  std::set<int> _inFlight;
+  std::list<int> _todo;
+  std::list<std::pair<int, std::vector<unsigned char> > > _done;
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  std::thread _worker;
+  bool _quit;
+  void _work();
+  void _readTile(const int &tile, std::vector<unsigned char> &texels);
+
+  /// The most tiles sent to the GPU in one frame.
+  int _maxUploadsPerFrame;
+
+  /// One texel per tile of the full-size image: the page, the level,
+  /// and whether there is anything there.  And the level each of
+  /// those tiles wants, from the feedback.
+  GLuint _indirectionTexture;
+  std::vector<unsigned char> _indirection;
+  std::vector<unsigned char> _wanted;
+  GLenum _indirectionUnit;
+
+  /// The feedback buffer, and what we were drawing into before.
+  GLuint _feedbackFramebuffer, _feedbackTexture, _feedbackDepth;
+  int _feedbackScale;
+  int _feedbackWidth, _feedbackHeight;
+  std::vector<unsigned char> _feedbackPixels;
+  GLint _savedFramebuffer;
+  GLint _savedViewport[4];
+  bool _inFeedback;
+
+  /// The feedback program, one for each program the texture is used
+  /// with, so its attributes are in the same places.
+  GLuint _programID;
+  std::map<GLuint, GLuint> _feedbackPrograms;
+  GLuint _feedbackProgram();
+  std::string _positionName, _uvName;
+
+  void _open();
+  void _makeTextures();
+  int _tileIndex(const int &level, const int &x, const int &y) {
+    return _firstTile[level] + y * _tilesX[level] + x;
+  };
+  bool _request(const int &level, const int &x, const int &y,
+                std::vector<std::pair<int, int> > &missing);
+  void _processFeedback();
+  void _uploadTiles();
+  void _updateIndirection();
+  void _setUniforms(const GLuint &programID);
+
+ public:
+  /// \brief Open a .bsgv file.
+  ///
+  /// The atlas is pagesPerSide pages square, so the GPU memory used
+  /// is fixed at pagesPerSide squared tiles, whatever the size of the
+  /// image.  The feedback buffer is feedbackScale times smaller than
+  /// the viewport each way.
+  virtualTexture(const std::string &fileName, const int &pagesPerSide = 16,
+                 const int &feedbackScale = 8);
+  ~virtualTexture();
+
+  /// \brief The names of the position and texture coordinate
+  /// attributes, for the feedback pass.
+  void setAttribNames(const std::string &positionName,
+                      const std::string &uvName) {
+    _positionName = positionName;
+    _uvName = uvName;
+  };
+
+  /// \brief The most tiles sent to the GPU in one frame.
+  void setMaxUploadsPerFrame(const int &n) { _maxUploadsPerFrame = n; };
+
+  /// \brief Start the feedback pass.
+  ///
+  /// Switches to the feedback buffer.  The viewport should be set the
+  /// way it will be for the real drawing.
+  void beginFeedback();
+
+  /// \brief Draw an object that uses this texture into the feedback.
+  void drawFeedback(bsgPtr<drawableCompound> &object,
+                    const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix);
+
+  /// \brief Finish the feedback pass.
+  ///
+  /// Reads back the feedback, switches back to the buffer we were
+  /// drawing into before, asks for the tiles that aren't here yet,
+  /// and sends the ones that have been read to the GPU.
+  void endFeedback();
+
+  /// \brief The number of tiles on the GPU.
+  int getNumResidentTiles() { return _residentTiles.size(); };
+
+  /// \brief The number of tiles being read.
+  int getNumLoadingTiles() { return _inFlight.size(); };
+
+  /// \brief The size of the whole image, and how many levels it has.
+  int getImageWidth() { return _header.width; };
+  int getImageHeight() { return _header.height; };
+  int getNumLevels() { return _header.levels; };
+
+  void load(const GLuint programID);
+  void draw();
+};
+
+}
+
+#endif
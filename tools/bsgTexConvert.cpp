@@ -0,0 +1,560 @@
+#include <GL/glew.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "bsgTextureFile.h"
+
+// Converts an image file (anything stb_image reads: PNG, JPEG, BMP,
+// TGA...) into a .bsgt file, which textureMgr can read without doing
+// any work.  The image is flipped to OpenGL's bottom-first order, a
+// full mipmap chain is made with a box filter, and, if you ask, every
+// level is compressed: BC1 (DXT1) for opaque images, and BC3 (DXT5)
+// for images with alpha.  Compression takes an eighth or a quarter of
+// the memory, at some cost in quality.
+//
+// With -tiles, it makes a .bsgv file for a virtualTexture instead:
+// the image and its mipmaps cut into tiles, for images too big to be
+// one texture.  This works on a strip of tiles at a time, so the
+// image doesn't have to fit in memory, but only for binary PPM (P6)
+// files, which can be read in pieces.  Anything else is decoded whole
+// by stb_image first.  For a gigapixel image, convert it to PPM
+// first, with something like 'vips copy big.tif big.ppm'.
+//
+// Usage: bsgTexConvert [-c] [-nomip] input.png output.bsgt
+//        bsgTexConvert -tiles input.png output.bsgv
+
+typedef std::vector<unsigned char> image;
+
+// Halves an RGBA image, averaging each two-by-two square.  An odd row
+// or column at the edge is averaged with itself.
+static image halve(const image &in, const int &w, const int &h,
+                   int &newW, int &newH) {
+
+  newW = std::max(1, w / 2);
+  newH = std::max(1, h / 2);
+  image out((size_t)newW * newH * 4);
+
+  for (int y = 0; y < newH; y++) {
+    size_t y0 = std::min(2 * y, h - 1), y1 = std::min(2 * y + 1, h - 1);
+    for (int x = 0; x < newW; x++) {
+      size_t x0 = std::min(2 * x, w - 1), x1 = std::min(2 * x + 1, w - 1);
+      for (int c = 0; c < 4; c++) {
+        int sum = in[(y0 * w + x0) * 4 + c] + in[(y0 * w + x1) * 4 + c] +
+          in[(y1 * w + x0) * 4 + c] + in[(y1 * w + x1) * 4 + c];
+        out[((size_t)y * newW + x) * 4 + c] = (sum + 2) / 4;
+      }
+    }
+  }
+  return out;
+}
+
+static uint16_t to565(const int *c) {
+  return ((c[0] * 31 + 127) / 255) << 11 |
+    ((c[1] * 63 + 127) / 255) << 5 | ((c[2] * 31 + 127) / 255);
+}
+
+static void from565(const uint16_t &v, int *c) {
+  c[0] = ((v >> 11) & 31) * 255 / 31;
+  c[1] = ((v >> 5) & 63) * 255 / 63;
+  c[2] = (v & 31) * 255 / 31;
+}
+
+// The color half of a BC1 or BC3 block.  The two end colors are the
+// corners of the box around the block's colors, and each pixel gets
+// whichever of the four colors along the line between them is
+// nearest.
+static void compressColor(const unsigned char block[16][4],
+                          unsigned char *out) {
+
+  int lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+  for (int p = 0; p < 16; p++) {
+    for (int c = 0; c < 3; c++) {
+      lo[c] = std::min(lo[c], (int)block[p][c]);
+      hi[c] = std::max(hi[c], (int)block[p][c]);
+    }
+  }
+
+  uint16_t c0 = to565(hi), c1 = to565(lo);
+  if (c0 < c1) std::swap(c0, c1);
+
+  int palette[4][3];
+  from565(c0, palette[0]);
+  from565(c1, palette[1]);
+  for (int c = 0; c < 3; c++) {
+    palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+    palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+  }
+
+  uint32_t indices = 0;
+  if (c0 != c1) {
+    for (int p = 0; p < 16; p++) {
+      int best = 0, bestDistance = 1 << 30;
+      for (int i = 0; i < 4; i++) {
+        int distance = 0;
+        for (int c = 0; c < 3; c++) {
+          int d = block[p][c] - palette[i][c];
+          distance += d * d;
+        }
+        if (distance < bestDistance) {
+          best = i;
+          bestDistance = distance;
+        }
+      }
+      indices |= best << (2 * p);
+    }
+  }
+
+  out[0] = c0 & 0xff; out[1] = c0 >> 8;
+  out[2] = c1 & 0xff; out[3] = c1 >> 8;
+  for (int i = 0; i < 4; i++) out[4 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+// The alpha half of a BC3 block: two end values, and eight steps
+// between them.
+static void compressAlpha(const unsigned char block[16][4],
+                          unsigned char *out) {
+
+  int a0 = 0, a1 = 255;
+  for (int p = 0; p < 16; p++) {
+    a0 = std::max(a0, (int)block[p][3]);
+    a1 = std::min(a1, (int)block[p][3]);
+  }
+
+  int palette[8] = { a0, a1 };
+  for (int i = 0; i < 6; i++) palette[2 + i] = ((6 - i) * a0 + (i + 1) * a1) / 7;
+
+  uint64_t indices = 0;
+  if (a0 != a1) {
+    for (int p = 0; p < 16; p++) {
+      int best = 0;
+      for (int i = 1; i < 8; i++)
+        if (abs(block[p][3] - palette[i]) < abs(block[p][3] - palette[best]))
+          best = i;
+      indices |= (uint64_t)best << (3 * p);
+    }
+  }
+
+  out[0] = a0;
+  out[1] = a1;
+  for (int i = 0; i < 6; i++) out[2 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+// Compresses an RGBA image, four by four pixels at a time.  Blocks
+// that hang off the edge repeat the edge pixels.
+static image compress(const image &in, const int &w, const int &h,
+                      const bool &alpha) {
+
+  int blockBytes = alpha ? 16 : 8;
+  image out((size_t)((w + 3) / 4) * ((h + 3) / 4) * blockBytes);
+  unsigned char *o = &out[0];
+
+  for (int by = 0; by < h; by += 4) {
+    for (int bx = 0; bx < w; bx += 4) {
+      unsigned char block[16][4];
+      for (int p = 0; p < 16; p++) {
+        size_t x = std::min(bx + p % 4, w - 1);
+        size_t y = std::min(by + p / 4, h - 1);
+        memcpy(block[p], &in[(y * w + x) * 4], 4);
+      }
+
+      if (alpha) {
+        compressAlpha(block, o);
+        o += 8;
+      }
+      compressColor(block, o);
+      o += 8;
+    }
+  }
+  return out;
+}
+
+// Moves to a place in a file that may be more than 2GB long.
+static bool seekTo(FILE *fp, const uint64_t &offset) {
+#ifdef WIN32
+  return _fseeki64(fp, offset, SEEK_SET) == 0;
+#else
+  return fseeko(fp, offset, SEEK_SET) == 0;
+#endif
+}
+
+// An uncompressed image in a file, read a row at a time, so the
+// whole image never has to be in memory.  The rows are numbered from
+// the bottom, the way OpenGL has them.
+struct rowFile {
+  FILE *fp;
+  uint64_t start;
+  int width, height, channels;
+  bool topFirst;
+  image buffer;
+
+  rowFile(FILE *f, const uint64_t &s, const int &w, const int &h,
+          const int &c, const bool &top) :
+    fp(f), start(s), width(w), height(h), channels(c), topFirst(top) {};
+
+  // Reads row y, as RGBA.
+  bool read(const int &y, unsigned char *rgba) {
+    size_t rowBytes = (size_t)width * channels;
+    uint64_t row = topFirst ? height - 1 - y : y;
+    if (!seekTo(fp, start + row * rowBytes)) return false;
+
+    if (channels == 4) return fread(rgba, 1, rowBytes, fp) == rowBytes;
+
+    buffer.resize(rowBytes);
+    if (fread(&buffer[0], 1, rowBytes, fp) != rowBytes) return false;
+    for (size_t x = 0; x < (size_t)width; x++) {
+      memcpy(rgba + 4 * x, &buffer[3 * x], 3);
+      rgba[4 * x + 3] = 255;
+    }
+    return true;
+  }
+};
+
+// Opens a binary PPM (P6) file, with 8-bit samples, to be read a row
+// at a time.  Returns null if it isn't one.
+static rowFile *openPPM(const std::string &name) {
+
+  FILE *fp = fopen(name.c_str(), "rb");
+  if (!fp) return NULL;
+
+  // The header is "P6", the width, height and largest value, separated
+  // by white space and comments, then one white space character.
+  char magic[2];
+  if (fread(magic, 1, 2, fp) != 2 || magic[0] != 'P' || magic[1] != '6') {
+    fclose(fp);
+    return NULL;
+  }
+
+  int values[3];
+  for (int i = 0; i < 3; i++) {
+    int c = fgetc(fp);
+    while (c == '#' || isspace(c)) {
+      if (c == '#') while (c != '\n' && c != EOF) c = fgetc(fp);
+      c = fgetc(fp);
+    }
+    ungetc(c, fp);
+    if (fscanf(fp, "%d", &values[i]) != 1) {
+      fclose(fp);
+      return NULL;
+    }
+  }
+  fgetc(fp);
+
+  if (values[2] != 255) {
+    fprintf(stderr, "%s: only 8-bit PPM files are read in strips.\n",
+            name.c_str());
+    fclose(fp);
+    return NULL;
+  }
+
+  return new rowFile(fp, ftell(fp), values[0], values[1], 3, true);
+}
+
+// Makes the next mipmap level of an image in a file, into a temporary
+// file, two rows at a time.  An odd row or column at the edge is
+// averaged with itself, as in halve().
+static rowFile *halveRows(rowFile &in) {
+
+  int w = in.width, h = in.height;
+  int newW = std::max(1, w / 2), newH = std::max(1, h / 2);
+
+  FILE *fp = tmpfile();
+  if (!fp) {
+    perror("tmpfile");
+    return NULL;
+  }
+
+  image row0((size_t)w * 4), row1((size_t)w * 4), out((size_t)newW * 4);
+  for (int y = 0; y < newH; y++) {
+    if (!in.read(std::min(2 * y, h - 1), &row0[0]) ||
+        !in.read(std::min(2 * y + 1, h - 1), &row1[0])) {
+      fprintf(stderr, "Can't read the image rows.\n");
+      fclose(fp);
+      return NULL;
+    }
+
+    for (int x = 0; x < newW; x++) {
+      size_t x0 = std::min(2 * x, w - 1), x1 = std::min(2 * x + 1, w - 1);
+      for (int c = 0; c < 4; c++) {
+        int sum = row0[x0 * 4 + c] + row0[x1 * 4 + c] +
+          row1[x0 * 4 + c] + row1[x1 * 4 + c];
+        out[(size_t)x * 4 + c] = (sum + 2) / 4;
+      }
+    }
+    if (fwrite(&out[0], 1, out.size(), fp) != out.size()) {
+      perror("tmpfile");
+      fclose(fp);
+      return NULL;
+    }
+  }
+
+  return new rowFile(fp, 0, newW, newH, 4, false);
+}
+
+// The size of the tiles in a .bsgv file, with the border, which is
+// there so the GPU can filter across the edge of a tile.
+static const int tileSize = 128;
+static const int tileBorder = 1;
+
+// Cuts an image and its mipmaps into tiles, and writes them.  Each
+// level is read a strip of tiles at a time, and the next level is
+// made in a temporary file, so only a strip is ever in memory.
+static int writeTiles(rowFile *source, const std::string &name) {
+
+  int w = source->width, h = source->height;
+  int content = tileSize - 2 * tileBorder;
+  size_t tileBytes = tileSize * tileSize * 4;
+
+  bsg::bsgVirtualTextureFileHeader header;
+  memcpy(header.magic, "BSGV", 4);
+  header.version = bsg::bsgTextureFileVersion;
+  header.width = w;
+  header.height = h;
+  header.tileSize = tileSize;
+  header.border = tileBorder;
+
+  // Count the levels and tiles first, since the table comes before
+  // the tiles.
+  header.levels = 0;
+  header.numTiles = 0;
+  for (int lw = w, lh = h; ; lw = std::max(1, lw / 2), lh = std::max(1, lh / 2)) {
+    header.levels++;
+    header.numTiles += ((lw + content - 1) / content) * ((lh + content - 1) / content);
+    if (lw <= content && lh <= content) break;
+  }
+
+  FILE *fp = fopen(name.c_str(), "wb");
+  if (!fp) {
+    perror(name.c_str());
+    return 1;
+  }
+
+  // The tiles are written in the order of the table: level by level,
+  // row by row.
+  fwrite(&header, sizeof(header), 1, fp);
+  uint64_t offset = sizeof(header) + (uint64_t)header.numTiles * sizeof(uint64_t);
+  for (uint32_t t = 0; t < header.numTiles; t++) {
+    fwrite(&offset, sizeof(offset), 1, fp);
+    offset += tileBytes;
+  }
+
+  rowFile *level = source;
+  image tile(tileBytes);
+  for (uint32_t l = 0; l < header.levels; l++) {
+    int tilesX = (w + content - 1) / content;
+    int tilesY = (h + content - 1) / content;
+    size_t rowBytes = (size_t)w * 4;
+    image strip(tileSize * rowBytes);
+
+    for (int ty = 0; ty < tilesY; ty++) {
+
+      // The rows past the edge of the image repeat the edge.
+      for (int y = 0; y < tileSize; y++) {
+        int iy = std::min(std::max(ty * content + y - tileBorder, 0), h - 1);
+        if (!level->read(iy, &strip[y * rowBytes])) {
+          fprintf(stderr, "Can't read the image rows.\n");
+          fclose(fp);
+          return 1;
+        }
+      }
+
+      for (int tx = 0; tx < tilesX; tx++) {
+        for (int y = 0; y < tileSize; y++) {
+          for (int x = 0; x < tileSize; x++) {
+            size_t ix = std::min(std::max(tx * content + x - tileBorder, 0), w - 1);
+            memcpy(&tile[((size_t)y * tileSize + x) * 4],
+                   &strip[y * rowBytes + ix * 4], 4);
+          }
+        }
+        fwrite(&tile[0], 1, tileBytes, fp);
+      }
+    }
+
+    if (l + 1 < header.levels) {
+      rowFile *next = halveRows(*level);
+      if (level != source) {
+        fclose(level->fp);
+        delete level;
+      }
+      if (!next) {
+        fclose(fp);
+        return 1;
+      }
+      level = next;
+      w = level->width;
+      h = level->height;
+    }
+  }
+  if (level != source) {
+    fclose(level->fp);
+    delete level;
+  }
+
+  if (fclose(fp) != 0) {
+    perror(name.c_str());
+    return 1;
+  }
+
+  printf("%s: %dx%d, %d levels, %d tiles, %llu bytes\n", name.c_str(),
+         header.width, header.height, header.levels, header.numTiles,
+         (unsigned long long)offset);
+  return 0;
+}
+
+// For -tiles, reads a PPM file a strip at a time, or anything else
+// with stb_image, into a temporary file, and tiles that.
+static int convertTiles(const std::string &inName, const std::string &outName) {
+
+  rowFile *source = openPPM(inName);
+
+  if (!source) {
+    int width, height, components;
+    unsigned char *data = stbi_load(inName.c_str(), &width, &height,
+                                    &components, STBI_rgb_alpha);
+    if (!data) {
+      fprintf(stderr, "Can't read %s: %s\n", inName.c_str(),
+              stbi_failure_reason());
+      return 1;
+    }
+
+    // Already flipped, so bottom first.
+    FILE *fp = tmpfile();
+    size_t bytes = (size_t)width * height * 4;
+    if (!fp || fwrite(data, 1, bytes, fp) != bytes) {
+      perror("tmpfile");
+      stbi_image_free(data);
+      return 1;
+    }
+    stbi_image_free(data);
+    source = new rowFile(fp, 0, width, height, 4, false);
+  }
+
+  int out = writeTiles(source, outName);
+  fclose(source->fp);
+  delete source;
+  return out;
+}
+
+int main(int argc, char** argv) {
+
+  bool compressed = false, mipmaps = true, tiles = false;
+  std::vector<std::string> names;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-c") == 0) {
+      compressed = true;
+    } else if (strcmp(argv[i], "-tiles") == 0) {
+      tiles = true;
+    } else if (strcmp(argv[i], "-nomip") == 0) {
+      mipmaps = false;
+    } else {
+      names.push_back(argv[i]);
+    }
+  }
+
+  if (names.size() != 2) {
+    fprintf(stderr, "usage: %s [-c] [-nomip] input.png output.bsgt\n", argv[0]);
+    fprintf(stderr, "       %s -tiles input.png output.bsgv\n", argv[0]);
+    return 1;
+  }
+
+  // This is the flip that textureMgr doesn't have to do anymore.
+  stbi_set_flip_vertically_on_load(true);
+
+  if (tiles) return convertTiles(names[0], names[1]);
+
+  int width, height, components;
+  unsigned char *data = stbi_load(names[0].c_str(), &width, &height,
+                                  &components, STBI_rgb_alpha);
+  if (!data) {
+    fprintf(stderr, "Can't read %s: %s\n", names[0].c_str(),
+            stbi_failure_reason());
+    return 1;
+  }
+
+  image level(data, data + (size_t)width * height * 4);
+  stbi_image_free(data);
+
+  bool alpha = false;
+  for (size_t p = 3; p < level.size() && !alpha; p += 4)
+    alpha = (level[p] != 255);
+
+  bsg::bsgTextureFileHeader header;
+  memcpy(header.magic, "BSGT", 4);
+  header.version = bsg::bsgTextureFileVersion;
+  header.width = width;
+  header.height = height;
+  if (compressed) {
+    header.internalFormat = alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT :
+      GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    header.format = 0;
+    header.type = 0;
+  } else {
+    header.internalFormat = alpha ? GL_RGBA : GL_RGB;
+    header.format = header.internalFormat;
+    header.type = GL_UNSIGNED_BYTE;
+  }
+
+  // Make all the levels, down to one pixel.
+  std::vector<image> levels;
+  int w = width, h = height;
+  while (true) {
+    if (compressed) {
+      levels.push_back(compress(level, w, h, alpha));
+    } else if (alpha) {
+      levels.push_back(level);
+    } else {
+      image rgb((size_t)w * h * 3);
+      for (size_t p = 0; p < (size_t)w * h; p++)
+        memcpy(&rgb[p * 3], &level[p * 4], 3);
+      levels.push_back(rgb);
+    }
+
+    if (!mipmaps || (w == 1 && h == 1)) break;
+    int newW, newH;
+    level = halve(level, w, h, newW, newH);
+    w = newW;
+    h = newH;
+  }
+  header.levels = levels.size();
+
+  // The levels start on 16-byte boundaries, after the table.
+  std::vector<bsg::bsgTextureFileLevel> table(levels.size());
+  uint64_t offset = sizeof(header) + table.size() * sizeof(bsg::bsgTextureFileLevel);
+  for (size_t i = 0; i < levels.size(); i++) {
+    offset = (offset + 15) & ~(uint64_t)15;
+    table[i].offset = offset;
+    table[i].size = levels[i].size();
+    offset += levels[i].size();
+  }
+
+  FILE *fp = fopen(names[1].c_str(), "wb");
+  if (!fp) {
+    perror(names[1].c_str());
+    return 1;
+  }
+
+  fwrite(&header, sizeof(header), 1, fp);
+  fwrite(&table[0], sizeof(bsg::bsgTextureFileLevel), table.size(), fp);
+  for (size_t i = 0; i < levels.size(); i++) {
+    long pad = table[i].offset - ftell(fp);
+    for (long p = 0; p < pad; p++) fputc(0, fp);
+    fwrite(&levels[i][0], 1, levels[i].size(), fp);
+  }
+
+  if (fclose(fp) != 0) {
+    perror(names[1].c_str());
+    return 1;
+  }
+
+  printf("%s: %dx%d, %d levels, %s, %llu bytes\n", names[1].c_str(),
+         width, height, (int)levels.size(),
+         compressed ? (alpha ? "BC3" : "BC1") : (alpha ? "RGBA" : "RGB"),
+         (unsigned long long)offset);
+  return 0;
+}